@@ -0,0 +1,65 @@
+#include <cstdio>
+#include <cstdlib>
+
+#include "tonemap/benchmark.hpp"
+
+// prints the cpu throughput of every operator, of the baked cubes and of the tile hash on
+// a synthetic frame, 3840 x 2160 at 200 nits unless given as arguments, then that of
+// copy_frame on the frame sizes of common desktops
+int main(int argc, char** argv)
+{
+	const int width = argc > 2 ? std::atoi(argv[1]) : 3840;
+	const int height = argc > 2 ? std::atoi(argv[2]) : 2160;
+	const float white_level = argc > 3 ? static_cast<float>(std::atof(argv[3])) : 200.0f;
+
+	if (argc == 2 || argc > 4 || width <= 0 || height <= 0 || white_level <= 0.0f)
+	{
+		std::printf("usage: %s [width height [white level]]\n", argv[0]);
+		return 1;
+	}
+
+	std::printf("%dx%d at %.0f nits\n\n", width, height, white_level);
+	std::printf("%-10s %-8s %10s %10s %10s\n", "operator", "isa", "Mpx/s", "max err", "mean err");
+
+	for (const auto& result : tonemap::run_benchmark(width, height, white_level))
+	{
+		std::printf(
+			"%-10s %-8s %10.1f %10d %10.4f\n",
+			tonemap::operator_name(result.op), tonemap::isa_name(result.level),
+			result.mpx_per_second, result.error.max_error, result.error.mean_error
+		);
+	}
+
+	std::printf("\n%-10s %-8s %10s %10s %10s %10s %10s\n", "cube", "isa", "Mpx/s", "max err", "mean err", "sweep max", "sweep mean");
+
+	for (const auto& result : tonemap::run_cube_benchmark(width, height, white_level))
+	{
+		std::printf(
+			"%-10d %-8s %10.1f %10d %10.4f %10d %10.4f\n",
+			result.size, tonemap::isa_name(result.level), result.mpx_per_second,
+			result.error.max_error, result.error.mean_error, result.sweep.max_error, result.sweep.mean_error
+		);
+	}
+
+	std::printf("\n%-10s %-8s %10s %10s\n", "tile hash", "isa", "Mpx/s", "GB/s");
+
+	for (const auto& result : tonemap::run_hash_benchmark(width, height))
+	{
+		std::printf(
+			"%-10s %-8s %10.1f %10.1f\n",
+			"", tonemap::isa_name(result.level), result.mpx_per_second, result.gb_per_second
+		);
+	}
+
+	std::printf("\n%-10s %-12s %10s %10s\n", "copy", "size", "row GB/s", "GB/s");
+
+	for (const auto& result : tonemap::run_copy_benchmark())
+	{
+		std::printf(
+			"%-10s %5dx%-6d %10.1f %10.1f\n",
+			"", result.width, result.height, result.row_gb_per_second, result.gb_per_second
+		);
+	}
+
+	return 0;
+}
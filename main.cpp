@@ -7,8 +7,13 @@
 #include <d3dcompiler.h>
 
 #include <vector>
+#include <algorithm>
 #include <format>
-#include <numbers>
+#include <iterator>
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <memory>
 
 #include <MinHook.h>
 
@@ -18,31 +23,234 @@
 
 #include "utils/com_ptr.hpp"
 #include "utils/trampoline.hpp"
+#include "utils/triple_buffer.hpp"
+#include "utils/single_flight.hpp"
+#include "utils/readback_ring.hpp"
+#include "utils/resource_cache.hpp"
+
+#include "tonemap/tonemap.hpp"
+#include "tonemap/dispatch.hpp"
+#include "tonemap/compose.hpp"
+#include "tonemap/operators.hpp"
+#include "tonemap/pq10.hpp"
+#include "tonemap/histogram.hpp"
+#include "tonemap/rect.hpp"
+#include "tonemap/frame_arena.hpp"
 
 namespace
 {
 	com_ptr<ID3D11Device> device;
 	com_ptr<ID3D11DeviceContext> ctx;
-	com_ptr<ID3D11ComputeShader> render_cs;
+	// one per tonemapper.hlsl permutation, see shader_index()
+	com_ptr<ID3D11ComputeShader> render_cs[4 + 4 * tonemap::tone_operator_count];
+	// the TONEMAP_HISTOGRAM permutation, bins into histogram_uav
+	com_ptr<ID3D11ComputeShader> histogram_cs;
 	com_ptr<ID3D11Texture2D> virtual_desktop_tex;
 	com_ptr<ID3D11Buffer> render_const_buffer;
+	com_ptr<ID3D11Buffer> pq_eotf_buffer;
+	com_ptr<ID3D11ShaderResourceView> pq_eotf_srv;
+	// luminance_histogram::bin_count counters and the staging copy they're read from
+	com_ptr<ID3D11Buffer> histogram_buffer;
+	com_ptr<ID3D11UnorderedAccessView> histogram_uav;
+	com_ptr<ID3D11Buffer> histogram_staging;
 
 	int w = 0, h = 0;
 
 	struct render_constant_buffer_t
 	{
 		float white_level = 200.0f;
-		uint32_t is_hdr = 0;
-
-		float __gap[2];
-
-		float transform_matrix[3][4];
+		int32_t offset[2] = {};
+		int32_t input_format = 0; // tonemap::input_format
+		int32_t src_origin[2] = {};
+		int32_t src_size[2] = {};
 	} render_cb_data;
 
 	HINSTANCE self_instance;
 
+	// hdr tone mapping operator, BITBLT_HDR_OPERATOR picks one by name
+	tonemap::tone_operator tone_op = tonemap::tone_operator::blend;
+
+	// offer R10G10B10A2 pq frames to hdr monitors instead of fp16, BITBLT_HDR_INPUT=pq10
+	bool pq10_input = false;
+
+	// estimate the white level from frame luminance even when windows reports one,
+	// BITBLT_HDR_WHITE_LEVEL=auto
+	bool auto_white_level = false;
+
+	// keep capturing the whole virtual desktop on a thread of its own so bitblt_hook
+	// only has to pick up the newest frame, BITBLT_HDR_WARM_CAPTURE=1
+	bool warm_capture = false;
+
+	// grid size of the baked cube the blend operator goes through instead of the direct
+	// kernels, 0 for none. BITBLT_HDR_CUBE_LUT=33 or 65
+	int cube_lut_size = 0;
+
 	std::vector<std::unique_ptr<monitor>> monitors;
 
+	// running totals since the dll was loaded, printed by debug builds after the first
+	// capture and then every capture_stats_interval captures
+	struct capture_stats_t
+	{
+		uint64_t captures = 0;
+		uint64_t monitors_captured = 0;
+		uint64_t monitors_skipped = 0;
+		// cpu path, invalid tiles tone mapped again and ones whose source hashed the same
+		uint64_t tiles_converted = 0;
+		uint64_t tiles_reused = 0;
+	} capture_stats;
+
+	constexpr uint64_t capture_stats_interval = 100;
+
+	// a capture of the whole virtual desktop by the warm capture thread
+	struct warm_frame
+	{
+		tonemap::frame_arena::buffer pixels;
+		tonemap::rect area = {};
+	};
+
+	// filled by warm_capture_loop, read by blit_warm_frame on any number of threads
+	triple_buffer<warm_frame> warm_frames;
+	std::thread warm_thread;
+	std::atomic<bool> warm_stop = false;
+	// manual reset, set once the first warm frame is published
+	HANDLE warm_frame_ready = nullptr;
+
+	// set by display_watch_proc on WM_DISPLAYCHANGE, outputs are enumerated again on the
+	// next capture. Starts out set so the first capture enumerates them
+	std::atomic<bool> displays_changed = true;
+
+	enum class gpu_resource_kind
+	{
+		srv,
+		uav,
+		staging,
+	};
+
+	// what capturing creates on the device, only the member of its kind is set
+	struct gpu_resource
+	{
+		com_ptr<ID3D11ShaderResourceView> srv;
+		com_ptr<ID3D11UnorderedAccessView> uav;
+		com_ptr<ID3D11Texture2D> tex;
+	};
+
+	// views by the texture they're of, staging textures by size and format alone. A
+	// cached view holds on to its texture, so the address can't be reused by another
+	struct gpu_resource_key
+	{
+		gpu_resource_kind kind;
+		const void* texture;
+		DXGI_FORMAT format;
+		UINT width;
+		UINT height;
+
+		bool operator==(const gpu_resource_key&) const = default;
+	};
+
+	struct gpu_resource_key_hash
+	{
+		size_t operator()(const gpu_resource_key& key) const
+		{
+			size_t hash = std::hash<const void*>{}(key.texture);
+
+			for (size_t value : { static_cast<size_t>(key.kind), static_cast<size_t>(key.format), static_cast<size_t>(key.width), static_cast<size_t>(key.height) })
+				hash = hash * 31 + value;
+
+			return hash;
+		}
+	};
+
+	// views and staging textures kept between captures so capturing an unchanged desktop
+	// setup creates none, BITBLT_HDR_GPU_CACHE_MB caps the staging textures. Views of
+	// duplication frames that went away are dropped once unused for gpu_resource_max_age
+	// captures, they'd keep the frames alive otherwise
+	resource_cache<gpu_resource_key, gpu_resource, gpu_resource_key_hash> gpu_resources{ static_cast<size_t>(256) << 20 };
+	constexpr uint64_t gpu_resource_max_age = 8;
+
+	// readback_ring backend from virtual_desktop_tex into the bgra rows at dest, one
+	// staging texture and an event query per band
+	struct staging_readback
+	{
+		struct surface_type
+		{
+			com_ptr<ID3D11Texture2D> tex;
+			com_ptr<ID3D11Query> copied;
+		};
+
+		uint8_t* dest = nullptr;
+
+		surface_type create(int width, int rows)
+		{
+			D3D11_TEXTURE2D_DESC desc;
+			virtual_desktop_tex->GetDesc(&desc);
+			desc.Width = width;
+			desc.Height = rows;
+			desc.Usage = D3D11_USAGE_STAGING;
+			desc.BindFlags = 0;
+			desc.MiscFlags = 0;
+			desc.CPUAccessFlags = D3D11_CPU_ACCESS_READ;
+
+			surface_type surface;
+			HRESULT hr = device->CreateTexture2D(&desc, nullptr, surface.tex);
+			if (FAILED(hr))
+			{
+				auto msg = std::format("failed to create staging texture: {:x}", hr);
+				throw std::runtime_error{ msg };
+			}
+
+			D3D11_QUERY_DESC query_desc = { D3D11_QUERY_EVENT, 0 };
+			hr = device->CreateQuery(&query_desc, surface.copied);
+			if (FAILED(hr))
+			{
+				auto msg = std::format("failed to create staging query: {:x}", hr);
+				throw std::runtime_error{ msg };
+			}
+
+			return surface;
+		}
+
+		void copy(surface_type& surface, int top, int rows)
+		{
+			const D3D11_BOX box = { 0, static_cast<UINT>(top), 0, static_cast<UINT>(w), static_cast<UINT>(top + rows), 1 };
+			ctx->CopySubresourceRegion(surface.tex, 0, 0, 0, 0, virtual_desktop_tex, 0, &box);
+			ctx->End(surface.copied);
+		}
+
+		// GetData without D3D11_ASYNC_GETDATA_DONOTFLUSH, the copies queued so far are
+		// submitted by the first poll
+		bool done(const surface_type& surface)
+		{
+			return ctx->GetData(surface.copied, nullptr, 0, 0) != S_FALSE;
+		}
+
+		void wait(const surface_type& surface)
+		{
+			while (!done(surface))
+				SwitchToThread();
+		}
+
+		void read(surface_type& surface, int top, int rows)
+		{
+			D3D11_MAPPED_SUBRESOURCE mapped;
+			HRESULT hr = ctx->Map(surface.tex, 0, D3D11_MAP_READ, 0, &mapped);
+			if (FAILED(hr))
+			{
+				auto msg = std::format("failed to map staging texture: {:x}", hr);
+				throw std::runtime_error{ msg };
+			}
+
+			tonemap::dispatch_sdr_to_bgra8(
+				mapped.pData, mapped.RowPitch,
+				dest + static_cast<size_t>(w) * 4 * top, static_cast<size_t>(w) * 4,
+				w, rows
+			);
+
+			ctx->Unmap(surface.tex, 0);
+		}
+	};
+
+	readback_ring<staging_readback> readback{ staging_readback{} };
+
 	bool init_desktop_dup()
 	{
 		if (device && ctx)
@@ -80,10 +288,15 @@ namespace
 		return true;
 	}
 
+	// outputs still at the same desktop coordinates keep their monitor and with it the
+	// duplication, tile cache and white level estimate, so docking or plugging in one
+	// display doesn't restart every other. Only new or moved outputs get a new monitor
 	void enum_monitors()
 	{
-		if (monitors.size())
-			monitors.clear();
+		auto previous = std::move(monitors);
+		monitors.clear();
+
+		size_t kept = 0;
 
 		com_ptr<IDXGIDevice> dxgi_device = device.as<IDXGIDevice>();
 		
@@ -131,126 +344,225 @@ namespace
 
 			// if (desc.AttachedToDesktop)
 			{
-				monitors.push_back(std::make_unique<monitor>(output6, device));
+				auto same = std::find_if(previous.begin(), previous.end(), [&](const auto& existing) {
+					return existing->same_output(desc);
+				});
+
+				if (same != previous.end())
+				{
+					monitors.push_back(std::move(*same));
+					previous.erase(same);
+					kept++;
+					continue;
+				}
+
+				// the monitor queries its output desc up front, an output that fails to
+				// answer is skipped like one whose GetDesc1 failed above
+				try
+				{
+					monitors.push_back(std::make_unique<monitor>(output6, device, pq10_input));
+				}
+				catch (std::runtime_error e)
+				{
+					printf("enum_monitors skipped an output: %s\n", e.what());
+				}
+
 				continue;
 			}
 		}
+
+		printf("enum_monitors: %zu monitors, %zu kept, %zu removed\n", monitors.size(), kept, previous.size());
 	}
 
-	bool compile_shader()
+	tonemap::input_format frame_format(com_ptr<ID3D11Texture2D> frame)
 	{
-		if (render_cs)
-		{
-#if _DEBUG
-			render_cs = nullptr;
-#else
-			return true;
-#endif
-		}
-
-#if _DEBUG
-		// compile tonemapping compute shader
-		com_ptr<ID3DBlob> shader;
-		com_ptr<ID3DBlob> error;
-
-		HRESULT hr = D3DCompileFromFile(
-			L"tonemapper.hlsl",
-			nullptr, D3D_COMPILE_STANDARD_FILE_INCLUDE,
-			"main", "cs_5_0",
-			D3DCOMPILE_ENABLE_STRICTNESS, 0,
-			shader, error
-		);
+		D3D11_TEXTURE2D_DESC desc;
+		frame->GetDesc(&desc);
 
-		if (error)
+		switch (desc.Format)
 		{
-			printf("compile_shader: %s\n", reinterpret_cast<const char*>(error->GetBufferPointer()));
-		}
-
-		if (FAILED(hr))
+		case DXGI_FORMAT_R16G16B16A16_FLOAT:
+			return tonemap::input_format::scrgb;
+		case DXGI_FORMAT_R10G10B10A2_UNORM:
+			return tonemap::input_format::pq10;
+		case DXGI_FORMAT_R8G8B8A8_UNORM:
+			return tonemap::input_format::sdr;
+		case DXGI_FORMAT_B8G8R8A8_UNORM:
+			return tonemap::input_format::bgra8;
+		default:
 		{
-			printf("compile_shader failed at line %d, hr = 0x%x\n", __LINE__, hr);
-			return false;
+			auto msg = std::format("unsupported duplication frame format {}", static_cast<int>(desc.Format));
+			throw std::runtime_error{ msg };
+		}
 		}
+	}
 
-		hr = device->CreateComputeShader(
-			shader->GetBufferPointer(), shader->GetBufferSize(),
-			nullptr, render_cs
-		);
+	// views own no memory of their own and are charged nothing, null on failure
+	com_ptr<ID3D11ShaderResourceView> cached_srv(ID3D11Texture2D* texture)
+	{
+		D3D11_TEXTURE2D_DESC desc;
+		texture->GetDesc(&desc);
 
-		if (FAILED(hr))
-		{
-			printf("compile_shader failed at line %d, hr = 0x%x\n", __LINE__, hr);
-			return false;
-		}
-#else
-		auto* const res = FindResourceA(self_instance, MAKEINTRESOURCE(TONEMAPPER_SHADER), RT_RCDATA);
-		if (!res)
-		{
-			printf("compile_shader resource not found\n");
-			return false;
-		}
+		gpu_resource resource;
+		gpu_resources.get({ gpu_resource_kind::srv, texture, desc.Format, desc.Width, desc.Height }, 0, resource, [&](gpu_resource& created) {
+			D3D11_SHADER_RESOURCE_VIEW_DESC view_desc = {};
+			view_desc.Format = desc.Format;
+			view_desc.ViewDimension = D3D11_SRV_DIMENSION_TEXTURE2D;
+			view_desc.Texture2D.MipLevels = 1;
 
-		auto* const handle = LoadResource(self_instance, res);
-		if (!handle)
-		{
-			printf("compile_shader failed to load resource\n");
-			return false;
-		}
+			return SUCCEEDED(device->CreateShaderResourceView(texture, &view_desc, created.srv));
+		});
 
-		const auto* bytecode = LockResource(handle);
-		const auto size = SizeofResource(self_instance, res);
+		return resource.srv;
+	}
 
-		HRESULT hr = device->CreateComputeShader(
-			bytecode, size,
-			nullptr, render_cs
-		);
+	com_ptr<ID3D11UnorderedAccessView> cached_uav(ID3D11Texture2D* texture)
+	{
+		D3D11_TEXTURE2D_DESC desc;
+		texture->GetDesc(&desc);
 
-		FreeResource(handle);
+		gpu_resource resource;
+		gpu_resources.get({ gpu_resource_kind::uav, texture, desc.Format, desc.Width, desc.Height }, 0, resource, [&](gpu_resource& created) {
+			D3D11_UNORDERED_ACCESS_VIEW_DESC view_desc = {};
+			view_desc.Format = DXGI_FORMAT_R8G8B8A8_UNORM;
+			view_desc.ViewDimension = D3D11_UAV_DIMENSION_TEXTURE2D;
+			view_desc.Texture2D.MipSlice = 0;
 
-		if (FAILED(hr))
-		{
-			printf("compile_shader failed at line %d, hr = 0x%x\n", __LINE__, hr);
-			return false;
-		}
-#endif
+			return SUCCEEDED(device->CreateUnorderedAccessView(texture, &view_desc, created.uav));
+		});
 
-		return true;
+		return resource.uav;
 	}
 
-	bool render(com_ptr<ID3D11Texture2D> input, com_ptr<ID3D11Texture2D> target)
+	// a cpu readable texture frame can be copied into, shared by every frame of the
+	// same size and format. Its content is whatever the last user left, null on failure
+	com_ptr<ID3D11Texture2D> cached_staging(com_ptr<ID3D11Texture2D> frame)
 	{
-		if (!compile_shader())
-			return false;
-
 		D3D11_TEXTURE2D_DESC desc;
-		input->GetDesc(&desc);
+		frame->GetDesc(&desc);
+		desc.Usage = D3D11_USAGE_STAGING;
+		desc.BindFlags = 0;
+		desc.MiscFlags = 0;
+		desc.CPUAccessFlags = D3D11_CPU_ACCESS_READ;
 
-		render_cb_data.is_hdr = desc.Format == DXGI_FORMAT_R16G16B16A16_FLOAT;
+		const size_t bytes = static_cast<size_t>(desc.Width) * desc.Height * tonemap::bytes_per_pixel(frame_format(frame));
 
-		com_ptr<ID3D11ShaderResourceView> src_srv;
-		D3D11_SHADER_RESOURCE_VIEW_DESC src_desc = {};
-		src_desc.Format = desc.Format;
-		src_desc.ViewDimension = D3D11_SRV_DIMENSION_TEXTURE2D;
-		src_desc.Texture2D.MipLevels = 1;
-		HRESULT hr = device->CreateShaderResourceView(input, &src_desc, src_srv);
+		gpu_resource resource;
+		gpu_resources.get({ gpu_resource_kind::staging, nullptr, desc.Format, desc.Width, desc.Height }, bytes, resource, [&](gpu_resource& created) {
+			return SUCCEEDED(device->CreateTexture2D(&desc, nullptr, created.tex));
+		});
 
-		if (FAILED(hr))
-		{
-			return false;
-		}
+		return resource.tex;
+	}
 
-		com_ptr<ID3D11UnorderedAccessView> dest_uav;
-		D3D11_UNORDERED_ACCESS_VIEW_DESC dest_desc = {};
-		dest_desc.Format = DXGI_FORMAT_B8G8R8A8_UNORM;
-		dest_desc.ViewDimension = D3D11_UAV_DIMENSION_TEXTURE2D;
-		dest_desc.Texture2D.MipSlice = 0;
-		hr = device->CreateUnorderedAccessView(target, &dest_desc, dest_uav);
+	// index into render_cs of the tonemapper.hlsl permutation for a monitor,
+	// the 4 sdr rotations first then 4 rotations per hdr operator
+	size_t shader_index(bool hdr, int rotation, tonemap::tone_operator op)
+	{
+		const size_t r = rotation / 90 & 3;
+		return hdr ? 4 + static_cast<size_t>(op) * 4 + r : r;
+	}
 
-		if (FAILED(hr))
+	bool compile_shader()
+	{
+		// permutations are created in order, the histogram pass last, so it existing
+		// means all do. Debug builds compile them from tonemapper.hlsl once too, until
+		// free_desktop_dup
+		if (histogram_cs)
+			return true;
+
+		for (size_t i = 0; i <= std::size(render_cs); i++)
 		{
-			return false;
+			// right after the render permutations, in the resources too
+			const bool histogram = i == std::size(render_cs);
+			auto& cs = histogram ? histogram_cs : render_cs[i];
+
+#if _DEBUG
+			// compile tonemapping compute shader
+			const char* const rotations[] = { "0", "90", "180", "270" };
+			const char* const operators[] = { "0", "1", "2", "3", "4", "5" };
+			const D3D_SHADER_MACRO defines[] =
+			{
+				{ "TONEMAP_HDR", i >= 4 ? "1" : "0" },
+				{ "TONEMAP_OPERATOR", operators[i >= 4 && !histogram ? (i - 4) / 4 : 0] },
+				{ "TONEMAP_ROTATION", rotations[i % 4] },
+				{ "TONEMAP_HISTOGRAM", histogram ? "1" : "0" },
+				{ nullptr, nullptr },
+			};
+
+			com_ptr<ID3DBlob> shader;
+			com_ptr<ID3DBlob> error;
+
+			HRESULT hr = D3DCompileFromFile(
+				L"tonemapper.hlsl",
+				defines, D3D_COMPILE_STANDARD_FILE_INCLUDE,
+				"main", "cs_5_0",
+				D3DCOMPILE_ENABLE_STRICTNESS, 0,
+				shader, error
+			);
+
+			if (error)
+			{
+				printf("compile_shader: %s\n", reinterpret_cast<const char*>(error->GetBufferPointer()));
+			}
+
+			if (FAILED(hr))
+			{
+				printf("compile_shader failed at line %d, hr = 0x%x\n", __LINE__, hr);
+				return false;
+			}
+
+			hr = device->CreateComputeShader(
+				shader->GetBufferPointer(), shader->GetBufferSize(),
+				nullptr, cs
+			);
+
+			if (FAILED(hr))
+			{
+				printf("compile_shader failed at line %d, hr = 0x%x\n", __LINE__, hr);
+				return false;
+			}
+#else
+			auto* const res = FindResourceA(self_instance, MAKEINTRESOURCE(TONEMAPPER_SHADER_SDR_0 + i), RT_RCDATA);
+			if (!res)
+			{
+				printf("compile_shader resource not found\n");
+				return false;
+			}
+
+			auto* const handle = LoadResource(self_instance, res);
+			if (!handle)
+			{
+				printf("compile_shader failed to load resource\n");
+				return false;
+			}
+
+			const auto* bytecode = LockResource(handle);
+			const auto size = SizeofResource(self_instance, res);
+
+			HRESULT hr = device->CreateComputeShader(
+				bytecode, size,
+				nullptr, cs
+			);
+
+			FreeResource(handle);
+
+			if (FAILED(hr))
+			{
+				printf("compile_shader failed at line %d, hr = 0x%x\n", __LINE__, hr);
+				return false;
+			}
+#endif
 		}
 
+		return true;
+	}
+
+	// render_cb_data and the pq eotf table, which every permutation reads
+	bool upload_constants()
+	{
+		HRESULT hr = S_OK;
+
 		if (!render_const_buffer)
 		{
 			D3D11_BUFFER_DESC cb_desc;
@@ -269,15 +581,59 @@ namespace
 			ctx->CSSetConstantBuffers(0, 1, render_const_buffer);
 		}
 
+		if (!pq_eotf_srv)
+		{
+			D3D11_BUFFER_DESC table_desc = {};
+			table_desc.ByteWidth = sizeof(float) * tonemap::pq_eotf_size;
+			table_desc.Usage = D3D11_USAGE_IMMUTABLE;
+			table_desc.BindFlags = D3D11_BIND_SHADER_RESOURCE;
+
+			D3D11_SUBRESOURCE_DATA table_data = {};
+			table_data.pSysMem = tonemap::pq_eotf_table();
+
+			hr = device->CreateBuffer(&table_desc, &table_data, pq_eotf_buffer);
+
+			if (FAILED(hr))
+				return false;
+
+			D3D11_SHADER_RESOURCE_VIEW_DESC table_srv_desc = {};
+			table_srv_desc.Format = DXGI_FORMAT_R32_FLOAT;
+			table_srv_desc.ViewDimension = D3D11_SRV_DIMENSION_BUFFER;
+			table_srv_desc.Buffer.NumElements = tonemap::pq_eotf_size;
+
+			hr = device->CreateShaderResourceView(pq_eotf_buffer, &table_srv_desc, pq_eotf_srv);
+
+			if (FAILED(hr))
+				return false;
+
+			ctx->CSSetShaderResources(1, 1, pq_eotf_srv);
+		}
+
 		D3D11_MAPPED_SUBRESOURCE mapped_cb;
 		ctx->Map(render_const_buffer, 0, D3D11_MAP_WRITE_DISCARD, 0, &mapped_cb);
 		memcpy(mapped_cb.pData, &render_cb_data, sizeof(render_constant_buffer_t));
 		ctx->Unmap(render_const_buffer, 0);
 
-		ctx->CSSetShader(render_cs, nullptr, 0);
+		return true;
+	}
+
+	bool render(com_ptr<ID3D11Texture2D> input, com_ptr<ID3D11Texture2D> target, ID3D11ComputeShader* cs)
+	{
+		com_ptr<ID3D11ShaderResourceView> src_srv = cached_srv(input);
+		if (!src_srv)
+			return false;
+
+		com_ptr<ID3D11UnorderedAccessView> dest_uav = cached_uav(target);
+		if (!dest_uav)
+			return false;
+
+		if (!upload_constants())
+			return false;
+
+		ctx->CSSetShader(cs, nullptr, 0);
 		ctx->CSSetShaderResources(0, 1, src_srv);
 		ctx->CSSetUnorderedAccessViews(0, 1, dest_uav, nullptr);
-		ctx->Dispatch((desc.Width + 15) / 16, (desc.Height + 15) / 16, 1);
+		ctx->Dispatch((render_cb_data.src_size[0] + 15) / 16, (render_cb_data.src_size[1] + 15) / 16, 1);
 
 		ctx->CSSetShader(nullptr, nullptr, 0);
 
@@ -290,23 +646,419 @@ namespace
 		return true;
 	}
 
-	void capture_frame(std::vector<uint8_t>& buffer, int width, int height)
+	// sdr monitors without rotation need no per pixel work on the gpu, the frame is
+	// copied into the virtual desktop. Returns false if the formats don't allow it
+	bool copy_region(com_ptr<ID3D11Texture2D> input, com_ptr<ID3D11Texture2D> target, int x, int y)
 	{
-		HRESULT hr = S_OK;
+		D3D11_TEXTURE2D_DESC src_desc;
+		input->GetDesc(&src_desc);
 
-		if (width != w || height != h)
+		D3D11_TEXTURE2D_DESC dest_desc;
+		target->GetDesc(&dest_desc);
+
+		if (src_desc.Format != dest_desc.Format)
+			return false;
+
+		// the box has to lie inside the target, where the shader just drops the writes
+		const int width = static_cast<int>(dest_desc.Width);
+		const int height = static_cast<int>(dest_desc.Height);
+		const int left = x > 0 ? x : 0;
+		const int top = y > 0 ? y : 0;
+		const int right = x + static_cast<int>(src_desc.Width) < width ? x + static_cast<int>(src_desc.Width) : width;
+		const int bottom = y + static_cast<int>(src_desc.Height) < height ? y + static_cast<int>(src_desc.Height) : height;
+
+		if (left >= right || top >= bottom)
+			return true;
+
+		D3D11_BOX box;
+		box.left = left - x;
+		box.top = top - y;
+		box.front = 0;
+		box.right = right - x;
+		box.bottom = bottom - y;
+		box.back = 1;
+
+		ctx->CopySubresourceRegion(target, 0, left, top, 0, input, 0, &box);
+
+		return true;
+	}
+
+	// the part of the virtual desktop a monitor covers that lies in region, empty if none does
+	tonemap::rect visible_area(const monitor& monitor, const tonemap::rect& region)
+	{
+		const auto [x, y] = monitor.virtual_position();
+		const auto [width, height] = monitor.resolution();
+
+		return tonemap::intersect({ x, y, x + width, y + height }, region);
+	}
+
+	// the monitors overlapping region by their desktop position as of the last output
+	// desc query. The rest are counted as skipped and not touched at all, acquiring
+	// a frame from them could block for a while
+	std::vector<monitor*> select_monitors(const tonemap::rect& region)
+	{
+		std::vector<monitor*> selected;
+
+		for (const auto& monitor : monitors)
+		{
+			if (visible_area(*monitor, region).empty())
+				capture_stats.monitors_skipped++;
+			else
+				selected.push_back(monitor.get());
+		}
+
+		capture_stats.captures++;
+		capture_stats.monitors_captured += selected.size();
+
+		return selected;
+	}
+
+	// visible_area taken into the monitor's frame, which is in its unrotated orientation
+	tonemap::rect source_area(const monitor& monitor, com_ptr<ID3D11Texture2D> frame, const tonemap::rect& visible)
+	{
+		D3D11_TEXTURE2D_DESC desc;
+		frame->GetDesc(&desc);
+
+		const int width = static_cast<int>(desc.Width);
+		const int height = static_cast<int>(desc.Height);
+		const auto [x, y] = monitor.virtual_position();
+
+		const tonemap::rect area = tonemap::unrotate(tonemap::offset(visible, -x, -y), static_cast<int>(monitor.rotation()), width, height);
+		return tonemap::intersect(area, { 0, 0, width, height });
+	}
+
+	// the white level a monitor's hdr frames are tone mapped to. estimated is set when it
+	// should come from the luminance histogram: windows doesn't report one or
+	// auto_white_level is on. Until there is an estimate that is the 200 nit default
+	float white_level_for(const monitor& monitor, bool& estimated)
+	{
+		float level;
+		estimated = auto_white_level || !monitor.query_sdr_white_level(level);
+
+		if (!estimated)
+			return level;
+
+		const float estimate = monitor.estimated_white_level();
+		return estimate > 0.0f ? estimate : monitor.sdr_white_level();
+	}
+
+	// the monitor's tables for white_level, only the blend operator needs any
+	tonemap::hdr_params hdr_params_for(monitor& monitor, float white_level, tonemap::luminance_histogram* histogram)
+	{
+		if (tone_op != tonemap::tone_operator::blend)
+			return { tone_op, white_level, nullptr, histogram };
+
+		return {
+			tone_op, white_level, &monitor.input_lut(white_level), histogram,
+			cube_lut_size ? &monitor.input_cube(white_level, cube_lut_size) : nullptr,
+		};
+	}
+
+	void update_estimate(monitor& monitor, const tonemap::luminance_histogram& histogram)
+	{
+		const float estimate = tonemap::estimate_white_level(histogram);
+		if (estimate > 0.0f)
+			monitor.set_estimated_white_level(estimate);
+	}
+
+	bool create_histogram_buffers()
+	{
+		D3D11_BUFFER_DESC bins_desc = {};
+		bins_desc.ByteWidth = sizeof(uint32_t) * tonemap::luminance_histogram::bin_count;
+		bins_desc.Usage = D3D11_USAGE_DEFAULT;
+		bins_desc.BindFlags = D3D11_BIND_UNORDERED_ACCESS;
+		bins_desc.MiscFlags = D3D11_RESOURCE_MISC_BUFFER_ALLOW_RAW_VIEWS;
+
+		HRESULT hr = device->CreateBuffer(&bins_desc, nullptr, histogram_buffer);
+		if (FAILED(hr))
+			return false;
+
+		D3D11_UNORDERED_ACCESS_VIEW_DESC uav_desc = {};
+		uav_desc.Format = DXGI_FORMAT_R32_TYPELESS;
+		uav_desc.ViewDimension = D3D11_UAV_DIMENSION_BUFFER;
+		uav_desc.Buffer.NumElements = tonemap::luminance_histogram::bin_count;
+		uav_desc.Buffer.Flags = D3D11_BUFFER_UAV_FLAG_RAW;
+
+		hr = device->CreateUnorderedAccessView(histogram_buffer, &uav_desc, histogram_uav);
+		if (FAILED(hr))
+			return false;
+
+		bins_desc.Usage = D3D11_USAGE_STAGING;
+		bins_desc.BindFlags = 0;
+		bins_desc.CPUAccessFlags = D3D11_CPU_ACCESS_READ;
+		bins_desc.MiscFlags = 0;
+
+		hr = device->CreateBuffer(&bins_desc, nullptr, histogram_staging);
+		return SUCCEEDED(hr);
+	}
+
+	// histograms a frame the compute shader is about to tonemap with the histogram pass
+	// of tonemapper.hlsl, only its counters are read back instead of the frame. Only done
+	// for monitors with an estimated white level, render_cb_data has to be set up for
+	// the frame already
+	bool estimate_white_level(monitor& monitor, com_ptr<ID3D11Texture2D> input)
+	{
+		D3D11_TEXTURE2D_DESC desc;
+		input->GetDesc(&desc);
+
+		if (!histogram_staging && !create_histogram_buffers())
+			return false;
+
+		com_ptr<ID3D11ShaderResourceView> src_srv = cached_srv(input);
+		if (!src_srv)
+			return false;
+
+		if (!upload_constants())
+			return false;
+
+		const UINT zero[4] = {};
+		ctx->ClearUnorderedAccessViewUint(histogram_uav, zero);
+
+		ctx->CSSetShader(histogram_cs, nullptr, 0);
+		ctx->CSSetShaderResources(0, 1, src_srv);
+		ctx->CSSetUnorderedAccessViews(1, 1, histogram_uav, nullptr);
+		ctx->Dispatch((desc.Width + 15) / 16, (desc.Height + 15) / 16, 1);
+
+		ctx->CSSetShader(nullptr, nullptr, 0);
+
+		src_srv = nullptr;
+		ctx->CSSetShaderResources(0, 1, src_srv);
+
+		com_ptr<ID3D11UnorderedAccessView> no_uav;
+		ctx->CSSetUnorderedAccessViews(1, 1, no_uav, nullptr);
+
+		ctx->CopyResource(histogram_staging, histogram_buffer);
+
+		// waits for the pass, there's no way around it with the white level needed for
+		// the render right after. It's 288 counters instead of the whole frame though
+		D3D11_MAPPED_SUBRESOURCE mapped;
+		HRESULT hr = ctx->Map(histogram_staging, 0, D3D11_MAP_READ, 0, &mapped);
+		if (FAILED(hr))
+			return false;
+
+		tonemap::luminance_histogram histogram;
+		histogram.add_counts(static_cast<const uint32_t*>(mapped.pData));
+
+		ctx->Unmap(histogram_staging, 0);
+
+		update_estimate(monitor, histogram);
+		return true;
+	}
+
+	// render_cpu for frames tone mapped at a known white level: only the tiles of the
+	// monitor's tile cache that lie in region and changed since they were last tone mapped
+	// are read back and converted, everything else is placed from the cache
+	bool render_cached(
+		monitor& monitor, com_ptr<ID3D11Texture2D> input, const tonemap::rect& region,
+		uint8_t* buffer, float white_level
+	)
+	{
+		D3D11_TEXTURE2D_DESC desc;
+		input->GetDesc(&desc);
+
+		const int width = static_cast<int>(desc.Width);
+		const int height = static_cast<int>(desc.Height);
+
+		const auto format = frame_format(input);
+		const bool is_hdr = tonemap::is_hdr(format);
+
+		auto& tiles = monitor.tiles();
+		tiles.reset(width, height, {
+			format,
+			is_hdr ? tone_op : tonemap::tone_operator::blend,
+			is_hdr ? white_level : 0.0f,
+		});
+
+		const auto runs = tiles.invalid_runs(source_area(monitor, input, visible_area(monitor, region)));
+
+		if (!runs.empty())
 		{
-			if (virtual_desktop_tex)
+			// only the runs are copied in, the rest of it is left over from other frames
+			com_ptr<ID3D11Texture2D> staging_tex = cached_staging(input);
+			if (!staging_tex)
+				return false;
+
+			for (const auto& run : runs)
 			{
-				virtual_desktop_tex = nullptr;
+				D3D11_BOX box;
+				box.left = run.left;
+				box.top = run.top;
+				box.front = 0;
+				box.right = run.right;
+				box.bottom = run.bottom;
+				box.back = 1;
+
+				ctx->CopySubresourceRegion(staging_tex, 0, run.left, run.top, 0, input, 0, &box);
 			}
 
-			enum_monitors();
+			D3D11_MAPPED_SUBRESOURCE mapped;
+			HRESULT hr = ctx->Map(staging_tex, 0, D3D11_MAP_READ, 0, &mapped);
+			if (FAILED(hr))
+				return false;
+
+			const tonemap::hdr_params hdr = hdr_params_for(monitor, white_level, nullptr);
+
+			// tiles converted in place into the cache, unrotated
+			const auto convert = tonemap::select_compose_kernel(format, 0);
+			const size_t bytes_per_pixel = tonemap::bytes_per_pixel(format);
+
+			for (const auto& run : runs)
+			{
+				for (int tile_x = run.left; tile_x < run.right; tile_x += tonemap::tile_cache::tile_size)
+				{
+					const int tile_right = tile_x + tonemap::tile_cache::tile_size < run.right ? tile_x + tonemap::tile_cache::tile_size : run.right;
+					const tonemap::rect tile = { tile_x, run.top, tile_right, run.bottom };
+
+					const auto* in = static_cast<const uint8_t*>(mapped.pData) + mapped.RowPitch * tile.top + bytes_per_pixel * tile.left;
+					auto* out = tiles.data() + tiles.pitch() * tile.top + 4 * static_cast<size_t>(tile.left);
+
+					// dirty rects are often coarser than what changed, and after recreating
+					// the duplication there are none. Tiles hashing the same are kept
+					const uint64_t hash = tonemap::dispatch_hash_rows(in, mapped.RowPitch, bytes_per_pixel * tile.width(), tile.height());
+
+					if (hash == tiles.hash(tile))
+					{
+						capture_stats.tiles_reused++;
+					}
+					else
+					{
+						convert(
+							{ in, mapped.RowPitch, tile.width(), tile.height() },
+							{ out, tiles.pitch(), tile.width(), tile.height() },
+							0, 0, is_hdr ? &hdr : nullptr
+						);
+
+						capture_stats.tiles_converted++;
+					}
+
+					tiles.validate(tile, hash);
+				}
+			}
+
+			ctx->Unmap(staging_tex, 0);
+		}
+
+		const auto [x, y] = monitor.virtual_position();
+		tonemap::place_bgra8(
+			{ tiles.data(), tiles.pitch(), width, height },
+			{ buffer, static_cast<size_t>(w) * 4, w, h },
+			x - region.left, y - region.top, static_cast<int>(monitor.rotation())
+		);
+
+		return true;
+	}
+
+	// tonemaps a monitor from its mapped frame into the output buffer, used when the
+	// compute shader isn't available
+	bool render_cpu(
+		monitor& monitor, com_ptr<ID3D11Texture2D> input, const tonemap::rect& region,
+		uint8_t* buffer, tonemap::compose_kernel compose
+	)
+	{
+		const auto format = frame_format(input);
+		const bool is_hdr = tonemap::is_hdr(format);
+
+		bool estimated;
+		float white_level = white_level_for(monitor, estimated);
+
+		// an estimated white level needs the luminance of the whole frame every time,
+		// anything else goes through the tile cache
+		if (!is_hdr || !estimated)
+			return render_cached(monitor, input, region, buffer, white_level);
+
+		D3D11_TEXTURE2D_DESC desc;
+		input->GetDesc(&desc);
+
+		com_ptr<ID3D11Texture2D> staging_tex = cached_staging(input);
+		if (!staging_tex)
+			return false;
+
+		ctx->CopyResource(staging_tex, input);
+
+		D3D11_MAPPED_SUBRESOURCE mapped;
+		HRESULT hr = ctx->Map(staging_tex, 0, D3D11_MAP_READ, 0, &mapped);
+		if (FAILED(hr))
+			return false;
+
+		const auto [x, y] = monitor.virtual_position();
+		const tonemap::source_frame src = { mapped.pData, mapped.RowPitch, static_cast<int>(desc.Width), static_cast<int>(desc.Height) };
+		const tonemap::canvas dest = { buffer, static_cast<size_t>(w) * 4, w, h };
+
+		tonemap::luminance_histogram histogram;
+
+		if (monitor.estimated_white_level() <= 0.0f)
+		{
+			// nothing to go on for the first frame, it gets a histogram pass of its own.
+			// Later frames are tone mapped with the estimate from the one before
+			tonemap::histogram_frame(src.data, src.pitch, src.width, src.height, format, histogram);
+			update_estimate(monitor, histogram);
+			white_level = white_level_for(monitor, estimated);
+			histogram.clear();
+		}
+
+		const tonemap::hdr_params hdr = hdr_params_for(monitor, white_level, &histogram);
+
+		compose(src, dest, x - region.left, y - region.top, &hdr);
+
+		ctx->Unmap(staging_tex, 0);
+
+		update_estimate(monitor, histogram);
+
+		return true;
+	}
+
+	// region is the part of the virtual desktop to capture, buffer gets it as
+	// region.width() x region.height() bgra pixels and has to have room for that. Monitors outside of it aren't
+	// acquired and of the others only the pixels inside are tone mapped and read back
+	void capture_frame(uint8_t* buffer, const tonemap::rect& region)
+	{
+		HRESULT hr = S_OK;
+		const int width = region.width();
+		const int height = region.height();
+
+		gpu_resources.next_frame(gpu_resource_max_age);
+
+		const bool outputs_changed = displays_changed.exchange(false);
+
+		// a region of another size only needs a texture of its own, the outputs are
+		// enumerated again only when displays_changed says they changed
+		if (width != w || height != h)
+		{
+			virtual_desktop_tex = nullptr;
 
 			w = width;
 			h = height;
 		}
 
+		if (outputs_changed)
+			enum_monitors();
+
+		if (!compile_shader())
+		{
+			printf("capture_frame: no compute shader, tonemapping on the cpu (%s)\n", tonemap::isa_name(tonemap::active_isa()));
+
+			memset(buffer, 0, static_cast<size_t>(w) * h * 4);
+
+			for (auto* monitor : select_monitors(region))
+			{
+				monitor->update_output_desc();
+
+				if (visible_area(*monitor, region).empty())
+					continue;
+
+				auto screenshot = monitor->take_screenshot();
+				const auto compose = tonemap::select_compose_kernel(frame_format(screenshot), static_cast<int>(monitor->rotation()));
+
+				if (!render_cpu(*monitor, screenshot, region, buffer, compose)) [[unlikely]]
+				{
+					auto name = monitor->name();
+					printf("failed to render monitor %s on the cpu\n", name.data());
+				}
+			}
+
+			return;
+		}
+
 		if (!virtual_desktop_tex)
 		{
 			D3D11_TEXTURE2D_DESC desc;
@@ -314,7 +1066,9 @@ namespace
 			desc.Height = h;
 			desc.MipLevels = 1;
 			desc.ArraySize = 1;
-			desc.Format = DXGI_FORMAT_B8G8R8A8_UNORM;
+			// same format as sdr duplication frames so those can be copied in as is,
+			// swizzled to bgra on readback
+			desc.Format = DXGI_FORMAT_R8G8B8A8_UNORM;
 			desc.SampleDesc.Count = 1;
 			desc.SampleDesc.Quality = 0;
 			desc.Usage = D3D11_USAGE_DEFAULT;
@@ -330,103 +1084,480 @@ namespace
 			}
 		}
 
-		for (const auto& monitor : monitors)
+		// the texture is reused for any region of the same size, whatever the monitors don't
+		// cover of this one has to come out black like on the cpu path, not as the last capture
+		com_ptr<ID3D11UnorderedAccessView> desktop_uav = cached_uav(virtual_desktop_tex);
+		if (!desktop_uav)
+			throw std::runtime_error{ "failed to create virtual desktop texture view" };
+
+		const float black[4] = {};
+		ctx->ClearUnorderedAccessViewFloat(desktop_uav, black);
+
+		for (auto* monitor : select_monitors(region))
 		{
 			monitor->update_output_desc();
-			const auto [x, y] = monitor->virtual_position();
-			const auto rotation = monitor->rotation();
-			const auto rad = rotation * (std::numbers::pi_v<float> / 180.f);
-
-			const auto sin_r = std::sinf(rad);
-			const auto cos_r = std::cosf(rad);
-
-			/*
-			*      cos() -sin() Tx
-			* Mt = sin()  cos() Ty
-			*      0       0      1
-			*/
-			render_cb_data.transform_matrix[0][0] = cos_r;
-			render_cb_data.transform_matrix[0][1] = -sin_r;
-			render_cb_data.transform_matrix[0][2] = static_cast<float>(x);
-
-			render_cb_data.transform_matrix[1][0] = sin_r;
-			render_cb_data.transform_matrix[1][1] = cos_r;
-			render_cb_data.transform_matrix[1][2] = static_cast<float>(y);
-
-			render_cb_data.transform_matrix[2][0] = 0;
-			render_cb_data.transform_matrix[2][1] = 0;
-			render_cb_data.transform_matrix[2][2] = 1;
-
-			printf("transform matrix: \n%.6f %.6f %.6f\n%.6f %.6f %.6f\n%.6f %.6f %.6f\n",
-				   render_cb_data.transform_matrix[0][0], render_cb_data.transform_matrix[0][1], render_cb_data.transform_matrix[0][2],
-				   render_cb_data.transform_matrix[1][0], render_cb_data.transform_matrix[1][1], render_cb_data.transform_matrix[1][2],
-				   render_cb_data.transform_matrix[2][0], render_cb_data.transform_matrix[2][1], render_cb_data.transform_matrix[2][2]
-			);
 
-			render_cb_data.white_level = monitor->sdr_white_level();
+			const auto visible = visible_area(*monitor, region);
+			if (visible.empty())
+				continue;
+
+			// placed relative to the region's corner, which is the texture's origin
+			const auto [monitor_x, monitor_y] = monitor->virtual_position();
+			const int x = monitor_x - region.left;
+			const int y = monitor_y - region.top;
+			render_cb_data.offset[0] = x;
+			render_cb_data.offset[1] = y;
 
 			auto screenshot = monitor->take_screenshot();
-			if (!render(screenshot, virtual_desktop_tex)) [[unlikely]]
+
+			const auto area = source_area(*monitor, screenshot, visible);
+			render_cb_data.src_origin[0] = area.left;
+			render_cb_data.src_origin[1] = area.top;
+			render_cb_data.src_size[0] = area.width();
+			render_cb_data.src_size[1] = area.height();
+
+			const auto format = frame_format(screenshot);
+			const bool hdr = tonemap::is_hdr(format);
+			render_cb_data.input_format = static_cast<int32_t>(format);
+
+			bool estimated;
+			render_cb_data.white_level = white_level_for(*monitor, estimated);
+
+			if (hdr && estimated)
+			{
+				if (estimate_white_level(*monitor, screenshot)) [[likely]]
+				{
+					render_cb_data.white_level = monitor->estimated_white_level();
+				}
+				else
+				{
+					auto name = monitor->name();
+					printf("failed to estimate the white level of monitor %s\n", name.data());
+				}
+			}
+			const int rotation = static_cast<int>(monitor->rotation());
+
+			bool rendered = false;
+			if (!hdr && rotation == 0)
+				rendered = copy_region(screenshot, virtual_desktop_tex, x, y);
+
+			if (!rendered)
+				rendered = render(screenshot, virtual_desktop_tex, render_cs[shader_index(hdr, rotation, tone_op)]);
+
+			if (!rendered) [[unlikely]]
 			{
 				auto name = monitor->name();
 				printf("failed to render monitor %s to virtual desktop texture\n", name.data());
 			}
 		}
 
-		D3D11_TEXTURE2D_DESC staging_desc;
-		virtual_desktop_tex->GetDesc(&staging_desc);
-		staging_desc.Usage = D3D11_USAGE_STAGING;
-		staging_desc.BindFlags = 0;
-		staging_desc.MiscFlags = 0;
-		staging_desc.CPUAccessFlags = D3D11_CPU_ACCESS_READ;
+		readback.backend().dest = buffer;
+		readback.read_frame(w, h);
+	}
+
+	// false if the variable isn't set or doesn't fit
+	bool read_env(const char* name, char* value, DWORD size)
+	{
+		const DWORD length = GetEnvironmentVariableA(name, value, size);
+		return length > 0 && length < size;
+	}
 
-		com_ptr<ID3D11Texture2D> staging_tex;
-		hr = device->CreateTexture2D(&staging_desc, nullptr, staging_tex);
-		if (FAILED(hr))
+	void load_settings()
+	{
+		char value[64];
+
+		if (read_env("BITBLT_HDR_OPERATOR", value, sizeof(value)))
 		{
-			auto msg = std::format("failed to create staging texture: {:x}", hr);
-			throw std::runtime_error{ msg };
+			if (!tonemap::find_operator(value, tone_op))
+				printf("unknown tone mapping operator %s, using %s\n", value, tonemap::operator_name(tone_op));
 		}
 
-		ctx->CopyResource(staging_tex, virtual_desktop_tex);
+		printf("tone mapping operator: %s\n", tonemap::operator_name(tone_op));
 
-		D3D11_MAPPED_SUBRESOURCE mapped;
-		ctx->Map(staging_tex, 0, D3D11_MAP_READ, 0, &mapped);
+		if (read_env("BITBLT_HDR_WHITE_LEVEL", value, sizeof(value)))
+		{
+			if (strcmp(value, "auto") == 0)
+				auto_white_level = true;
+			else if (strcmp(value, "os") != 0)
+				printf("unknown white level source %s, using os\n", value);
+		}
+
+		if (read_env("BITBLT_HDR_INPUT", value, sizeof(value)))
+		{
+			if (strcmp(value, "pq10") == 0)
+				pq10_input = true;
+			else if (strcmp(value, "fp16") != 0)
+				printf("unknown hdr input format %s, using fp16\n", value);
+		}
 
-		buffer.resize(staging_desc.Width * staging_desc.Height * 4);
+		if (read_env("BITBLT_HDR_CUBE_LUT", value, sizeof(value)))
+		{
+			const long size = strtol(value, nullptr, 10);
+			if (size == tonemap::cube_lut::small || size == tonemap::cube_lut::large)
+				cube_lut_size = static_cast<int>(size);
+			else if (size != 0)
+				printf("invalid cube lut size %s, tone mapping directly\n", value);
+		}
 
-		for (size_t i = 0; i < staging_desc.Height; i++)
+		if (read_env("BITBLT_HDR_GPU_CACHE_MB", value, sizeof(value)))
 		{
-			const auto* src = reinterpret_cast<uint8_t*>(mapped.pData) + mapped.RowPitch * i;
-			auto* dest = buffer.data() + (staging_desc.Width * 4 * i);
+			const long megabytes = strtol(value, nullptr, 10);
+			if (megabytes > 0)
+				gpu_resources.set_capacity(static_cast<size_t>(megabytes) << 20);
+			else
+				printf("invalid gpu cache size %s, using 256 MB\n", value);
+		}
 
-			std::memcpy(dest, src, staging_desc.Width * 4);
+		if (read_env("BITBLT_HDR_LARGE_PAGES", value, sizeof(value)) && strcmp(value, "0") != 0)
+		{
+			if (!tonemap::frame_buffers().use_large_pages(true))
+				printf("large pages aren't available, frame buffers use normal pages\n");
 		}
 
-		ctx->Unmap(staging_tex, 0);
+		if (read_env("BITBLT_HDR_WARM_CAPTURE", value, sizeof(value)))
+			warm_capture = strcmp(value, "0") != 0;
+	}
+
+	tonemap::rect virtual_screen()
+	{
+		const int left = GetSystemMetrics(SM_XVIRTUALSCREEN);
+		const int top = GetSystemMetrics(SM_YVIRTUALSCREEN);
+
+		return { left, top, left + GetSystemMetrics(SM_CXVIRTUALSCREEN), top + GetSystemMetrics(SM_CYVIRTUALSCREEN) };
+	}
+
+	// the only caller of capture_frame while warm capture is on. take_screenshot waits
+	// for the desktop to present, which paces the loop to the display
+	void warm_capture_loop()
+	{
+		while (!warm_stop)
+		{
+			auto& frame = warm_frames.back();
+			frame.area = virtual_screen();
+
+			try
+			{
+				const size_t bytes = static_cast<size_t>(frame.area.width()) * frame.area.height() * 4;
+				if (frame.pixels.size() != bytes)
+				{
+					frame.pixels = {};
+					frame.pixels = tonemap::frame_buffers().acquire(bytes);
+				}
+
+				capture_frame(frame.pixels.data(), frame.area);
+				warm_frames.publish();
+				SetEvent(warm_frame_ready);
+			}
+			catch (std::runtime_error e)
+			{
+				printf("warm capture failed to capture_frame, error: \n%s\n", e.what());
+				Sleep(100);
+			}
+		}
+	}
+
+	void start_warm_capture()
+	{
+		warm_frame_ready = CreateEventA(nullptr, TRUE, FALSE, nullptr);
+		warm_thread = std::thread(warm_capture_loop);
+	}
+
+	// false if the thread didn't finish in time, it can be stuck waiting for a desktop
+	// that doesn't present and still be using the device then
+	bool stop_warm_capture()
+	{
+		if (!warm_thread.joinable())
+			return true;
+
+		warm_stop = true;
+
+		if (WaitForSingleObject(warm_thread.native_handle(), 1000) != WAIT_OBJECT_0)
+		{
+			warm_thread.detach();
+			return false;
+		}
+
+		warm_thread.join();
+		return true;
+	}
+
+	LRESULT CALLBACK display_watch_proc(HWND window, UINT msg, WPARAM wparam, LPARAM lparam)
+	{
+		// resolution, arrangement, rotation and hdr toggles come as WM_DISPLAYCHANGE, some
+		// advanced color changes only as WM_SETTINGCHANGE
+		if (msg == WM_DISPLAYCHANGE || msg == WM_SETTINGCHANGE)
+			monitor::invalidate_topology();
+
+		if (msg == WM_DISPLAYCHANGE)
+			displays_changed = true;
+
+		return DefWindowProcA(window, msg, wparam, lparam);
+	}
+
+	// display changes are only broadcast to top level windows, so this keeps a hidden one
+	// for as long as the process runs. Message only windows don't get broadcasts
+	void display_watch_loop()
+	{
+		WNDCLASSA window_class = {};
+		window_class.lpfnWndProc = display_watch_proc;
+		window_class.hInstance = self_instance;
+		window_class.lpszClassName = "bitblt_hdr_display_watch";
+
+		RegisterClassA(&window_class);
+
+		auto window = CreateWindowExA(0, window_class.lpszClassName, "", WS_POPUP, 0, 0, 0, 0, nullptr, nullptr, self_instance, nullptr);
+		if (!window)
+		{
+			// the cached topology still expires, just up to a second late
+			printf("display_watch_loop failed to CreateWindowExA: %lx\n", GetLastError());
+			return;
+		}
+
+		MSG msg;
+		while (GetMessageA(&msg, nullptr, 0, 0) > 0)
+		{
+			TranslateMessage(&msg);
+			DispatchMessageA(&msg);
+		}
+	}
+
+	void start_display_watch()
+	{
+		std::thread(display_watch_loop).detach();
 	}
 
 	trampoline<decltype(BitBlt)> bitblt;
+
+	// region of the newest warm frame straight to hdc at (x, y), without waiting on
+	// duplication or the gpu once the first frame is there. Any number of callers read
+	// at once, each keeps the frame it blits from out of the warm thread's reach
+	BOOL blit_warm_frame(HDC hdc, int x, int y, const tonemap::rect& region, DWORD rop)
+	{
+		if (WaitForSingleObject(warm_frame_ready, 1000) != WAIT_OBJECT_0)
+			throw std::runtime_error{ "blit_warm_frame has no frame yet" };
+
+		const auto frame = warm_frames.read();
+		const tonemap::rect area = tonemap::intersect(region, frame->area);
+
+		// whatever lies outside of the desktop stays black
+		if (area != region)
+			PatBlt(hdc, x, y, region.width(), region.height(), BLACKNESS);
+
+		if (area.empty())
+			return TRUE;
+
+		// only the rows of area, top down, so the source starts at row 0. StretchDIBits
+		// counts source rows of top down dibs from the bottom otherwise
+		BITMAPINFO info = {};
+		info.bmiHeader.biSize = sizeof(info.bmiHeader);
+		info.bmiHeader.biWidth = frame->area.width();
+		info.bmiHeader.biHeight = -area.height();
+		info.bmiHeader.biPlanes = 1;
+		info.bmiHeader.biBitCount = 32;
+		info.bmiHeader.biCompression = BI_RGB;
+
+		const auto* bits = frame->pixels.data() + static_cast<size_t>(frame->area.width()) * 4 * (area.top - frame->area.top);
+
+		const int lines = StretchDIBits(
+			hdc, x + area.left - region.left, y + area.top - region.top, area.width(), area.height(),
+			area.left - frame->area.left, 0, area.width(), area.height(),
+			bits, &info, DIB_RGB_COLORS, rop & ~CAPTUREBLT
+		);
+
+		// done with the bits before the reader lets the warm thread refill them
+		GdiFlush();
+
+		return lines != 0 && lines != GDI_ERROR;
+	}
+
+	// a top down 32 bit dib section selected into a memory dc of its own. Captures are
+	// read back straight into its bits and blitted out of the dc, no copy in between
+	class dib_frame
+	{
+	public:
+		dib_frame(int width, int height) : width_(width), height_(height)
+		{
+			BITMAPINFO info = {};
+			info.bmiHeader.biSize = sizeof(info.bmiHeader);
+			info.bmiHeader.biWidth = width;
+			info.bmiHeader.biHeight = -height;
+			info.bmiHeader.biPlanes = 1;
+			info.bmiHeader.biBitCount = 32;
+			info.bmiHeader.biCompression = BI_RGB;
+
+			void* bits = nullptr;
+			bitmap_ = CreateDIBSection(nullptr, &info, DIB_RGB_COLORS, &bits, nullptr, 0);
+			dc_ = CreateCompatibleDC(nullptr);
+
+			if (!bitmap_ || !dc_)
+			{
+				release();
+				throw std::runtime_error{ std::format("failed to create a {}x{} dib section", width, height) };
+			}
+
+			bits_ = static_cast<uint8_t*>(bits);
+			previous_ = SelectObject(dc_, bitmap_);
+		}
+
+		~dib_frame()
+		{
+			release();
+		}
+
+		dib_frame(const dib_frame&) = delete;
+		dib_frame& operator=(const dib_frame&) = delete;
+
+		uint8_t* bits() const
+		{
+			return bits_;
+		}
+
+		HDC dc() const
+		{
+			return dc_;
+		}
+
+		int width() const
+		{
+			return width_;
+		}
+
+		int height() const
+		{
+			return height_;
+		}
+
+		// callers sharing a capture blit out of the dc one after the other
+		std::mutex& blit_lock()
+		{
+			return blit_lock_;
+		}
+
+	private:
+		void release()
+		{
+			if (dc_ && previous_)
+				SelectObject(dc_, previous_);
+			if (dc_)
+				DeleteDC(dc_);
+			if (bitmap_)
+				DeleteObject(bitmap_);
+		}
+
+		int width_;
+		int height_;
+		HBITMAP bitmap_ = nullptr;
+		HDC dc_ = nullptr;
+		HGDIOBJ previous_ = nullptr;
+		uint8_t* bits_ = nullptr;
+		std::mutex blit_lock_;
+	};
+
+	// frames of earlier captures, one is reused once nobody blits out of it anymore
+	std::vector<std::shared_ptr<dib_frame>> dib_frames;
+	constexpr size_t max_dib_frames = 4;
+
+	// a frame nobody else holds, only called under captures. The count of a frame in
+	// the list only goes up in here, so one seen unused stays unused
+	std::shared_ptr<dib_frame> get_dib_frame(int width, int height)
+	{
+		for (const auto& frame : dib_frames)
+		{
+			if (frame.use_count() == 1 && frame->width() == width && frame->height() == height)
+				return frame;
+		}
+
+		// unused frames of other sizes make room first
+		for (auto it = dib_frames.begin(); it != dib_frames.end() && dib_frames.size() >= max_dib_frames; )
+			it = it->use_count() == 1 ? dib_frames.erase(it) : it + 1;
+
+		auto frame = std::make_shared<dib_frame>(width, height);
+		if (dib_frames.size() < max_dib_frames)
+			dib_frames.push_back(frame);
+
+		return frame;
+	}
+
+	// bitblt can be called from several threads at once, callers asking for the same
+	// region while it's being captured share that capture. Anything else waits its turn,
+	// capture_frame and the globals it uses aren't safe to enter twice
+	single_flight<tonemap::rect, std::shared_ptr<dib_frame>> captures;
+
+#if _DEBUG
+	// capture_stats next to the counters of the caches and the readback ring
+	void print_capture_stats()
+	{
+		printf(
+			"captures: %llu, monitors captured: %llu, skipped: %llu, tiles converted: %llu, reused: %llu, readback stalls: %llu / %llu\n",
+			capture_stats.captures, capture_stats.monitors_captured, capture_stats.monitors_skipped,
+			capture_stats.tiles_converted, capture_stats.tiles_reused, readback.stalls(), readback.reads()
+		);
+
+		const auto& resources = gpu_resources.counters();
+		printf(
+			"gpu resources created: %llu, reused: %llu, destroyed: %llu, staging bytes: %zu\n",
+			resources.creations, resources.hits, resources.destroys, resources.bytes
+		);
+
+		printf("display topology queries: %llu\n", monitor::topology_queries());
+
+		const auto arena = tonemap::frame_buffers().counters();
+		printf(
+			"frame buffers reused: %llu, allocated: %llu, resident bytes: %zu, on large pages: %zu\n",
+			arena.hits, arena.misses, arena.bytes_resident, arena.large_page_bytes
+		);
+	}
+#endif
+
 	BOOL WINAPI bitblt_hook(HDC hdc, int x, int y, int cx, int cy, HDC hdcSrc, int x1, int y1, DWORD rop)
 	{
 		printf("bitblt called\n");
 
-		static bool inited = init_desktop_dup();
+		static bool inited = (load_settings(), init_desktop_dup());
 
 		if (!inited)
 			return bitblt(hdc, x, y, cx, cy, hdcSrc, x1, y1, rop);
 
+		static bool watching = (start_display_watch(), true);
+
 		auto src_window = WindowFromDC(hdcSrc);
 		auto desktop_window = GetDesktopWindow();
 
 		if (src_window != desktop_window)
 			return bitblt(hdc, x, y, cx, cy, hdcSrc, x1, y1, rop);
 
-		std::vector<uint8_t> buffer;
+		const tonemap::rect region = { x1, y1, x1 + cx, y1 + cy };
+
+		// warm frames are blitted from where the warm thread left them, callers don't
+		// wait on each other
+		if (warm_capture)
+		{
+			static bool warming = (start_warm_capture(), true);
+
+			try
+			{
+				return blit_warm_frame(hdc, x, y, region, rop);
+			}
+			catch (std::runtime_error e)
+			{
+				printf("failed to blit_warm_frame, error: \n%s\n", e.what());
+				return bitblt(hdc, x, y, cx, cy, hdcSrc, x1, y1, rop);
+			}
+		}
+
+		std::shared_ptr<const std::shared_ptr<dib_frame>> captured;
 
 		try
 		{
-			capture_frame(buffer, cx, cy);
+			captured = captures.run(region, [&](std::shared_ptr<dib_frame>& frame) {
+				frame = get_dib_frame(cx, cy);
+				capture_frame(frame->bits(), region);
+
+#if _DEBUG
+				if (capture_stats.captures % capture_stats_interval == 1)
+					print_capture_stats();
+#endif
+			});
 		}
 		catch (std::runtime_error e)
 		{
@@ -434,14 +1565,13 @@ namespace
 			return bitblt(hdc, x, y, cx, cy, hdcSrc, x1, y1, rop);
 		}
 
-		HBITMAP map = CreateBitmap(cx, cy, 1, 32, buffer.data());
-		HDC src = CreateCompatibleDC(hdc);
-		SelectObject(src, map);
+		auto& frame = **captured;
+		std::lock_guard lock(frame.blit_lock());
 
-		auto result = bitblt(hdc, x, y, cx, cy, src, x1, y1, rop & ~CAPTUREBLT);
-
-		DeleteDC(src);
-		DeleteObject(map);
+		// the frame already starts at (x1, y1) of the desktop. Flushed before the frame can
+		// be handed to the next capture, which writes its bits without going through gdi
+		auto result = bitblt(hdc, x, y, cx, cy, frame.dc(), 0, 0, rop & ~CAPTUREBLT);
+		GdiFlush();
 
 		return result;
 	}
@@ -449,10 +1579,23 @@ namespace
 	void free_desktop_dup()
 	{
 		monitors.clear();
+		readback.clear();
+		gpu_resources.clear();
+		dib_frames.clear();
+
+		// a device created again enumerates its outputs on its first capture
+		displays_changed = true;
 
 		render_const_buffer = nullptr;
+		pq_eotf_srv = nullptr;
+		pq_eotf_buffer = nullptr;
+		histogram_uav = nullptr;
+		histogram_buffer = nullptr;
+		histogram_staging = nullptr;
+		histogram_cs = nullptr;
 		virtual_desktop_tex = nullptr;
-		render_cs = nullptr;
+		for (auto& cs : render_cs)
+			cs = nullptr;
 		ctx = nullptr;
 		device = nullptr;
 	}
@@ -460,7 +1603,10 @@ namespace
 	trampoline<void WINAPI(UINT)> exit_process;
 	void exit_process_hook(UINT code)
 	{
-		free_desktop_dup();
+		// a thread still capturing keeps the device, the process is going away anyway
+		if (stop_warm_capture())
+			free_desktop_dup();
+
 		exit_process(code);
 	}
 
@@ -1,10 +1,12 @@
 #define WIN32_LEAN_AND_MEAN
 #include <Windows.h>
 
+#include <chrono>
 #include <format>
 #include <vector>
 
 #include "monitor.hpp"
+#include "utils/topology_cache.hpp"
 
 // https://chromium.googlesource.com/chromium/src/+/c71f15ab1ace78c7efeeeda9f8552b4af9db2877/ui/display/win/screen_win.cc#112
 bool get_path_info(HMONITOR monitor, DISPLAYCONFIG_PATH_INFO* path_info)
@@ -62,14 +64,83 @@ bool get_path_info(HMONITOR monitor, DISPLAYCONFIG_PATH_INFO* path_info)
 	return false;
 }
 
-monitor::monitor(com_ptr<IDXGIOutput6> output, com_ptr<ID3D11Device> device) :
-	output_(output), device_(device)
+namespace
+{
+	// sdr content brightness from the windows display settings of the monitor
+	bool query_white_level(HMONITOR monitor, float& level)
+	{
+		DISPLAYCONFIG_PATH_INFO path_info = {};
+		if (!get_path_info(monitor, &path_info))
+			return false;
+
+		DISPLAYCONFIG_SDR_WHITE_LEVEL white_level = {};
+		white_level.header.type = DISPLAYCONFIG_DEVICE_INFO_GET_SDR_WHITE_LEVEL;
+		white_level.header.size = sizeof(white_level);
+		white_level.header.adapterId = path_info.targetInfo.adapterId;
+		white_level.header.id = path_info.targetInfo.id;
+		if (DisplayConfigGetDeviceInfo(&white_level.header) != ERROR_SUCCESS)
+			return false;
+
+		level = white_level.SDRWhiteLevel * 80.0f / 1000.0f;
+		return true;
+	}
+
+	struct output_topology
+	{
+		DXGI_OUTPUT_DESC1 desc;
+		bool has_white_level;
+		float white_level;
+	};
+
+	struct topology_provider
+	{
+		// of the last failed query
+		HRESULT error = S_OK;
+
+		bool query(IDXGIOutput6* output, output_topology& topology)
+		{
+			const HRESULT hr = output->GetDesc1(&topology.desc);
+			if (FAILED(hr))
+			{
+				error = hr;
+				return false;
+			}
+
+			topology.has_white_level = query_white_level(topology.desc.Monitor, topology.white_level);
+			return true;
+		}
+
+		std::chrono::steady_clock::time_point now()
+		{
+			return std::chrono::steady_clock::now();
+		}
+	};
+
+	using output_topology_cache = topology_cache<IDXGIOutput6*, output_topology, topology_provider>;
+
+	// the windows sdr white level slider doesn't announce its changes, they're picked
+	// up within a second. Never destroyed, monitors can outlive static destruction here
+	output_topology_cache& topology()
+	{
+		static auto* cache = new output_topology_cache{ topology_provider{}, std::chrono::seconds(1) };
+		return *cache;
+	}
+}
+
+monitor::monitor(com_ptr<IDXGIOutput6> output, com_ptr<ID3D11Device> device, bool pq10_input) :
+	output_(output), device_(device), pq10_input_(pq10_input)
 {
 	memset(&desc_, 0, sizeof(DXGI_OUTPUT_DESC1));
+
+	// known up front so monitors can be picked by position before their first capture
+	update_output_desc();
 }
 
 monitor::~monitor()
 {
+	// the next output created can get the same address
+	topology().forget(output_.get());
+
 	last_tex_ = nullptr;
 	dup_ = nullptr;
 	output_ = nullptr;
@@ -101,6 +172,16 @@ vec2_t monitor::virtual_position() const
 	return { coords.left, coords.top };
 }
 
+bool monitor::same_output(const DXGI_OUTPUT_DESC1& desc) const
+{
+	const auto& coords = desc_.DesktopCoordinates;
+	const auto& other = desc.DesktopCoordinates;
+
+	return wcscmp(desc_.DeviceName, desc.DeviceName) == 0
+		&& coords.left == other.left && coords.top == other.top
+		&& coords.right == other.right && coords.bottom == other.bottom;
+}
+
 float monitor::rotation() const
 {
 	switch (desc_.Rotation)
@@ -129,19 +210,44 @@ float monitor::sdr_white_level() const
 {
 	const float default_white_level = 200.0f;
 
-	DISPLAYCONFIG_PATH_INFO path_info = {};
-	if (!get_path_info(desc_.Monitor, &path_info))
-		return default_white_level; // default
+	float level;
+	return query_sdr_white_level(level) ? level : default_white_level;
+}
+
+bool monitor::query_sdr_white_level(float& level) const
+{
+	if (!has_white_level_)
+		return false;
 
-	DISPLAYCONFIG_SDR_WHITE_LEVEL white_level = {};
-	white_level.header.type = DISPLAYCONFIG_DEVICE_INFO_GET_SDR_WHITE_LEVEL;
-	white_level.header.size = sizeof(white_level);
-	white_level.header.adapterId = path_info.targetInfo.adapterId;
-	white_level.header.id = path_info.targetInfo.id;
-	if (DisplayConfigGetDeviceInfo(&white_level.header) != ERROR_SUCCESS)
-		return default_white_level;
+	level = white_level_;
+	return true;
+}
 
-	return white_level.SDRWhiteLevel * 80.0f / 1000.0f;
+float monitor::estimated_white_level() const
+{
+	return estimated_white_level_;
+}
+
+void monitor::set_estimated_white_level(float level)
+{
+	estimated_white_level_ = level;
+}
+
+const tonemap::half_lut& monitor::input_lut(float white_level)
+{
+	input_lut_.update(white_level);
+	return input_lut_;
+}
+
+const tonemap::cube_lut& monitor::input_cube(float white_level, int size)
+{
+	input_cube_.update(white_level, size);
+	return input_cube_;
+}
+
+tonemap::tile_cache& monitor::tiles()
+{
+	return tiles_;
 }
 
 com_ptr<ID3D11Texture2D> monitor::take_screenshot()
@@ -197,6 +303,10 @@ com_ptr<ID3D11Texture2D> monitor::take_screenshot()
 			auto msg = std::format("failed to acquire next frame on monitor {}: {:x}", name(), hr);
 			throw std::runtime_error{ msg };
 		}
+
+		// only this frame knows what changed since the one before
+		if (frame_info.TotalMetadataBufferSize)
+			update_tiles(frame_info.TotalMetadataBufferSize);
 	}
 
 	com_ptr<ID3D11Texture2D> tex = resource.as<ID3D11Texture2D>();
@@ -216,12 +326,22 @@ void monitor::recreate_output_duplication()
 	if (dup_)
 	{
 		dup_ = nullptr;
+
+		// access is lost on mode changes, the cached desc can be out of date
+		topology().invalidate();
 	}
 
+	// whatever changed while there was no duplication went unreported
+	tiles_.invalidate_all();
+
+	update_output_desc();
+
+	// dxgi picks the closest match to the desktop format, so fp16 is left out
+	// entirely when hdr outputs should come as pq
 	const DXGI_FORMAT formats[] = 
 	{
 		DXGI_FORMAT_R8G8B8A8_UNORM,
-		DXGI_FORMAT_R16G16B16A16_FLOAT,
+		pq10_input_ && hdr_on() ? DXGI_FORMAT_R10G10B10A2_UNORM : DXGI_FORMAT_R16G16B16A16_FLOAT,
 	};
 
 	auto hr = output_->DuplicateOutput1(device_, 0, 2, formats, dup_);
@@ -231,17 +351,68 @@ void monitor::recreate_output_duplication()
 		auto msg = std::format("recreate_output_duplication DuplicateOutput1 failed on monitor {}: {:X}", name(), static_cast<unsigned long>(hr));
 		throw std::runtime_error{ msg };
 	}
-
-	update_output_desc();
 }
 
 void monitor::update_output_desc()
 {
-	auto hr = output_->GetDesc1(&desc_);
+	output_topology current;
 
-	if (FAILED(hr))
+	if (!topology().get(output_.get(), current))
 	{
-		auto msg = std::format("update_output_desc GetDesc1 failed on monitor {}: {:X}", name(), static_cast<unsigned long>(hr));
+		auto msg = std::format("update_output_desc GetDesc1 failed on monitor {}: {:X}", name(), static_cast<unsigned long>(topology().provider().error));
 		throw std::runtime_error{ msg };
 	}
+
+	desc_ = current.desc;
+	has_white_level_ = current.has_white_level;
+	white_level_ = current.white_level;
+}
+
+void monitor::invalidate_topology()
+{
+	topology().invalidate();
+}
+
+uint64_t monitor::topology_queries()
+{
+	return topology().queries();
+}
+
+void monitor::update_tiles(UINT metadata_size)
+{
+	// nothing cached yet, reset() starts out all invalid anyway
+	if (!tiles_.width())
+		return;
+
+	metadata_.resize(metadata_size);
+
+	UINT move_size = 0;
+	auto* moves = reinterpret_cast<DXGI_OUTDUPL_MOVE_RECT*>(metadata_.data());
+	auto hr = dup_->GetFrameMoveRects(metadata_size, moves, &move_size);
+
+	if (FAILED(hr)) [[unlikely]]
+	{
+		tiles_.invalidate_all();
+		return;
+	}
+
+	// moves come first, the dirty rects are relative to the moved image
+	for (UINT i = 0; i < move_size / sizeof(DXGI_OUTDUPL_MOVE_RECT); i++)
+	{
+		const auto& to = moves[i].DestinationRect;
+		tiles_.move(moves[i].SourcePoint.x, moves[i].SourcePoint.y, { to.left, to.top, to.right, to.bottom });
+	}
+
+	UINT dirty_size = 0;
+	auto* dirty = reinterpret_cast<RECT*>(metadata_.data() + move_size);
+	hr = dup_->GetFrameDirtyRects(metadata_size - move_size, dirty, &dirty_size);
+
+	if (FAILED(hr)) [[unlikely]]
+	{
+		tiles_.invalidate_all();
+		return;
+	}
+
+	for (UINT i = 0; i < dirty_size / sizeof(RECT); i++)
+		tiles_.invalidate({ dirty[i].left, dirty[i].top, dirty[i].right, dirty[i].bottom });
 }
@@ -1,36 +1,84 @@
 #pragma once
 #include <tuple>
+#include <vector>
 #include <dxgi1_6.h>
 #include <d3d11.h>
 #include "utils/com_ptr.hpp"
+#include "tonemap/half_lut.hpp"
+#include "tonemap/cube_lut.hpp"
+#include "tonemap/tile_cache.hpp"
 
 using vec2_t = std::tuple<int, int>;
 
 class monitor
 {
 public:
-	monitor(com_ptr<IDXGIOutput6> output, com_ptr<ID3D11Device> device);
+	// pq10_input offers R10G10B10A2 to hdr outputs instead of fp16, half the bytes per frame
+	monitor(com_ptr<IDXGIOutput6> output, com_ptr<ID3D11Device> device, bool pq10_input = false);
 	~monitor();
 
 	std::string name();
 	bool hdr_on() const;
 	vec2_t virtual_position() const;
+
+	// desc is of the same output at the same desktop coordinates as this monitor, as of the
+	// last update_output_desc. Its duplication can be kept then, see enum_monitors
+	bool same_output(const DXGI_OUTPUT_DESC1& desc) const;
+
 	float rotation() const;
 	vec2_t resolution() const;
 	float sdr_white_level() const;
 
+	// sdr content brightness from the windows display settings, false when it can't be read.
+	// As of the last update_output_desc
+	bool query_sdr_white_level(float& level) const;
+
+	// white level guessed from this monitor's luminance histogram, 0 before the first one
+	float estimated_white_level() const;
+	void set_estimated_white_level(float level);
+
+	// decode table for this monitor's fp16 frames, rebuilt when white_level changes
+	const tonemap::half_lut& input_lut(float white_level);
+
+	// the blend operator baked for this monitor, rebuilt when white_level or size changes
+	const tonemap::cube_lut& input_cube(float white_level, int size);
+
+	// this monitor's tone mapped pixels from earlier captures, kept up to date with the
+	// move and dirty rects of every frame take_screenshot acquires
+	tonemap::tile_cache& tiles();
+
 	com_ptr<ID3D11Texture2D> take_screenshot();
+
+	// desc and sdr white level from a cache shared by all monitors, only queried from the
+	// system again after invalidate_topology() or once they're a second old
 	void update_output_desc();
 
+	// display settings changed, safe to call from any thread
+	static void invalidate_topology();
+
+	// how often update_output_desc had to query the system so far
+	static uint64_t topology_queries();
+
 private:
 	void recreate_output_duplication();
 
+	// replays the frame's move rects on tiles_ and invalidates its dirty rects
+	void update_tiles(UINT metadata_size);
+
 	com_ptr<IDXGIOutput6> output_;
 	com_ptr<IDXGIOutputDuplication> dup_;
 	com_ptr<ID3D11Device> device_;
 	com_ptr<ID3D11Texture2D> last_tex_;
 
 	DXGI_OUTPUT_DESC1 desc_;
+	tonemap::half_lut input_lut_;
+	tonemap::cube_lut input_cube_;
+	tonemap::tile_cache tiles_;
+	std::vector<uint8_t> metadata_;
+	bool pq10_input_;
+	bool has_white_level_ = false;
+	float white_level_ = 0.0f;
+	float estimated_white_level_ = 0.0f;
 
 	std::string name_;
 };
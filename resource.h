@@ -13,4 +13,32 @@
 #endif
 #endif
 
-#define TONEMAPPER_SHADER                300
+#define TONEMAPPER_SHADER_SDR_0                  300
+#define TONEMAPPER_SHADER_SDR_90                 301
+#define TONEMAPPER_SHADER_SDR_180                302
+#define TONEMAPPER_SHADER_SDR_270                303
+#define TONEMAPPER_SHADER_HDR_BLEND_0            304
+#define TONEMAPPER_SHADER_HDR_BLEND_90           305
+#define TONEMAPPER_SHADER_HDR_BLEND_180          306
+#define TONEMAPPER_SHADER_HDR_BLEND_270          307
+#define TONEMAPPER_SHADER_HDR_REINHARD_0         308
+#define TONEMAPPER_SHADER_HDR_REINHARD_90        309
+#define TONEMAPPER_SHADER_HDR_REINHARD_180       310
+#define TONEMAPPER_SHADER_HDR_REINHARD_270       311
+#define TONEMAPPER_SHADER_HDR_HABLE_0            312
+#define TONEMAPPER_SHADER_HDR_HABLE_90           313
+#define TONEMAPPER_SHADER_HDR_HABLE_180          314
+#define TONEMAPPER_SHADER_HDR_HABLE_270          315
+#define TONEMAPPER_SHADER_HDR_ACES_0             316
+#define TONEMAPPER_SHADER_HDR_ACES_90            317
+#define TONEMAPPER_SHADER_HDR_ACES_180           318
+#define TONEMAPPER_SHADER_HDR_ACES_270           319
+#define TONEMAPPER_SHADER_HDR_BT2390_0           320
+#define TONEMAPPER_SHADER_HDR_BT2390_90          321
+#define TONEMAPPER_SHADER_HDR_BT2390_180         322
+#define TONEMAPPER_SHADER_HDR_BT2390_270         323
+#define TONEMAPPER_SHADER_HDR_AGX_0              324
+#define TONEMAPPER_SHADER_HDR_AGX_90             325
+#define TONEMAPPER_SHADER_HDR_AGX_180            326
+#define TONEMAPPER_SHADER_HDR_AGX_270            327
+#define TONEMAPPER_SHADER_HISTOGRAM              328
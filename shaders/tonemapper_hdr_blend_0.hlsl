@@ -0,0 +1,4 @@
+#define TONEMAP_HDR 1
+#define TONEMAP_OPERATOR 0
+#define TONEMAP_ROTATION 0
+#include "../tonemapper.hlsl"
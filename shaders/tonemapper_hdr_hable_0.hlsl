@@ -0,0 +1,4 @@
+#define TONEMAP_HDR 1
+#define TONEMAP_OPERATOR 2
+#define TONEMAP_ROTATION 0
+#include "../tonemapper.hlsl"
@@ -0,0 +1,4 @@
+#define TONEMAP_HDR 1
+#define TONEMAP_OPERATOR 1
+#define TONEMAP_ROTATION 90
+#include "../tonemapper.hlsl"
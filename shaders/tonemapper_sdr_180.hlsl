@@ -0,0 +1,3 @@
+#define TONEMAP_HDR 0
+#define TONEMAP_ROTATION 180
+#include "../tonemapper.hlsl"
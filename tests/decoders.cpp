@@ -0,0 +1,184 @@
+#include <cmath>
+#include <cstdint>
+#include <random>
+#include <vector>
+
+#include "tonemap/tonemap.hpp"
+#include "tonemap/dispatch.hpp"
+#include "tonemap/half_lut.hpp"
+#include "tonemap/operators.hpp"
+#include "tonemap/pq10.hpp"
+
+#include "test.hpp"
+#include "frames.hpp"
+
+// the fp16 and pq10 input decoders against their scalar references
+namespace
+{
+	using namespace tonemap;
+
+	constexpr float white_levels[] = { 80.0f, 200.0f, 480.0f };
+
+	uint32_t pack_pq10(int r, int g, int b)
+	{
+		return static_cast<uint32_t>(r) | static_cast<uint32_t>(g) << 10 | static_cast<uint32_t>(b) << 20 | 3u << 30;
+	}
+
+	// R10G10B10A2 codes across the whole range, weighted towards the sdr part like a desktop
+	std::vector<uint32_t> pq10_frame(int width, int height, uint32_t seed)
+	{
+		std::mt19937 rng(seed);
+		std::uniform_int_distribution<int> sdr(0, 600);
+		std::uniform_int_distribution<int> any(0, 1023);
+		std::bernoulli_distribution highlight(0.2);
+
+		std::vector<uint32_t> frame(static_cast<size_t>(width) * height);
+		for (auto& pixel : frame)
+		{
+			auto& codes = highlight(rng) ? any : sdr;
+			pixel = pack_pq10(codes(rng), codes(rng), codes(rng));
+		}
+
+		return frame;
+	}
+}
+
+TEST(decoders, half_round_trip)
+{
+	// every half that isn't a nan survives float and back, nans stay nans
+	for (uint32_t i = 0; i < 65536; i++)
+	{
+		const auto half = static_cast<uint16_t>(i);
+		const float value = half_to_float(half);
+
+		if (std::isnan(value))
+			CHECK((float_to_half(value) & 0x7c00) == 0x7c00 && (float_to_half(value) & 0x3ff) != 0);
+		else
+			CHECK(float_to_half(value) == half);
+	}
+}
+
+TEST(decoders, half_lut_matches_hdr_decode)
+{
+	half_lut lut;
+
+	for (const float white_level : white_levels)
+	{
+		CHECK(lut.update(white_level));
+		CHECK(!lut.update(white_level));
+
+		for (uint32_t i = 0; i < half_lut::size; i++)
+		{
+			const float expected = hdr_decode(half_to_float(static_cast<uint16_t>(i)), white_level);
+			const float actual = lut[static_cast<uint16_t>(i)];
+
+			CHECK(actual == expected || (std::isnan(actual) && std::isnan(expected)));
+		}
+	}
+}
+
+TEST(decoders, pq_eotf)
+{
+	const float* eotf = pq_eotf_table();
+
+	// scRGB units, 1 = 80 nits
+	CHECK(eotf[0] == 0.0f);
+	CHECK(std::abs(eotf[pq_eotf_size - 1] * 80.0f - 10000.0f) < 0.5f);
+
+	for (int i = 1; i < pq_eotf_size; i++)
+		CHECK(eotf[i] > eotf[i - 1]);
+
+	// 203 nit reference white through a 10 bit code and back is within a code's step
+	const int code = static_cast<int>(std::lround(pq_encode(203.0f / 10000.0f) * (pq_eotf_size - 1)));
+	CHECK(eotf[code - 1] * 80.0f < 203.0f);
+	CHECK(eotf[code + 1] * 80.0f > 203.0f);
+	CHECK(std::abs(eotf[code] * 80.0f - 203.0f) < 203.0f * 0.01f);
+
+	for (int i = 0; i < pq_eotf_size; i++)
+	{
+		const float signal = static_cast<float>(i) / (pq_eotf_size - 1);
+		CHECK(std::abs(pq_encode(pq_decode(signal)) - signal) < 1e-4f);
+	}
+}
+
+TEST(decoders, pq10_grey_stays_grey)
+{
+	// bt.2020 and bt.709 share their white point
+	for (const int code : { 0, 100, 520, 767, 1023 })
+	{
+		const float3 color = pq10_to_scrgb(pack_pq10(code, code, code));
+		const float expected = pq_eotf_table()[code];
+
+		CHECK(std::abs(color.r - expected) <= expected * 1e-4f + 1e-6f);
+		CHECK(std::abs(color.g - expected) <= expected * 1e-4f + 1e-6f);
+		CHECK(std::abs(color.b - expected) <= expected * 1e-4f + 1e-6f);
+	}
+}
+
+TEST(decoders, pq10_kernels)
+{
+	// every simd kernel within one 8 bit step of pq10_to_bgra8 for every operator
+	for (int level = 1; level <= static_cast<int>(detect_isa()); level++)
+	{
+		const auto kernel = select_pq10_kernel(static_cast<isa>(level));
+		if (kernel == select_pq10_kernel(static_cast<isa>(level - 1)))
+			continue;
+
+		for (int i = 0; i < tone_operator_count; i++)
+		{
+			const auto op = static_cast<tone_operator>(i);
+
+			for (const int width : test::odd_widths)
+			{
+				for (const float white_level : white_levels)
+				{
+					const auto frame = pq10_frame(width, 3, width);
+
+					test::canvas expected(width, 3);
+					test::canvas actual(width, 3);
+
+					pq10_to_bgra8(frame.data(), static_cast<size_t>(width) * 4, expected.data(), expected.pitch, width, 3, white_level, op);
+					kernel(frame.data(), static_cast<size_t>(width) * 4, actual.data(), actual.pitch, width, 3, white_level, op);
+
+					CHECK(compare_bgra8(expected.data(), expected.pitch, actual.data(), actual.pitch, width, 3).max_error <= 1);
+					CHECK(actual.padding_intact());
+				}
+			}
+		}
+	}
+}
+
+TEST(decoders, pq10_matches_fp16)
+{
+	// a pq10 frame tone maps like the same colors handed over as fp16 scRGB, up to the
+	// rounding of the halves
+	const int width = 64;
+	const int height = 16;
+	const auto frame = pq10_frame(width, height, 10);
+
+	std::vector<uint16_t> halves(static_cast<size_t>(width) * height * 4);
+	for (size_t i = 0; i < frame.size(); i++)
+	{
+		const float3 color = pq10_to_scrgb(frame[i]);
+		halves[i * 4 + 0] = float_to_half(color.r);
+		halves[i * 4 + 1] = float_to_half(color.g);
+		halves[i * 4 + 2] = float_to_half(color.b);
+		halves[i * 4 + 3] = float_to_half(1.0f);
+	}
+
+	for (int i = 0; i < tone_operator_count; i++)
+	{
+		const auto op = static_cast<tone_operator>(i);
+
+		for (const float white_level : white_levels)
+		{
+			test::canvas pq10(width, height);
+			test::canvas fp16(width, height);
+
+			pq10_to_bgra8(frame.data(), static_cast<size_t>(width) * 4, pq10.data(), pq10.pitch, width, height, white_level, op);
+			hdr_to_bgra8(halves.data(), static_cast<size_t>(width) * 8, fp16.data(), fp16.pitch, width, height, white_level, op);
+
+			CHECK(compare_bgra8(pq10.data(), pq10.pitch, fp16.data(), fp16.pitch, width, height).max_error <= 1);
+		}
+	}
+}
@@ -0,0 +1,226 @@
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <utility>
+#include <vector>
+
+#include "tonemap/frame_arena.hpp"
+
+#include "test.hpp"
+
+// frame_arena on its own page source, which counts what goes to and from the system
+// and can refuse large pages the way a fragmented system does
+namespace
+{
+	using tonemap::frame_arena;
+
+	constexpr size_t page = 4096;
+	constexpr size_t fake_large_page = 64 * page;
+
+	struct mock_pages
+	{
+		int allocations = 0;
+		int large_allocations = 0;
+		int frees = 0;
+		size_t large_page_size = 0;
+		bool refuse_large = false;
+	};
+
+	mock_pages pages;
+
+	uint8_t* mock_allocate(size_t size, bool large)
+	{
+		if (large && pages.refuse_large)
+			return nullptr;
+
+		pages.allocations++;
+		pages.large_allocations += large;
+		return static_cast<uint8_t*>(std::aligned_alloc(page, size));
+	}
+
+	void mock_free(uint8_t* data, size_t)
+	{
+		pages.frees++;
+		std::free(data);
+	}
+
+	size_t mock_large_page_size()
+	{
+		return pages.large_page_size;
+	}
+
+	frame_arena make_arena(size_t max_idle_bytes)
+	{
+		pages = {};
+		return frame_arena(max_idle_bytes, { mock_allocate, mock_free, mock_large_page_size });
+	}
+}
+
+TEST(frame_arena, reuse_hits_and_misses)
+{
+	auto arena = make_arena(static_cast<size_t>(1) << 20);
+
+	const uint8_t* first;
+	{
+		auto buffer = arena.acquire(1000);
+		first = buffer.data();
+		CHECK(buffer.size() == 1000);
+		CHECK(arena.counters().misses == 1);
+	}
+
+	// the same size rounded to pages is the same buffer, still holding what it held
+	{
+		auto buffer = arena.acquire(4000);
+		CHECK(buffer.data() == first);
+		CHECK(arena.counters().hits == 1);
+
+		// while it's out another one of the size comes from the system
+		auto other = arena.acquire(4000);
+		CHECK(other.data() != first);
+		CHECK(arena.counters().misses == 2);
+	}
+
+	// another size never takes one that would fit
+	auto bigger = arena.acquire(3 * page);
+	CHECK(arena.counters().misses == 3);
+	CHECK(pages.allocations == 3);
+
+	const auto stats = arena.counters();
+	CHECK(stats.bytes_resident == 5 * page);
+	CHECK(stats.bytes_idle == 2 * page);
+	CHECK(pages.frees == 0);
+
+	// moving a buffer moves the ownership, it's released once
+	frame_arena::buffer moved = std::move(bigger);
+	CHECK(bigger.data() == nullptr);
+	moved = {};
+	CHECK(arena.counters().bytes_idle == 5 * page);
+}
+
+TEST(frame_arena, idle_cap)
+{
+	auto arena = make_arena(3 * page);
+
+	std::vector<frame_arena::buffer> buffers;
+	for (int i = 0; i < 4; i++)
+		buffers.push_back(arena.acquire(page));
+
+	// the first three released are kept, the fourth goes back to the system
+	buffers.clear();
+
+	CHECK(pages.frees == 1);
+	CHECK(arena.counters().bytes_idle == 3 * page);
+	CHECK(arena.counters().bytes_resident == 3 * page);
+
+	// a buffer bigger than the cap is never kept
+	arena.acquire(4 * page);
+	CHECK(pages.frees == 2);
+	CHECK(arena.counters().bytes_idle == 3 * page);
+}
+
+TEST(frame_arena, trim)
+{
+	auto arena = make_arena(static_cast<size_t>(1) << 20);
+
+	auto held = arena.acquire(2 * page);
+	arena.acquire(page);
+	arena.acquire(3 * page);
+
+	arena.trim();
+
+	// the idle ones are freed, the one in use isn't touched
+	CHECK(pages.frees == 2);
+	CHECK(arena.counters().bytes_idle == 0);
+	CHECK(arena.counters().bytes_resident == 2 * page);
+
+	std::memset(held.data(), 0x5a, held.size());
+
+	// and goes idle like any other once released
+	held = {};
+	CHECK(arena.counters().bytes_idle == 2 * page);
+
+	arena.trim();
+	CHECK(pages.frees == 3);
+	CHECK(arena.counters().bytes_resident == 0);
+}
+
+TEST(frame_arena, large_pages)
+{
+	auto arena = make_arena(static_cast<size_t>(1) << 30);
+
+	// a system without them
+	CHECK(!arena.use_large_pages(true));
+	arena.acquire(2 * fake_large_page);
+	CHECK(pages.large_allocations == 0);
+
+	// idle buffers of the right size would be handed out as they are
+	arena.trim();
+
+	pages.large_page_size = fake_large_page;
+	CHECK(arena.use_large_pages(true));
+
+	// frames of at least a large page go on them, rounded up to whole ones
+	{
+		auto buffer = arena.acquire(fake_large_page + 1);
+		CHECK(pages.large_allocations == 1);
+		CHECK(arena.counters().large_page_bytes == 2 * fake_large_page);
+
+		// smaller ones stay on normal pages
+		arena.acquire(page);
+		CHECK(pages.large_allocations == 1);
+	}
+
+	// freed along with the rest
+	arena.trim();
+	CHECK(arena.counters().large_page_bytes == 0);
+	CHECK(arena.counters().bytes_resident == 0);
+}
+
+TEST(frame_arena, large_page_fallback)
+{
+	auto arena = make_arena(static_cast<size_t>(1) << 30);
+	pages.large_page_size = fake_large_page;
+	arena.use_large_pages(true);
+
+	// no contiguous memory left for large pages: normal ones, same size
+	pages.refuse_large = true;
+	{
+		auto buffer = arena.acquire(fake_large_page);
+		REQUIRE(buffer.data() != nullptr);
+		std::memset(buffer.data(), 0, buffer.size());
+
+		CHECK(pages.allocations == 1);
+		CHECK(pages.large_allocations == 0);
+		CHECK(arena.counters().large_page_bytes == 0);
+		CHECK(arena.counters().bytes_resident == fake_large_page);
+	}
+
+	// the fallback buffer is reused as it is even once large pages are back
+	pages.refuse_large = false;
+	arena.acquire(fake_large_page);
+	CHECK(arena.counters().hits == 1);
+	CHECK(arena.counters().large_page_bytes == 0);
+
+	// turned off, later frames go on normal pages
+	CHECK(arena.use_large_pages(false));
+	arena.trim();
+	arena.acquire(fake_large_page);
+	CHECK(pages.large_allocations == 0);
+}
+
+TEST(frame_arena, system_pages)
+{
+	// the real page source: page aligned and writable
+	frame_arena arena(static_cast<size_t>(64) << 20);
+	arena.use_large_pages(true);
+
+	for (const size_t size : { static_cast<size_t>(1), static_cast<size_t>(1920) * 1080 * 4, static_cast<size_t>(3840) * 2160 * 4 })
+	{
+		auto buffer = arena.acquire(size);
+		CHECK(reinterpret_cast<uintptr_t>(buffer.data()) % page == 0);
+		std::memset(buffer.data(), 0xff, size);
+	}
+
+	arena.trim();
+	CHECK(arena.counters().bytes_resident == 0);
+}
@@ -0,0 +1,108 @@
+#pragma once
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+#include <random>
+#include <vector>
+
+#include "tonemap/tonemap.hpp"
+
+// synthetic frames for the tests, deterministic for a given seed
+namespace test
+{
+	// fp16 rgba, mostly sdr range at white_level with a fifth of the pixels up to 1000 nits
+	// and some out of gamut negatives, like scRGB from a wide gamut desktop
+	inline std::vector<uint16_t> hdr_frame(int width, int height, float white_level, uint32_t seed)
+	{
+		std::mt19937 rng(seed);
+		std::uniform_real_distribution<float> sdr(0.0f, white_level / 80.0f);
+		std::uniform_real_distribution<float> hdr(0.0f, 1000.0f / 80.0f);
+		std::uniform_real_distribution<float> negative(-0.25f, 0.0f);
+		std::uniform_int_distribution<int> kind(0, 9);
+
+		std::vector<uint16_t> frame(static_cast<size_t>(width) * height * 4);
+
+		for (size_t i = 0; i < frame.size(); i += 4)
+		{
+			const int k = kind(rng);
+			for (int c = 0; c < 3; c++)
+			{
+				const float value = k < 2 ? hdr(rng) : k < 3 && c == 2 ? negative(rng) : sdr(rng);
+				frame[i + c] = tonemap::float_to_half(value);
+			}
+
+			frame[i + 3] = tonemap::float_to_half(1.0f);
+		}
+
+		return frame;
+	}
+
+	// any 4 byte pixels
+	inline std::vector<uint32_t> random_pixels(int width, int height, uint32_t seed)
+	{
+		std::mt19937 rng(seed);
+		std::vector<uint32_t> pixels(static_cast<size_t>(width) * height);
+
+		for (auto& pixel : pixels)
+			pixel = static_cast<uint32_t>(rng());
+
+		return pixels;
+	}
+
+	// bgra8 output with padding after every row and past the last one filled with a canary,
+	// so kernels writing past width show up
+	struct canvas
+	{
+		static constexpr int padding = 17;
+		static constexpr uint8_t canary = 0xa5;
+
+		int width;
+		int height;
+		size_t pitch;
+		std::vector<uint8_t> bytes;
+
+		canvas(int width, int height) :
+			width(width), height(height), pitch((static_cast<size_t>(width) + padding) * 4),
+			bytes(pitch * (height + 1), canary)
+		{
+		}
+
+		uint8_t* data()
+		{
+			return bytes.data();
+		}
+
+		bool padding_intact() const
+		{
+			const size_t row_bytes = static_cast<size_t>(width) * 4;
+
+			for (int y = 0; y <= height; y++)
+			{
+				const size_t from = y < height ? pitch * y + row_bytes : pitch * y;
+				for (size_t i = from; i < pitch * (y + 1); i++)
+				{
+					if (bytes[i] != canary)
+						return false;
+				}
+			}
+
+			return true;
+		}
+
+		bool same_pixels(const canvas& other) const
+		{
+			const size_t row_bytes = static_cast<size_t>(width) * 4;
+
+			for (int y = 0; y < height; y++)
+			{
+				if (std::memcmp(bytes.data() + pitch * y, other.bytes.data() + other.pitch * y, row_bytes) != 0)
+					return false;
+			}
+
+			return true;
+		}
+	};
+
+	// widths that leave every possible remainder for 4, 8 and 16 pixel loops
+	inline constexpr int odd_widths[] = { 1, 3, 5, 7, 9, 13, 15, 17, 23, 31, 33, 47, 63, 65, 127 };
+}
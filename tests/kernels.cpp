@@ -0,0 +1,384 @@
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#include "tonemap/tonemap.hpp"
+#include "tonemap/compose.hpp"
+#include "tonemap/dispatch.hpp"
+#include "tonemap/half_lut.hpp"
+#include "tonemap/cube_lut.hpp"
+#include "tonemap/operators.hpp"
+#include "tonemap/histogram.hpp"
+#include "tonemap/rotate.hpp"
+#include "tonemap/tile_hash.hpp"
+#include "tonemap/copy.hpp"
+
+#include "test.hpp"
+#include "frames.hpp"
+
+// every isa kernel against the scalar one it stands in for, at widths that end in
+// every possible partial vector. Levels above detect_isa() resolve to the best
+// kernel there is, so only the ones this cpu has are covered
+namespace
+{
+	using namespace tonemap;
+
+	constexpr float white_levels[] = { 80.0f, 203.0f, 480.0f };
+
+	// levels whose kernel differs from the one of the level below, scalar left out
+	template <typename Select>
+	std::vector<isa> simd_levels(Select select)
+	{
+		std::vector<isa> levels;
+		auto previous = select(isa::scalar);
+
+		for (int level = 1; level <= static_cast<int>(detect_isa()); level++)
+		{
+			const auto kernel = select(static_cast<isa>(level));
+			if (kernel != previous)
+				levels.push_back(static_cast<isa>(level));
+
+			previous = kernel;
+		}
+
+		return levels;
+	}
+
+	// runs kernel and reference over hdr frames at every odd width, max_error in 8 bit
+	// steps per channel, at most max_mismatched of all channels of all frames off at all
+	template <typename Run>
+	void check_hdr(Run run, int max_error, double max_mismatched)
+	{
+		size_t channels = 0;
+		size_t mismatched = 0;
+
+		for (const int width : test::odd_widths)
+		{
+			const int height = 3;
+
+			for (const float white_level : white_levels)
+			{
+				const auto frame = test::hdr_frame(width, height, white_level, width * 31 + static_cast<int>(white_level));
+				const size_t src_pitch = static_cast<size_t>(width) * 8;
+
+				test::canvas expected(width, height);
+				test::canvas actual(width, height);
+
+				run(frame.data(), src_pitch, expected, actual, width, height, white_level);
+
+				const auto error = compare_bgra8(expected.data(), expected.pitch, actual.data(), actual.pitch, width, height);
+
+				CHECK(error.max_error <= max_error);
+				CHECK(actual.padding_intact());
+
+				channels += static_cast<size_t>(width) * height * 4;
+				mismatched += error.mismatched;
+			}
+		}
+
+		CHECK(mismatched <= max_mismatched * channels);
+	}
+}
+
+TEST(kernels, hdr)
+{
+	for (const isa level : simd_levels(select_hdr_kernel))
+	{
+		const auto kernel = select_hdr_kernel(level);
+
+		check_hdr([&](const uint16_t* src, size_t src_pitch, test::canvas& expected, test::canvas& actual, int width, int height, float white_level) {
+			hdr_to_bgra8(src, src_pitch, expected.data(), expected.pitch, width, height, white_level);
+			kernel(src, src_pitch, actual.data(), actual.pitch, width, height, white_level);
+		}, 1, 0.01);
+	}
+}
+
+TEST(kernels, hdr_lut)
+{
+	half_lut lut;
+
+	for (const isa level : simd_levels(select_hdr_lut_kernel))
+	{
+		const auto kernel = select_hdr_lut_kernel(level);
+
+		check_hdr([&](const uint16_t* src, size_t src_pitch, test::canvas& expected, test::canvas& actual, int width, int height, float white_level) {
+			lut.update(white_level);
+			hdr_to_bgra8_lut(src, src_pitch, expected.data(), expected.pitch, width, height, lut.data());
+			kernel(src, src_pitch, actual.data(), actual.pitch, width, height, lut.data());
+		}, 1, 0.01);
+	}
+}
+
+TEST(kernels, hdr_cube)
+{
+	for (const int size : { cube_lut::small, cube_lut::large })
+	{
+		cube_lut lut;
+
+		// the baked cube against the direct path, the blend edge falls on the same pixels
+		const int max_error = size == cube_lut::small ? 2 : 1;
+
+		check_hdr([&](const uint16_t* src, size_t src_pitch, test::canvas& expected, test::canvas& actual, int width, int height, float white_level) {
+			lut.update(white_level, size);
+			hdr_to_bgra8(src, src_pitch, expected.data(), expected.pitch, width, height, white_level);
+			hdr_to_bgra8_cube(src, src_pitch, actual.data(), actual.pitch, width, height, lut);
+		}, max_error, 0.05);
+
+		lut.update(200.0f, size);
+		const auto error = lut.measure_error();
+		CHECK(error.max_error <= max_error);
+		CHECK(error.mean_error < 0.05);
+
+		for (const isa level : simd_levels(select_hdr_cube_kernel))
+		{
+			const auto kernel = select_hdr_cube_kernel(level);
+
+			check_hdr([&](const uint16_t* src, size_t src_pitch, test::canvas& expected, test::canvas& actual, int width, int height, float white_level) {
+				lut.update(white_level, size);
+				hdr_to_bgra8_cube(src, src_pitch, expected.data(), expected.pitch, width, height, lut);
+				kernel(src, src_pitch, actual.data(), actual.pitch, width, height, lut);
+			}, 1, 0.01);
+		}
+	}
+}
+
+TEST(kernels, operators)
+{
+	for (int i = 1; i < tone_operator_count; i++)
+	{
+		const auto op = static_cast<tone_operator>(i);
+
+		for (const isa level : simd_levels([op](isa value) { return select_operator_kernel(op, value); }))
+		{
+			const auto kernel = select_operator_kernel(op, level);
+
+			// bt2390's polynomial pq encode and decode land a step off on a few percent of channels
+			check_hdr([&](const uint16_t* src, size_t src_pitch, test::canvas& expected, test::canvas& actual, int width, int height, float white_level) {
+				hdr_to_bgra8(src, src_pitch, expected.data(), expected.pitch, width, height, white_level, op);
+				kernel(src, src_pitch, actual.data(), actual.pitch, width, height, white_level);
+			}, 1, op == tone_operator::bt2390 ? 0.05 : 0.01);
+		}
+	}
+}
+
+TEST(kernels, sdr)
+{
+	for (const isa level : simd_levels(select_sdr_kernel))
+	{
+		const auto kernel = select_sdr_kernel(level);
+
+		for (const int width : test::odd_widths)
+		{
+			const auto frame = test::random_pixels(width, 3, width);
+
+			test::canvas expected(width, 3);
+			test::canvas actual(width, 3);
+
+			sdr_to_bgra8(frame.data(), static_cast<size_t>(width) * 4, expected.data(), expected.pitch, width, 3);
+			kernel(frame.data(), static_cast<size_t>(width) * 4, actual.data(), actual.pitch, width, 3);
+
+			CHECK(actual.same_pixels(expected));
+			CHECK(actual.padding_intact());
+		}
+	}
+}
+
+TEST(kernels, bgra8_frames)
+{
+	// the same pixels in the other order come out the same, alpha forced to 1 like the
+	// sdr kernels and shader do
+	for (const int width : test::odd_widths)
+	{
+		const int height = 5;
+		const auto rgba = test::random_pixels(width, height, width);
+		std::vector<uint32_t> bgra(rgba.size());
+
+		for (size_t i = 0; i < rgba.size(); i++)
+			bgra[i] = (rgba[i] & 0xff00ff00) | (rgba[i] & 0xff) << 16 | (rgba[i] >> 16 & 0xff);
+
+		for (const int rotation : { 0, 90, 180, 270 })
+		{
+			const int dest_width = rotation % 180 ? height : width;
+			const int dest_height = rotation % 180 ? width : height;
+			const size_t pitch = static_cast<size_t>(width) * 4;
+
+			test::canvas expected(dest_width, dest_height);
+			test::canvas actual(dest_width, dest_height);
+
+			select_compose_kernel(input_format::sdr, rotation)(
+				{ rgba.data(), pitch, width, height }, { expected.data(), expected.pitch, dest_width, dest_height }, 0, 0, nullptr
+			);
+			select_compose_kernel(input_format::bgra8, rotation)(
+				{ bgra.data(), pitch, width, height }, { actual.data(), actual.pitch, dest_width, dest_height }, 0, 0, nullptr
+			);
+
+			CHECK(actual.same_pixels(expected));
+			CHECK(actual.padding_intact());
+
+			// unrotated they're the frame's own pixels, opaque
+			if (rotation == 0)
+			{
+				for (int y = 0; y < height; y++)
+				{
+					for (int x = 0; x < width; x++)
+					{
+						uint32_t pixel;
+						std::memcpy(&pixel, actual.data() + actual.pitch * y + 4 * static_cast<size_t>(x), 4);
+						CHECK(pixel == (bgra[static_cast<size_t>(width) * y + x] | 0xff000000));
+					}
+				}
+			}
+		}
+	}
+}
+
+TEST(kernels, rotate)
+{
+	for (const isa level : simd_levels(select_rotate_kernel))
+	{
+		const auto kernel = select_rotate_kernel(level);
+
+		for (const int width : test::odd_widths)
+		{
+			const int height = 37;
+			const auto frame = test::random_pixels(width, height, width);
+
+			for (const int rotation : { 90, 180, 270 })
+			{
+				const bool swap = rotation != 180;
+				test::canvas expected(swap ? height : width, swap ? width : height);
+				test::canvas actual(expected.width, expected.height);
+
+				rotate_bgra8(frame.data(), static_cast<size_t>(width) * 4, expected.data(), expected.pitch, width, height, rotation);
+				kernel(frame.data(), static_cast<size_t>(width) * 4, actual.data(), actual.pitch, width, height, rotation);
+
+				CHECK(actual.same_pixels(expected));
+				CHECK(actual.padding_intact());
+			}
+		}
+	}
+}
+
+TEST(kernels, histogram)
+{
+	for (const isa level : simd_levels(select_histogram_kernel))
+	{
+		const auto kernel = select_histogram_kernel(level);
+
+		for (const int width : test::odd_widths)
+		{
+			const auto frame = test::hdr_frame(width, 3, 203.0f, width);
+			const size_t pitch = static_cast<size_t>(width) * 8;
+
+			uint64_t expected[luminance_histogram::bin_count] = {};
+			uint64_t actual[luminance_histogram::bin_count] = {};
+
+			histogram_rows(frame.data(), pitch, width, 3, input_format::scrgb, expected);
+			kernel(frame.data(), pitch, width, 3, input_format::scrgb, actual);
+
+			CHECK(std::memcmp(expected, actual, sizeof(expected)) == 0);
+		}
+	}
+}
+
+TEST(kernels, histogram_frame)
+{
+	// tall enough to be split into bands on the worker pool
+	const int width = 37, height = 1000;
+	const auto frame = test::hdr_frame(width, height, 203.0f, width);
+	const size_t pitch = static_cast<size_t>(width) * 8;
+
+	uint64_t expected[luminance_histogram::bin_count] = {};
+	histogram_rows(frame.data(), pitch, width, height, input_format::scrgb, expected);
+
+	luminance_histogram histogram;
+	histogram_frame(frame.data(), pitch, width, height, input_format::scrgb, histogram);
+
+	// counters the way the gpu pass hands them over
+	uint32_t counts[luminance_histogram::bin_count];
+	luminance_histogram from_counts;
+
+	for (int i = 0; i < luminance_histogram::bin_count; i++)
+	{
+		CHECK(histogram[i] == expected[i]);
+		counts[i] = static_cast<uint32_t>(expected[i]);
+	}
+
+	from_counts.add_counts(counts);
+	from_counts.add_counts(counts);
+
+	CHECK(histogram.total() == static_cast<uint64_t>(width) * height);
+	CHECK(from_counts.total() == 2 * histogram.total());
+	CHECK(from_counts.percentile(0.5f) == histogram.percentile(0.5f));
+}
+
+TEST(kernels, hash)
+{
+	for (const isa level : simd_levels(select_hash_kernel))
+	{
+		const auto kernel = select_hash_kernel(level);
+
+		for (const int width : test::odd_widths)
+		{
+			const auto frame = test::hdr_frame(width, 5, 203.0f, width);
+			const size_t pitch = static_cast<size_t>(width) * 8;
+
+			// row lengths that aren't whole 64 byte stripes too
+			for (const size_t row_bytes : { pitch, pitch - 2, static_cast<size_t>(1) })
+				CHECK(kernel(frame.data(), pitch, row_bytes, 5) == hash_rows(frame.data(), pitch, row_bytes, 5));
+		}
+	}
+}
+
+TEST(kernels, copy)
+{
+	for (const isa level : simd_levels(select_copy_kernel))
+	{
+		const auto kernel = select_copy_kernel(level);
+
+		for (const int width : test::odd_widths)
+		{
+			const auto frame = test::random_pixels(width + 1, 3, width);
+			const size_t src_pitch = static_cast<size_t>(width + 1) * 4;
+
+			test::canvas expected(width, 3);
+			test::canvas actual(width, 3);
+
+			// from one byte in, so the source is never aligned
+			const auto* src = reinterpret_cast<const uint8_t*>(frame.data()) + 1;
+
+			copy_rows(src, src_pitch, expected.data(), expected.pitch, static_cast<size_t>(width) * 4, 3);
+			kernel(src, src_pitch, actual.data(), actual.pitch, static_cast<size_t>(width) * 4, 3);
+
+			CHECK(actual.same_pixels(expected));
+			CHECK(actual.padding_intact());
+		}
+	}
+}
+
+TEST(kernels, copy_frame)
+{
+	// past the llc, so streaming and split into bands when there are threads for them
+	const size_t row_bytes = 4096 * 4;
+	const int height = static_cast<int>(last_level_cache_size() * 3 / 2 / row_bytes);
+
+	std::vector<uint8_t> src((row_bytes + 256) * height + 1);
+	for (size_t i = 0; i < src.size(); i++)
+		src[i] = static_cast<uint8_t>(i * 7 + i / 251);
+
+	// a padded pitch like a mapped staging texture's into a packed buffer, then packed on
+	// both sides, which is one block
+	for (const size_t src_pitch : { row_bytes + 256, row_bytes })
+	{
+		std::vector<uint8_t> dest(row_bytes * height + 1, 0xa5);
+
+		copy_frame(src.data() + 1, src_pitch, dest.data(), row_bytes, row_bytes, height);
+
+		bool same = true;
+		for (int y = 0; y < height; y++)
+			same &= std::memcmp(dest.data() + row_bytes * y, src.data() + 1 + src_pitch * y, row_bytes) == 0;
+
+		CHECK(same);
+		CHECK(dest.back() == 0xa5);
+	}
+}
@@ -0,0 +1,53 @@
+#include <cstdio>
+#include <cstring>
+
+#include "test.hpp"
+
+namespace test
+{
+	namespace
+	{
+		int failures = 0;
+	}
+
+	std::vector<test_case>& cases()
+	{
+		static std::vector<test_case> registered;
+		return registered;
+	}
+
+	bool fail(const char* file, int line, const char* expr)
+	{
+		std::printf("%s:%d: CHECK(%s) failed\n", file, line, expr);
+		failures++;
+		return false;
+	}
+}
+
+// runs every test whose name starts with one of the arguments, all of them without any
+int main(int argc, char** argv)
+{
+	int run = 0;
+	int failed = 0;
+
+	for (const auto& entry : test::cases())
+	{
+		bool selected = argc < 2;
+		for (int i = 1; i < argc; i++)
+			selected |= std::strncmp(entry.name, argv[i], std::strlen(argv[i])) == 0;
+
+		if (!selected)
+			continue;
+
+		const int before = test::failures;
+		entry.run();
+		run++;
+
+		const bool passed = test::failures == before;
+		failed += !passed;
+		std::printf("%-48s %s\n", entry.name, passed ? "ok" : "FAILED");
+	}
+
+	std::printf("%d tests, %d failed\n", run, failed);
+	return failed || !run ? 1 : 0;
+}
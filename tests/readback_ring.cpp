@@ -0,0 +1,212 @@
+#include <cstdint>
+#include <algorithm>
+#include <vector>
+
+#include "utils/readback_ring.hpp"
+
+#include "test.hpp"
+
+// readback_ring against a fake device that checks every call is one a real one would take
+namespace
+{
+	struct fake_device
+	{
+		struct surface_type
+		{
+			int id = -1;
+			int top = 0;
+			int rows = 0;
+			bool busy = false;
+			// done() polls left before the copy finishes
+			int pending = 0;
+		};
+
+		int created = 0;
+		int in_flight = 0;
+		int max_in_flight = 0;
+		int errors = 0;
+		// done() polls a copy takes, the same for every copy
+		int latency = 0;
+
+		// ids of the surfaces copied into, in order
+		std::vector<int> copies;
+		std::vector<int> rows_read;
+		int next_row = 0;
+
+		surface_type create(int, int)
+		{
+			surface_type surface;
+			surface.id = created++;
+			return surface;
+		}
+
+		void copy(surface_type& surface, int top, int rows)
+		{
+			// a surface is only written again once it was read
+			errors += surface.busy;
+
+			surface.top = top;
+			surface.rows = rows;
+			surface.busy = true;
+			surface.pending = latency;
+
+			copies.push_back(surface.id);
+			max_in_flight = std::max(max_in_flight, ++in_flight);
+		}
+
+		bool done(const surface_type& surface)
+		{
+			auto& polled = const_cast<surface_type&>(surface);
+			return polled.pending-- <= 0;
+		}
+
+		void wait(const surface_type& surface)
+		{
+			const_cast<surface_type&>(surface).pending = 0;
+		}
+
+		void read(surface_type& surface, int top, int rows)
+		{
+			// only finished copies, of the rows asked for, top to bottom
+			errors += !surface.busy || surface.pending > 0 || top != surface.top || rows != surface.rows || top != next_row;
+
+			for (int row = top; row < top + rows && row < static_cast<int>(rows_read.size()); row++)
+				rows_read[row]++;
+
+			next_row = top + rows;
+			surface.busy = false;
+			in_flight--;
+		}
+
+		void start_frame(int height)
+		{
+			rows_read.assign(height, 0);
+			next_row = 0;
+			copies.clear();
+			max_in_flight = 0;
+		}
+
+		bool every_row_once() const
+		{
+			for (const int reads : rows_read)
+			{
+				if (reads != 1)
+					return false;
+			}
+
+			return true;
+		}
+	};
+}
+
+TEST(readback_ring, every_row_once_in_order)
+{
+	readback_ring<fake_device> ring(fake_device{}, 3, 256);
+
+	// band and ring boundaries on either side
+	for (const int height : { 1, 255, 256, 257, 768, 769, 1080, 2160 })
+	{
+		auto& device = ring.backend();
+		device.start_frame(height);
+
+		ring.read_frame(1920, height);
+
+		CHECK(device.every_row_once());
+		CHECK(device.next_row == height);
+		CHECK(device.in_flight == 0);
+	}
+
+	CHECK(ring.backend().errors == 0);
+}
+
+TEST(readback_ring, in_flight_limit)
+{
+	for (const int surfaces : { 1, 2, 3, 5 })
+	{
+		readback_ring<fake_device> ring(fake_device{}, surfaces, 64);
+		auto& device = ring.backend();
+		device.latency = 2;
+		device.start_frame(1000);
+
+		ring.read_frame(640, 1000);
+
+		// all of the ring is used, never more
+		CHECK(device.max_in_flight == surfaces);
+		CHECK(device.every_row_once());
+		CHECK(device.errors == 0);
+	}
+}
+
+TEST(readback_ring, surfaces_wrap_around)
+{
+	readback_ring<fake_device> ring(fake_device{}, 3, 100);
+	auto& device = ring.backend();
+	device.start_frame(1000);
+
+	ring.read_frame(800, 1000);
+
+	// ten bands through three surfaces, round and round
+	REQUIRE(device.copies.size() == 10);
+	for (size_t i = 0; i < device.copies.size(); i++)
+		CHECK(device.copies[i] == static_cast<int>(i % 3));
+
+	CHECK(device.errors == 0);
+}
+
+TEST(readback_ring, surfaces_are_reused)
+{
+	readback_ring<fake_device> ring(fake_device{}, 3, 256);
+	auto& device = ring.backend();
+
+	// a frame shorter than the ring only creates what it reaches
+	device.start_frame(300);
+	ring.read_frame(1920, 300);
+	CHECK(ring.surfaces_created() == 2);
+	CHECK(device.created == 2);
+
+	// the same width again creates nothing but the surface the taller frame reaches
+	for (int frame = 0; frame < 4; frame++)
+	{
+		device.start_frame(1080);
+		ring.read_frame(1920, 1080);
+	}
+
+	CHECK(device.created == 3);
+	CHECK(ring.surfaces_created() == 3);
+
+	// another width needs surfaces of its own
+	device.start_frame(1080);
+	ring.read_frame(2560, 1080);
+	CHECK(device.created == 6);
+
+	// and after clear() they're created again
+	ring.clear();
+	CHECK(ring.surfaces_created() == 0);
+
+	device.start_frame(1080);
+	ring.read_frame(2560, 1080);
+	CHECK(device.created == 9);
+	CHECK(device.every_row_once());
+	CHECK(device.errors == 0);
+}
+
+TEST(readback_ring, stalls_are_counted)
+{
+	readback_ring<fake_device> ring(fake_device{}, 3, 256);
+	auto& device = ring.backend();
+
+	// copies that are done by the first poll never stall
+	device.start_frame(2160);
+	ring.read_frame(3840, 2160);
+	CHECK(ring.reads() == 9);
+	CHECK(ring.stalls() == 0);
+
+	// ones that never are stall on every band
+	device.latency = 1000;
+	device.start_frame(2160);
+	ring.read_frame(3840, 2160);
+	CHECK(ring.reads() == 18);
+	CHECK(ring.stalls() == 9);
+	CHECK(device.every_row_once());
+	CHECK(device.errors == 0);
+}
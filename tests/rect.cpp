@@ -0,0 +1,123 @@
+#include <cstdint>
+#include <vector>
+
+#include "tonemap/rect.hpp"
+#include "tonemap/rotate.hpp"
+
+#include "test.hpp"
+
+namespace
+{
+	using tonemap::rect;
+
+	constexpr int rotations[] = { 0, 90, 180, 270 };
+}
+
+TEST(rect, intersect)
+{
+	using tonemap::intersect;
+
+	CHECK((intersect({ 0, 0, 10, 10 }, { 5, 3, 20, 8 }) == rect{ 5, 3, 10, 8 }));
+	CHECK((intersect({ -5, -5, 5, 5 }, { 0, 0, 10, 10 }) == rect{ 0, 0, 5, 5 }));
+
+	// contained either way round
+	CHECK((intersect({ 0, 0, 10, 10 }, { 2, 2, 4, 4 }) == rect{ 2, 2, 4, 4 }));
+	CHECK((intersect({ 2, 2, 4, 4 }, { 0, 0, 10, 10 }) == rect{ 2, 2, 4, 4 }));
+
+	// sharing only an edge or a corner, or apart, is no overlap and comes back as rect{}
+	CHECK((intersect({ 0, 0, 10, 10 }, { 10, 0, 20, 10 }) == rect{}));
+	CHECK((intersect({ 0, 0, 10, 10 }, { 0, 10, 10, 20 }) == rect{}));
+	CHECK((intersect({ 0, 0, 10, 10 }, { 10, 10, 20, 20 }) == rect{}));
+	CHECK((intersect({ 0, 0, 10, 10 }, { 30, -40, 50, -20 }) == rect{}));
+	CHECK(intersect({ 0, 0, 10, 10 }, { 3, 3, 3, 8 }).empty());
+}
+
+TEST(rect, offset)
+{
+	using tonemap::offset;
+
+	const rect r = { 1, 2, 5, 9 };
+
+	CHECK((offset(r, 10, -20) == rect{ 11, -18, 15, -11 }));
+	CHECK((offset(offset(r, -7, 3), 7, -3) == r));
+	CHECK(offset(r, 100, 100).width() == r.width());
+	CHECK(offset(r, 100, 100).height() == r.height());
+}
+
+TEST(rect, rotate_moves_like_the_pixels)
+{
+	// every pixel of r marked in a frame, rotated with rotate_bgra8, has to land exactly on
+	// rotate(r) of the rotated frame
+	const int width = 13;
+	const int height = 7;
+	const rect areas[] = { { 0, 0, width, height }, { 2, 1, 5, 6 }, { 0, 3, 1, 4 }, { 9, 0, 13, 2 } };
+
+	for (const rect& area : areas)
+	{
+		std::vector<uint32_t> frame(static_cast<size_t>(width) * height);
+		for (int y = area.top; y < area.bottom; y++)
+			for (int x = area.left; x < area.right; x++)
+				frame[static_cast<size_t>(y) * width + x] = 1;
+
+		for (const int rotation : rotations)
+		{
+			const bool swap = rotation == 90 || rotation == 270;
+			const int rotated_width = swap ? height : width;
+			const int rotated_height = swap ? width : height;
+
+			std::vector<uint32_t> rotated(frame.size());
+			tonemap::rotate_bgra8(frame.data(), width * 4, rotated.data(), static_cast<size_t>(rotated_width) * 4, width, height, rotation);
+
+			const rect to = tonemap::rotate(area, rotation, width, height);
+			CHECK(to.width() * to.height() == area.width() * area.height());
+
+			for (int y = 0; y < rotated_height; y++)
+			{
+				for (int x = 0; x < rotated_width; x++)
+				{
+					const bool inside = x >= to.left && x < to.right && y >= to.top && y < to.bottom;
+					CHECK((rotated[static_cast<size_t>(y) * rotated_width + x] == 1) == inside);
+				}
+			}
+		}
+	}
+}
+
+TEST(rect, unrotate_inverts_rotate)
+{
+	const int width = 1920;
+	const int height = 1080;
+	const rect areas[] = { { 0, 0, width, height }, { 100, 200, 300, 250 }, { width - 1, height - 1, width, height } };
+
+	for (const rect& area : areas)
+	{
+		for (const int rotation : rotations)
+		{
+			CHECK(tonemap::unrotate(tonemap::rotate(area, rotation, width, height), rotation, width, height) == area);
+		}
+	}
+}
+
+TEST(rect, unrotate_clips_outside_the_frame)
+{
+	// a capture region hanging over the rotated frame's edges comes back as the part of
+	// the unrotated frame it covers once clipped, which is what compose and capture_frame do
+	const int width = 40;
+	const int height = 30;
+	const rect frame = { 0, 0, width, height };
+
+	for (const int rotation : rotations)
+	{
+		const bool swap = rotation == 90 || rotation == 270;
+		const rect rotated_frame = { 0, 0, swap ? height : width, swap ? width : height };
+
+		const rect region = { -10, -10, 10, 5 };
+		const rect clipped = tonemap::intersect(tonemap::unrotate(region, rotation, width, height), frame);
+
+		CHECK(!clipped.empty());
+		CHECK(tonemap::rotate(clipped, rotation, width, height) == tonemap::intersect(region, rotated_frame));
+
+		// wholly outside stays empty
+		CHECK(tonemap::intersect(tonemap::unrotate({ -20, -20, -1, -1 }, rotation, width, height), frame).empty());
+	}
+}
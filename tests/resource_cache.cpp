@@ -0,0 +1,218 @@
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "utils/resource_cache.hpp"
+
+#include "test.hpp"
+
+// resource_cache the way main.cpp keeps views and staging textures, against a mock device
+// whose resources log when they're released
+namespace
+{
+	enum class mock_format
+	{
+		r8g8b8a8,
+		r16g16b16a16,
+		r10g10b10a2,
+	};
+
+	// gpu_resource_key without the d3d types
+	struct mock_key
+	{
+		int kind;
+		const void* texture;
+		mock_format format;
+		unsigned width;
+		unsigned height;
+
+		bool operator==(const mock_key&) const = default;
+	};
+
+	struct mock_key_hash
+	{
+		size_t operator()(const mock_key& key) const
+		{
+			size_t hash = std::hash<const void*>{}(key.texture);
+
+			for (size_t value : { static_cast<size_t>(key.kind), static_cast<size_t>(key.format), static_cast<size_t>(key.width), static_cast<size_t>(key.height) })
+				hash = hash * 31 + value;
+
+			return hash;
+		}
+	};
+
+	struct mock_device
+	{
+		int created = 0;
+		bool fail = false;
+		// ids in the order their last reference went away
+		std::vector<int> released;
+	};
+
+	// a com_ptr stand in: the resource is released once the last copy goes
+	struct mock_resource
+	{
+		int id;
+		mock_key key;
+		mock_device* device;
+
+		~mock_resource()
+		{
+			device->released.push_back(id);
+		}
+	};
+
+	using resource_ptr = std::shared_ptr<mock_resource>;
+	using cache_type = resource_cache<mock_key, resource_ptr, mock_key_hash>;
+
+	// cached_staging and friends: the one for key, created on the device when there's none
+	resource_ptr get(cache_type& cache, mock_device& device, const mock_key& key, size_t bytes)
+	{
+		resource_ptr resource;
+		cache.get(key, bytes, resource, [&](resource_ptr& created) {
+			if (device.fail)
+				return false;
+
+			created.reset(new mock_resource{ device.created++, key, &device });
+			return true;
+		});
+
+		return resource;
+	}
+
+	int texture_a;
+	int texture_b;
+
+	mock_key staging(const void* texture, unsigned width, unsigned height, mock_format format = mock_format::r16g16b16a16)
+	{
+		return { 2, texture, format, width, height };
+	}
+}
+
+TEST(resource_cache, hits_return_the_same_resource)
+{
+	mock_device device;
+	cache_type cache(1 << 20);
+
+	const auto first = get(cache, device, staging(&texture_a, 64, 64), 100);
+
+	for (int frame = 0; frame < 10; frame++)
+	{
+		cache.next_frame(8);
+		CHECK(get(cache, device, staging(&texture_a, 64, 64), 100) == first);
+	}
+
+	CHECK(device.created == 1);
+	CHECK(cache.counters().hits == 10);
+	CHECK(cache.counters().creations == 1);
+	CHECK(cache.counters().bytes == 100);
+}
+
+TEST(resource_cache, lru_eviction_order)
+{
+	mock_device device;
+	cache_type cache(300);
+
+	// 0, 1, 2 fill it
+	for (unsigned i = 0; i < 3; i++)
+		get(cache, device, staging(&texture_a, 100 + i, 64), 100);
+
+	// 0 used again, so 1 is now the oldest
+	get(cache, device, staging(&texture_a, 100, 64), 100);
+
+	// 3 pushes out 1, then 4 pushes out 2
+	get(cache, device, staging(&texture_a, 103, 64), 100);
+	get(cache, device, staging(&texture_a, 104, 64), 100);
+
+	CHECK((device.released == std::vector<int>{ 1, 2 }));
+	CHECK(cache.size() == 3);
+	CHECK(cache.counters().bytes == 300);
+	CHECK(cache.counters().destroys == 2);
+
+	// 0 survived both
+	CHECK(get(cache, device, staging(&texture_a, 100, 64), 100)->id == 0);
+
+	// one bigger than everything pushes out all the others, oldest first, and stays
+	get(cache, device, staging(&texture_a, 7680, 4320), 1000);
+	CHECK((device.released == std::vector<int>{ 1, 2, 3, 4, 0 }));
+	CHECK(cache.size() == 1);
+	CHECK(cache.counters().bytes == 1000);
+
+	// shrinking drops the oldest until it fits, the last one too if it has to
+	get(cache, device, staging(&texture_a, 1, 1), 10);
+	cache.set_capacity(100);
+	CHECK(cache.size() == 1);
+	CHECK(device.released.back() == 5);
+
+	cache.clear();
+	CHECK(cache.size() == 0);
+	CHECK(cache.counters().bytes == 0);
+	CHECK(device.released.size() == 7);
+}
+
+TEST(resource_cache, size_and_format_changes_miss)
+{
+	mock_device device;
+	cache_type cache(1 << 20);
+
+	const auto fp16 = get(cache, device, staging(&texture_a, 3840, 2160), 100);
+
+	// the same texture address after a mode change is a different resource
+	const auto resized = get(cache, device, staging(&texture_a, 2560, 1440), 100);
+	const auto pq10 = get(cache, device, staging(&texture_a, 3840, 2160, mock_format::r10g10b10a2), 100);
+	const auto other = get(cache, device, staging(&texture_b, 3840, 2160), 100);
+	const auto view = get(cache, device, { 0, &texture_a, mock_format::r16g16b16a16, 3840, 2160 }, 0);
+
+	CHECK(device.created == 5);
+	CHECK(cache.counters().hits == 0);
+
+	for (const auto& resource : { resized, pq10, other, view })
+	{
+		CHECK(resource != fp16);
+		CHECK(!(resource->key == fp16->key));
+	}
+
+	// asking for the old one again still hits it
+	CHECK(get(cache, device, staging(&texture_a, 3840, 2160), 100) == fp16);
+}
+
+TEST(resource_cache, unused_resources_age_out)
+{
+	mock_device device;
+	cache_type cache(1 << 20);
+
+	get(cache, device, staging(&texture_a, 64, 64), 100);
+	get(cache, device, staging(&texture_b, 64, 64), 100);
+
+	// b is asked for every frame, a never again, like the views of a duplication frame
+	// that went away
+	for (int frame = 0; frame < 8; frame++)
+	{
+		cache.next_frame(8);
+		get(cache, device, staging(&texture_b, 64, 64), 100);
+	}
+
+	CHECK(device.released.empty());
+
+	cache.next_frame(8);
+	CHECK((device.released == std::vector<int>{ 0 }));
+	CHECK(cache.size() == 1);
+}
+
+TEST(resource_cache, failed_creation_caches_nothing)
+{
+	mock_device device;
+	cache_type cache(1 << 20);
+
+	device.fail = true;
+
+	CHECK(!get(cache, device, staging(&texture_a, 64, 64), 100));
+	CHECK(cache.size() == 0);
+	CHECK(cache.counters().bytes == 0);
+
+	// and the next try creates it
+	device.fail = false;
+	CHECK(get(cache, device, staging(&texture_a, 64, 64), 100) != nullptr);
+	CHECK(cache.counters().creations == 1);
+}
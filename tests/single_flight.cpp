@@ -0,0 +1,178 @@
+#include <atomic>
+#include <chrono>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+#include "utils/single_flight.hpp"
+#include "tonemap/rect.hpp"
+
+#include "test.hpp"
+
+// the capture coalescing of bitblt_hook against a mocked capture backend. Meant to be run
+// under thread sanitizer as well, see BITBLT_HDR_SANITIZER
+namespace
+{
+	using tonemap::rect;
+
+	// stands in for capture_frame: counts captures, notices overlapping ones and fills the
+	// result with something only this region gives
+	struct mock_backend
+	{
+		std::atomic<int> captures = 0;
+		std::atomic<int> running = 0;
+		std::atomic<int> overlapped = 0;
+
+		// a capture doesn't finish before this many callers arrived
+		std::atomic<int> arrived = 0;
+		int hold_for = 0;
+
+		void capture(std::vector<int>& frame, const rect& region)
+		{
+			if (running++)
+				overlapped++;
+
+			captures++;
+
+			while (arrived < hold_for)
+				std::this_thread::yield();
+
+			// the last caller to arrive still has to get from arrived into run()
+			std::this_thread::sleep_for(std::chrono::milliseconds(50));
+
+			frame.assign(static_cast<size_t>(region.width()) * region.height(), region.right);
+			running--;
+		}
+	};
+
+	bool filled_for(const std::vector<int>& frame, const rect& region)
+	{
+		return frame.size() == static_cast<size_t>(region.width()) * region.height() && frame.front() == region.right;
+	}
+}
+
+TEST(single_flight, same_region_is_captured_once)
+{
+	constexpr int callers = 32;
+
+	single_flight<rect, std::vector<int>> captures;
+	mock_backend backend;
+	backend.hold_for = callers;
+
+	const rect region = { 0, 0, 64, 48 };
+	std::vector<std::shared_ptr<const std::vector<int>>> results(callers);
+	std::vector<std::thread> threads;
+
+	for (int i = 0; i < callers; i++)
+	{
+		threads.emplace_back([&, i] {
+			backend.arrived++;
+			results[i] = captures.run(region, [&](std::vector<int>& frame) { backend.capture(frame, region); });
+		});
+	}
+
+	for (auto& thread : threads)
+		thread.join();
+
+	CHECK(backend.captures == 1);
+
+	// every caller got the one result
+	for (const auto& result : results)
+	{
+		REQUIRE(result);
+		CHECK(result == results.front());
+		CHECK(filled_for(*result, region));
+	}
+}
+
+TEST(single_flight, different_regions_take_turns)
+{
+	constexpr int callers = 16;
+	constexpr int calls = 8;
+
+	single_flight<rect, std::vector<int>> captures;
+	mock_backend backend;
+	std::atomic<int> wrong = 0;
+	std::vector<std::thread> threads;
+
+	for (int i = 0; i < callers; i++)
+	{
+		threads.emplace_back([&, i] {
+			const int size = 16 + (i % 4) * 16;
+			const rect region = { 0, 0, size, size };
+
+			for (int call = 0; call < calls; call++)
+			{
+				auto result = captures.run(region, [&](std::vector<int>& frame) {
+					if (backend.running++)
+						backend.overlapped++;
+
+					backend.captures++;
+					frame.assign(static_cast<size_t>(size) * size, region.right);
+					backend.running--;
+				});
+
+				if (!filled_for(*result, region))
+					wrong++;
+			}
+		});
+	}
+
+	for (auto& thread : threads)
+		thread.join();
+
+	CHECK(backend.overlapped == 0);
+	CHECK(wrong == 0);
+	CHECK(backend.captures >= 1);
+	CHECK(backend.captures <= callers * calls);
+}
+
+TEST(single_flight, errors_reach_every_waiting_caller)
+{
+	constexpr int callers = 8;
+
+	single_flight<rect, std::vector<int>> captures;
+	std::atomic<int> arrived = 0;
+	std::atomic<int> attempts = 0;
+	std::atomic<int> errors = 0;
+	std::vector<std::thread> threads;
+
+	for (int i = 0; i < callers; i++)
+	{
+		threads.emplace_back([&] {
+			arrived++;
+
+			try
+			{
+				captures.run(rect{ 0, 0, 1, 1 }, [&](std::vector<int>&) {
+					attempts++;
+
+					while (arrived < callers)
+						std::this_thread::yield();
+
+					std::this_thread::sleep_for(std::chrono::milliseconds(50));
+					throw std::runtime_error{ "capture failed" };
+				});
+			}
+			catch (const std::runtime_error&)
+			{
+				errors++;
+			}
+		});
+	}
+
+	for (auto& thread : threads)
+		thread.join();
+
+	CHECK(attempts == 1);
+	CHECK(errors == callers);
+
+	// nothing is kept, the next call captures again
+	auto result = captures.run(rect{ 0, 0, 1, 1 }, [&](std::vector<int>& frame) {
+		attempts++;
+		frame.assign(1, 1);
+	});
+
+	CHECK(attempts == 2);
+	CHECK(result->size() == 1);
+}
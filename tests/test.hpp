@@ -0,0 +1,41 @@
+#pragma once
+#include <cstdio>
+#include <vector>
+
+// just enough of a test framework: TEST registers a function, CHECK reports a failed
+// expression and lets the test carry on, REQUIRE returns from it
+namespace test
+{
+	struct test_case
+	{
+		const char* name;
+		void (*run)();
+	};
+
+	std::vector<test_case>& cases();
+
+	// counted against the running test, false so REQUIRE can return on it
+	bool fail(const char* file, int line, const char* expr);
+
+	struct registrar
+	{
+		registrar(const char* name, void (*run)())
+		{
+			cases().push_back({ name, run });
+		}
+	};
+}
+
+#define TEST(group, name) \
+	static void group##_##name(); \
+	static test::registrar group##_##name##_registrar{ #group "." #name, group##_##name }; \
+	static void group##_##name()
+
+#define CHECK(expr) ((expr) ? true : test::fail(__FILE__, __LINE__, #expr))
+
+#define REQUIRE(expr) \
+	do \
+	{ \
+		if (!CHECK(expr)) \
+			return; \
+	} while (false)
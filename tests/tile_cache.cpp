@@ -0,0 +1,241 @@
+#include <cstdint>
+#include <cstring>
+#include <algorithm>
+#include <random>
+#include <tuple>
+#include <vector>
+
+#include "tonemap/tonemap.hpp"
+#include "tonemap/compose.hpp"
+#include "tonemap/dispatch.hpp"
+#include "tonemap/half_lut.hpp"
+#include "tonemap/operators.hpp"
+#include "tonemap/tile_cache.hpp"
+
+#include "test.hpp"
+#include "frames.hpp"
+
+// tile_cache driven like monitor::update_tiles and render_cached drive it, by synthetic
+// streams of move and dirty rects, against tone mapping the whole frame every time
+namespace
+{
+	using namespace tonemap;
+
+	constexpr float white_level = 203.0f;
+
+	// a monitor's fp16 frame as desktop duplication would hand it over, changed by the
+	// same moves and dirty rects the cache is told about
+	struct screen
+	{
+		int width;
+		int height;
+		std::vector<uint64_t> pixels;
+
+		// pixels new content is drawn from
+		std::vector<uint64_t> palette;
+		std::mt19937 rng;
+
+		screen(int width, int height, uint32_t seed) :
+			width(width), height(height), pixels(static_cast<size_t>(width) * height), rng(seed)
+		{
+			const auto halves = test::hdr_frame(512, 1, white_level, seed);
+			palette.resize(512);
+			std::memcpy(palette.data(), halves.data(), palette.size() * 8);
+
+			draw({ 0, 0, width, height });
+		}
+
+		size_t pitch() const
+		{
+			return static_cast<size_t>(width) * 8;
+		}
+
+		void draw(const rect& area)
+		{
+			for (int y = area.top; y < area.bottom; y++)
+				for (int x = area.left; x < area.right; x++)
+					pixels[static_cast<size_t>(y) * width + x] = palette[rng() % palette.size()];
+		}
+
+		// DXGI_OUTDUPL_MOVE_RECT: to gets what was at (from_x, from_y) before the move
+		void move(int from_x, int from_y, const rect& to)
+		{
+			const auto before = pixels;
+
+			for (int y = to.top; y < to.bottom; y++)
+				for (int x = to.left; x < to.right; x++)
+					pixels[static_cast<size_t>(y) * width + x] = before[static_cast<size_t>(from_y + y - to.top) * width + from_x + x - to.left];
+		}
+
+		rect random_rect(int max_size)
+		{
+			const int w = 1 + static_cast<int>(rng() % max_size);
+			const int h = 1 + static_cast<int>(rng() % max_size);
+			const int x = static_cast<int>(rng() % (width - (w < width ? w : width) + 1));
+			const int y = static_cast<int>(rng() % (height - (h < height ? h : height) + 1));
+
+			return intersect({ x, y, x + w, y + h }, { 0, 0, width, height });
+		}
+	};
+
+	size_t tiles_count(int width, int height)
+	{
+		const int size = tile_cache::tile_size;
+		return static_cast<size_t>((width + size - 1) / size) * ((height + size - 1) / size);
+	}
+
+	struct refresh_counts
+	{
+		size_t converted = 0;
+		size_t reused = 0;
+	};
+
+	// render_cached without the gpu: the invalid runs of area converted tile by tile into
+	// the cache, tiles whose source hashes like last time kept as they are
+	refresh_counts refresh(tile_cache& tiles, const screen& frame, const rect& area, const half_lut& lut)
+	{
+		const hdr_params hdr = { tone_operator::blend, white_level, &lut };
+		const auto convert = select_compose_kernel(input_format::scrgb, 0);
+		refresh_counts counts;
+
+		for (const auto& run : tiles.invalid_runs(area))
+		{
+			for (int tile_x = run.left; tile_x < run.right; tile_x += tile_cache::tile_size)
+			{
+				const rect tile = { tile_x, run.top, std::min(tile_x + tile_cache::tile_size, run.right), run.bottom };
+
+				const auto* in = reinterpret_cast<const uint8_t*>(frame.pixels.data()) + frame.pitch() * tile.top + 8 * static_cast<size_t>(tile.left);
+				auto* out = tiles.data() + tiles.pitch() * tile.top + 4 * static_cast<size_t>(tile.left);
+
+				const uint64_t hash = dispatch_hash_rows(in, frame.pitch(), 8 * static_cast<size_t>(tile.width()), tile.height());
+
+				if (hash == tiles.hash(tile))
+				{
+					counts.reused++;
+				}
+				else
+				{
+					convert({ in, frame.pitch(), tile.width(), tile.height() }, { out, tiles.pitch(), tile.width(), tile.height() }, 0, 0, &hdr);
+					counts.converted++;
+				}
+
+				tiles.validate(tile, hash);
+			}
+		}
+
+		return counts;
+	}
+
+	// the cached pixels of area against the whole frame tone mapped from scratch
+	bool matches_full_recompose(tile_cache& tiles, const screen& frame, const rect& area, const half_lut& lut)
+	{
+		const hdr_params hdr = { tone_operator::blend, white_level, &lut };
+		std::vector<uint8_t> expected(static_cast<size_t>(frame.width) * frame.height * 4);
+
+		select_compose_kernel(input_format::scrgb, 0)(
+			{ frame.pixels.data(), frame.pitch(), frame.width, frame.height },
+			{ expected.data(), tiles.pitch(), frame.width, frame.height },
+			0, 0, &hdr
+		);
+
+		for (int y = area.top; y < area.bottom; y++)
+		{
+			const size_t at = tiles.pitch() * y + 4 * static_cast<size_t>(area.left);
+			if (std::memcmp(tiles.data() + at, expected.data() + at, 4 * static_cast<size_t>(area.width())) != 0)
+				return false;
+		}
+
+		return true;
+	}
+}
+
+TEST(tile_cache, random_moves_and_dirty_rects)
+{
+	half_lut lut;
+	lut.update(white_level);
+
+	// sizes that aren't whole tiles
+	for (const auto& [width, height, seed] : { std::tuple{ 301, 203, 1u }, std::tuple{ 64, 64, 2u }, std::tuple{ 1000, 70, 3u } })
+	{
+		screen frame(width, height, seed);
+		tile_cache tiles;
+		const rect whole = { 0, 0, width, height };
+
+		CHECK(tiles.reset(width, height, { input_format::scrgb, tone_operator::blend, white_level }));
+		refresh(tiles, frame, whole, lut);
+		REQUIRE(matches_full_recompose(tiles, frame, whole, lut));
+
+		for (int step = 0; step < 200; step++)
+		{
+			// moves first, then the dirty rects relative to the moved image, like update_tiles
+			const int moves = static_cast<int>(frame.rng() % 3);
+			for (int i = 0; i < moves; i++)
+			{
+				const rect to = frame.random_rect(160);
+				const rect from = frame.random_rect(160);
+
+				// the source has to lie inside the frame like duplication's do
+				const int from_x = std::min(from.left, width - to.width());
+				const int from_y = std::min(from.top, height - to.height());
+
+				frame.move(from_x, from_y, to);
+				tiles.move(from_x, from_y, to);
+			}
+
+			const int dirty = static_cast<int>(frame.rng() % 4);
+			for (int i = 0; i < dirty; i++)
+			{
+				const rect area = frame.random_rect(100);
+				frame.draw(area);
+				tiles.invalidate(area);
+			}
+
+			// only part of the frame is captured now and then, the rest stays invalid
+			const rect area = step % 5 == 4 ? frame.random_rect(200) : whole;
+
+			refresh(tiles, frame, area, lut);
+			CHECK(tiles.invalid_runs(area).empty());
+			REQUIRE(matches_full_recompose(tiles, frame, area, lut));
+		}
+	}
+}
+
+TEST(tile_cache, hashes_cover_missing_and_coarse_dirty_rects)
+{
+	half_lut lut;
+	lut.update(white_level);
+
+	const int width = 320;
+	const int height = 192;
+	const rect whole = { 0, 0, width, height };
+
+	screen frame(width, height, 7);
+	tile_cache tiles;
+	tiles.reset(width, height, { input_format::scrgb, tone_operator::blend, white_level });
+	refresh(tiles, frame, whole, lut);
+
+	// a dirty rect over the whole frame for a change in one tile: only that tile is
+	// converted again, the rest hash like before
+	frame.draw({ 70, 70, 80, 80 });
+	tiles.invalidate(whole);
+
+	auto counts = refresh(tiles, frame, whole, lut);
+	CHECK(counts.converted == 1);
+	CHECK(counts.reused == tiles_count(width, height) - 1);
+	CHECK(matches_full_recompose(tiles, frame, whole, lut));
+
+	// no dirty rects at all after the duplication was recreated, just everything invalid
+	frame.draw({ 0, 0, 3, 3 });
+	frame.draw({ 300, 150, 320, 192 });
+	tiles.invalidate_all();
+
+	counts = refresh(tiles, frame, whole, lut);
+	CHECK(counts.converted == 2);
+	CHECK(matches_full_recompose(tiles, frame, whole, lut));
+
+	// a new white level throws all of it away, hashes included
+	lut.update(white_level * 2);
+	CHECK(tiles.reset(width, height, { input_format::scrgb, tone_operator::blend, white_level * 2 }));
+	CHECK(tiles.invalid_count() == tiles_count(width, height));
+	CHECK(!tiles.reset(width, height, { input_format::scrgb, tone_operator::blend, white_level * 2 }));
+}
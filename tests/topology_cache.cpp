@@ -0,0 +1,188 @@
+#include <atomic>
+#include <chrono>
+#include <map>
+#include <thread>
+
+#include "utils/topology_cache.hpp"
+
+#include "test.hpp"
+
+// topology_cache with a mocked Provider standing in for GetDesc1 and the display config
+// queries, and a clock the test moves by hand
+namespace
+{
+	using namespace std::chrono_literals;
+
+	// what monitor.cpp caches per output, without the dxgi types
+	struct mock_topology
+	{
+		int left = 0;
+		int top = 0;
+		int rotation = 0;
+		float white_level = 0.0f;
+	};
+
+	struct mock_provider
+	{
+		// the system's current state per output, what a query finds
+		std::map<int, mock_topology> outputs;
+		std::chrono::steady_clock::time_point clock{};
+		int queries = 0;
+
+		bool query(int output, mock_topology& topology)
+		{
+			queries++;
+
+			const auto found = outputs.find(output);
+			if (found == outputs.end())
+				return false;
+
+			topology = found->second;
+			return true;
+		}
+
+		std::chrono::steady_clock::time_point now()
+		{
+			return clock;
+		}
+	};
+
+	using cache_type = topology_cache<int, mock_topology, mock_provider>;
+
+	cache_type make_cache()
+	{
+		mock_provider provider;
+		provider.outputs[0] = { 0, 0, 0, 200.0f };
+		provider.outputs[1] = { 3840, 0, 90, 240.0f };
+
+		return cache_type(std::move(provider), 1s);
+	}
+}
+
+TEST(topology_cache, hits_until_max_age)
+{
+	auto cache = make_cache();
+	auto& provider = cache.provider();
+	mock_topology topology;
+
+	// every capture of a steady setup asks for both outputs, a second's worth of them
+	// queries each once
+	for (int capture = 0; capture < 100; capture++)
+	{
+		CHECK(cache.get(0, topology));
+		CHECK(cache.get(1, topology));
+		provider.clock += 9ms;
+	}
+
+	CHECK(provider.queries == 2);
+	CHECK(cache.hits() == 198);
+	CHECK(topology.rotation == 90);
+
+	// the white level slider moved without a notification: picked up once the second is up
+	provider.outputs[0].white_level = 320.0f;
+	CHECK(cache.get(0, topology));
+	CHECK(topology.white_level == 200.0f);
+
+	provider.clock += 100ms;
+	CHECK(cache.get(0, topology));
+	CHECK(topology.white_level == 320.0f);
+	CHECK(provider.queries == 3);
+}
+
+TEST(topology_cache, display_change_invalidates)
+{
+	auto cache = make_cache();
+	auto& provider = cache.provider();
+	mock_topology topology;
+
+	cache.get(0, topology);
+	cache.get(1, topology);
+
+	// the second monitor is rotated and moved, WM_DISPLAYCHANGE comes in
+	provider.outputs[1] = { -1080, 0, 270, 240.0f };
+	cache.invalidate();
+
+	// queried again right away, not a second later
+	CHECK(cache.get(1, topology));
+	CHECK(topology.left == -1080);
+	CHECK(topology.rotation == 270);
+
+	// every output, not just the one that changed
+	CHECK(cache.get(0, topology));
+	CHECK(provider.queries == 4);
+
+	// and cached again after that
+	CHECK(cache.get(1, topology));
+	CHECK(provider.queries == 4);
+}
+
+TEST(topology_cache, failed_queries_are_retried)
+{
+	auto cache = make_cache();
+	auto& provider = cache.provider();
+	mock_topology topology;
+
+	CHECK(cache.get(1, topology));
+
+	// unplugged: the query fails and nothing is kept, also not the old value
+	provider.outputs.erase(1);
+	cache.invalidate();
+	CHECK(!cache.get(1, topology));
+	CHECK(!cache.get(1, topology));
+	CHECK(provider.queries == 3);
+
+	// plugged back in
+	provider.outputs[1] = { 1920, 0, 0, 80.0f };
+	CHECK(cache.get(1, topology));
+	CHECK(topology.left == 1920);
+}
+
+TEST(topology_cache, forget)
+{
+	auto cache = make_cache();
+	auto& provider = cache.provider();
+	mock_topology topology;
+
+	cache.get(0, topology);
+
+	// a monitor destroyed, and a new output object created at the same address
+	cache.forget(0);
+	provider.outputs[0] = { 0, 0, 180, 100.0f };
+
+	CHECK(cache.get(0, topology));
+	CHECK(topology.rotation == 180);
+	CHECK(provider.queries == 2);
+}
+
+TEST(topology_cache, invalidate_from_another_thread)
+{
+	// the display watch window's thread invalidates while captures get
+	auto cache = make_cache();
+	std::atomic<bool> stop = false;
+
+	std::thread watcher([&] {
+		while (!stop)
+		{
+			cache.invalidate();
+			std::this_thread::yield();
+		}
+	});
+
+	mock_topology topology;
+	bool all_found = true;
+
+	for (int capture = 0; capture < 20000; capture++)
+		all_found &= cache.get(capture & 1, topology);
+
+	stop = true;
+	watcher.join();
+
+	CHECK(all_found);
+	CHECK(cache.hits() + cache.queries() == 20000);
+
+	// one more invalidate after the last get is always seen
+	const auto before = cache.queries();
+	cache.invalidate();
+	cache.get(0, topology);
+	CHECK(cache.queries() == before + 1);
+}
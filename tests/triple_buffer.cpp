@@ -0,0 +1,142 @@
+#include <cstdint>
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include <vector>
+
+#include "utils/triple_buffer.hpp"
+
+#include "test.hpp"
+
+// triple_buffer the way the warm capture thread and bitblt callers use it, with a
+// synthetic producer writing numbered frames
+namespace
+{
+	// every pixel holds the frame's number, a torn frame has more than one
+	struct numbered_frame
+	{
+		uint64_t number = 0;
+		std::vector<uint64_t> pixels;
+
+		void fill(uint64_t value, size_t size)
+		{
+			number = value;
+			pixels.assign(size, value);
+		}
+
+		bool complete() const
+		{
+			return std::all_of(pixels.begin(), pixels.end(), [&](uint64_t pixel) { return pixel == number; });
+		}
+	};
+}
+
+TEST(triple_buffer, empty_until_published)
+{
+	triple_buffer<numbered_frame> frames;
+
+	CHECK(!frames.read());
+
+	frames.back().fill(1, 4);
+	CHECK(!frames.read());
+
+	frames.publish();
+	const auto frame = frames.read();
+	REQUIRE(frame);
+	CHECK(frame->number == 1);
+}
+
+TEST(triple_buffer, newest_wins)
+{
+	triple_buffer<numbered_frame> frames;
+
+	for (uint64_t number = 1; number <= 10; number++)
+	{
+		frames.back().fill(number, 4);
+		frames.publish();
+	}
+
+	CHECK(frames.read()->number == 10);
+
+	// reading doesn't take the value away, every reader gets it until a newer one
+	CHECK(frames.read()->number == 10);
+}
+
+TEST(triple_buffer, pinned_frames_are_not_refilled)
+{
+	triple_buffer<numbered_frame> frames;
+
+	frames.back().fill(1, 64);
+	frames.publish();
+
+	const auto held = frames.read();
+	const auto* held_frame = &*held;
+
+	// the producer goes on around the other two slots
+	for (uint64_t number = 2; number < 100; number++)
+	{
+		CHECK(&frames.back() != held_frame);
+		frames.back().fill(number, 64);
+		frames.publish();
+	}
+
+	CHECK(held->number == 1);
+	CHECK(held->complete());
+	CHECK(frames.read()->number == 99);
+
+	// two readers on different frames leave the producer one slot
+	const auto newer = frames.read();
+	CHECK(&frames.back() != held_frame);
+	CHECK(&frames.back() != &*newer);
+}
+
+TEST(triple_buffer, concurrent_readers)
+{
+	triple_buffer<numbered_frame> frames;
+	std::atomic<bool> done = false;
+	constexpr uint64_t last = 20000;
+
+	std::thread producer([&] {
+		for (uint64_t number = 1; number <= last; number++)
+		{
+			frames.back().fill(number, 256);
+			frames.publish();
+		}
+
+		done = true;
+	});
+
+	std::atomic<int> failures = 0;
+	std::vector<std::thread> readers;
+
+	for (int i = 0; i < 3; i++)
+	{
+		readers.emplace_back([&] {
+			uint64_t previous = 0;
+
+			while (true)
+			{
+				const bool finished = done;
+
+				if (const auto frame = frames.read())
+				{
+					// never torn, never older than what this reader saw before
+					failures += !frame->complete() || frame->number < previous;
+					previous = frame->number;
+				}
+
+				if (finished)
+					break;
+			}
+
+			// the last frame is the newest once the producer is done
+			failures += previous != last;
+		});
+	}
+
+	producer.join();
+	for (auto& reader : readers)
+		reader.join();
+
+	CHECK(failures == 0);
+}
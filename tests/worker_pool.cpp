@@ -0,0 +1,74 @@
+#include <atomic>
+#include <thread>
+#include <vector>
+
+#include "tonemap/worker_pool.hpp"
+
+#include "test.hpp"
+
+using tonemap::worker_pool;
+
+TEST(worker_pool, runs_every_task_once)
+{
+	worker_pool pool(3);
+	CHECK(pool.size() == 4);
+
+	// the same threads run after run
+	for (const int count : { 0, 1, 2, 4, 7, 100, 3 })
+	{
+		std::vector<std::atomic<int>> runs(count);
+		pool.run(count, [&](int i) { runs[i]++; });
+
+		for (const auto& run : runs)
+			CHECK(run == 1);
+	}
+}
+
+TEST(worker_pool, without_threads)
+{
+	worker_pool pool(0);
+	CHECK(pool.size() == 1);
+
+	const auto caller = std::this_thread::get_id();
+	int runs = 0;
+
+	pool.run(5, [&](int) {
+		CHECK(std::this_thread::get_id() == caller);
+		runs++;
+	});
+
+	CHECK(runs == 5);
+}
+
+TEST(worker_pool, nested_runs)
+{
+	worker_pool pool(2);
+	std::atomic<int> runs = 0;
+
+	// a task running another one doesn't wait for threads busy with its own run
+	pool.run(4, [&](int) {
+		pool.run(4, [&](int) { runs++; });
+	});
+
+	CHECK(runs == 16);
+}
+
+TEST(worker_pool, concurrent_callers)
+{
+	worker_pool pool(2);
+	std::atomic<int> runs = 0;
+	std::vector<std::thread> callers;
+
+	for (int i = 0; i < 4; i++)
+	{
+		callers.emplace_back([&] {
+			for (int j = 0; j < 200; j++)
+				pool.run(8, [&](int) { runs++; });
+		});
+	}
+
+	for (auto& caller : callers)
+		caller.join();
+
+	CHECK(runs == 4 * 200 * 8);
+}
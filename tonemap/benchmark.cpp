@@ -0,0 +1,232 @@
+#include <cstdint>
+#include <cstring>
+#include <chrono>
+#include <random>
+#include <algorithm>
+
+#include "tonemap.hpp"
+#include "operators.hpp"
+#include "dispatch.hpp"
+#include "benchmark.hpp"
+#include "tile_cache.hpp"
+#include "copy.hpp"
+#include "cube_lut.hpp"
+
+namespace tonemap
+{
+	namespace
+	{
+		std::vector<uint16_t> make_frame(int width, int height, float white_level)
+		{
+			std::mt19937 rng(2084);
+			std::uniform_real_distribution<float> sdr(0.0f, white_level / 80.0f);
+			std::uniform_real_distribution<float> hdr(0.0f, 1000.0f / 80.0f);
+			std::bernoulli_distribution highlight(0.2);
+
+			std::vector<uint16_t> frame(static_cast<size_t>(width) * height * 4);
+
+			for (size_t i = 0; i < frame.size(); i += 4)
+			{
+				auto& range = highlight(rng) ? hdr : sdr;
+
+				frame[i + 0] = float_to_half(range(rng));
+				frame[i + 1] = float_to_half(range(rng));
+				frame[i + 2] = float_to_half(range(rng));
+				frame[i + 3] = float_to_half(1.0f);
+			}
+
+			return frame;
+		}
+	}
+
+	std::vector<benchmark_result> run_benchmark(int width, int height, float white_level, int runs)
+	{
+		const auto frame = make_frame(width, height, white_level);
+		const size_t src_pitch = static_cast<size_t>(width) * 8;
+		const size_t dest_pitch = static_cast<size_t>(width) * 4;
+
+		std::vector<uint8_t> reference(dest_pitch * height);
+		std::vector<uint8_t> out(reference.size());
+
+		std::vector<benchmark_result> results;
+
+		for (int i = 0; i < tone_operator_count; i++)
+		{
+			const auto op = static_cast<tone_operator>(i);
+			hdr_to_bgra8(frame.data(), src_pitch, reference.data(), dest_pitch, width, height, white_level, op);
+
+			hdr_kernel previous = nullptr;
+
+			for (int level = 0; level <= static_cast<int>(detect_isa()); level++)
+			{
+				const auto kernel = select_operator_kernel(op, static_cast<isa>(level));
+				if (kernel == previous)
+					continue;
+
+				previous = kernel;
+
+				double best = 0.0;
+				for (int run = 0; run < std::max(runs, 1); run++)
+				{
+					const auto start = std::chrono::steady_clock::now();
+					kernel(frame.data(), src_pitch, out.data(), dest_pitch, width, height, white_level);
+					const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+					best = std::max(best, static_cast<double>(width) * height / elapsed.count() / 1e6);
+				}
+
+				results.push_back({
+					op, static_cast<isa>(level), best,
+					compare_bgra8(reference.data(), dest_pitch, out.data(), dest_pitch, width, height),
+				});
+			}
+		}
+
+		return results;
+	}
+
+	std::vector<cube_benchmark_result> run_cube_benchmark(int width, int height, float white_level, int runs)
+	{
+		const auto frame = make_frame(width, height, white_level);
+		const size_t src_pitch = static_cast<size_t>(width) * 8;
+		const size_t dest_pitch = static_cast<size_t>(width) * 4;
+
+		std::vector<uint8_t> reference(dest_pitch * height);
+		std::vector<uint8_t> out(reference.size());
+		hdr_to_bgra8(frame.data(), src_pitch, reference.data(), dest_pitch, width, height, white_level);
+
+		std::vector<cube_benchmark_result> results;
+
+		for (const int size : { cube_lut::small, cube_lut::large })
+		{
+			cube_lut lut;
+			lut.update(white_level, size);
+			const error_stats sweep = lut.measure_error();
+
+			hdr_cube_kernel previous = nullptr;
+
+			for (int level = 0; level <= static_cast<int>(detect_isa()); level++)
+			{
+				const auto kernel = select_hdr_cube_kernel(static_cast<isa>(level));
+				if (kernel == previous)
+					continue;
+
+				previous = kernel;
+
+				double best = 0.0;
+				for (int run = 0; run < std::max(runs, 1); run++)
+				{
+					const auto start = std::chrono::steady_clock::now();
+					kernel(frame.data(), src_pitch, out.data(), dest_pitch, width, height, lut);
+					const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+					best = std::max(best, static_cast<double>(width) * height / elapsed.count() / 1e6);
+				}
+
+				results.push_back({
+					size, static_cast<isa>(level), best,
+					compare_bgra8(reference.data(), dest_pitch, out.data(), dest_pitch, width, height),
+					sweep,
+				});
+			}
+		}
+
+		return results;
+	}
+
+	std::vector<hash_benchmark_result> run_hash_benchmark(int width, int height, int runs)
+	{
+		const auto frame = make_frame(width, height, 200.0f);
+		const size_t pitch = static_cast<size_t>(width) * 8;
+		constexpr int tile = tile_cache::tile_size;
+
+		std::vector<hash_benchmark_result> results;
+		hash_kernel previous = nullptr;
+
+		// every hash ends up here so none of the calls can be left out
+		volatile uint64_t sink = 0;
+
+		for (int level = 0; level <= static_cast<int>(detect_isa()); level++)
+		{
+			const auto kernel = select_hash_kernel(static_cast<isa>(level));
+			if (kernel == previous)
+				continue;
+
+			previous = kernel;
+
+			double best = 0.0;
+			for (int run = 0; run < std::max(runs, 1); run++)
+			{
+				uint64_t combined = 0;
+
+				const auto start = std::chrono::steady_clock::now();
+
+				for (int y = 0; y < height; y += tile)
+				{
+					for (int x = 0; x < width; x += tile)
+					{
+						const int tile_width = std::min(tile, width - x);
+						const int tile_height = std::min(tile, height - y);
+						combined ^= kernel(frame.data() + (pitch / 2) * y + 4 * static_cast<size_t>(x), pitch, 8 * static_cast<size_t>(tile_width), tile_height);
+					}
+				}
+
+				const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+				sink = sink ^ combined;
+
+				best = std::max(best, 1.0 / elapsed.count());
+			}
+
+			results.push_back({
+				static_cast<isa>(level),
+				best * pitch * height / 1e9,
+				best * width * height / 1e6,
+			});
+		}
+
+		return results;
+	}
+
+	std::vector<copy_benchmark_result> run_copy_benchmark(int runs)
+	{
+		constexpr int sizes[][2] = { { 1920, 1080 }, { 3840, 2160 }, { 7680, 4320 }, { 11520, 2160 } };
+
+		std::vector<copy_benchmark_result> results;
+
+		for (const auto [width, height] : sizes)
+		{
+			const size_t row_bytes = static_cast<size_t>(width) * 4;
+			const size_t src_pitch = (row_bytes + 255) / 256 * 256 + 256;
+
+			std::vector<uint8_t> src(src_pitch * height, 0x40);
+			std::vector<uint8_t> dest(row_bytes * height);
+
+			auto best_of = [&](auto&& copy) {
+				double best = 0.0;
+				for (int run = 0; run < std::max(runs, 1); run++)
+				{
+					const auto start = std::chrono::steady_clock::now();
+					copy();
+					const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+					best = std::max(best, static_cast<double>(row_bytes) * height / elapsed.count() / 1e9);
+				}
+
+				return best;
+			};
+
+			const double rows = best_of([&] {
+				for (int y = 0; y < height; y++)
+					std::memcpy(dest.data() + row_bytes * y, src.data() + src_pitch * y, row_bytes);
+			});
+
+			const double frame = best_of([&] {
+				copy_frame(src.data(), src_pitch, dest.data(), row_bytes, row_bytes, height);
+			});
+
+			results.push_back({ width, height, rows, frame });
+		}
+
+		return results;
+	}
+}
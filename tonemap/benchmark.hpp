@@ -0,0 +1,62 @@
+#pragma once
+#include <vector>
+
+#include "tonemap.hpp"
+#include "operators.hpp"
+#include "dispatch.hpp"
+
+namespace tonemap
+{
+	struct benchmark_result
+	{
+		tone_operator op;
+		isa level;
+		double mpx_per_second;
+		error_stats error; // against the scalar hdr_to_bgra8 for the same operator
+	};
+
+	// times select_operator_kernel for every operator and every isa up to
+	// detect_isa() on a synthetic width x height frame, best of runs passes.
+	// Levels that resolve to the same kernel as the level below are left out.
+	// The frame is mostly sdr range content at white_level with a fifth of
+	// the pixels spread up to 1000 nits, the same for every call
+	std::vector<benchmark_result> run_benchmark(int width, int height, float white_level, int runs = 5);
+
+	struct cube_benchmark_result
+	{
+		int size;
+		isa level;
+		double mpx_per_second;
+		error_stats error; // against the scalar hdr_to_bgra8, on the frame
+		error_stats sweep; // cube_lut::measure_error
+	};
+
+	// times select_hdr_cube_kernel for both cube_lut sizes the same way, on the same frame
+	std::vector<cube_benchmark_result> run_cube_benchmark(int width, int height, float white_level, int runs = 5);
+
+	struct hash_benchmark_result
+	{
+		isa level;
+		double gb_per_second;
+		double mpx_per_second; // fp16 pixels, comparable to benchmark_result
+	};
+
+	// times select_hash_kernel for every isa up to detect_isa() on the same kind of
+	// frame as run_benchmark, hashed in tile_cache::tile_size tiles, best of runs passes.
+	// Hashing a tile instead of tone mapping it only pays off while this is well above
+	// the operators' Mpx/s
+	std::vector<hash_benchmark_result> run_hash_benchmark(int width, int height, int runs = 5);
+
+	struct copy_benchmark_result
+	{
+		int width;
+		int height;
+		double row_gb_per_second; // one memcpy per row
+		double gb_per_second;     // copy_frame
+	};
+
+	// times copy_frame against a memcpy per row on 1080p, 4k, 8k and triple 4k bgra8
+	// frames, from a padded pitch like a mapped staging texture's into a packed buffer,
+	// best of runs passes. Needs twice the largest frame in memory, about 265 MB
+	std::vector<copy_benchmark_result> run_copy_benchmark(int runs = 5);
+}
@@ -0,0 +1,169 @@
+#include <cstdint>
+#include <vector>
+#include <algorithm>
+
+#include "tonemap.hpp"
+#include "compose.hpp"
+#include "dispatch.hpp"
+#include "half_lut.hpp"
+#include "cube_lut.hpp"
+#include "operators.hpp"
+#include "pq10.hpp"
+#include "histogram.hpp"
+#include "rotate.hpp"
+#include "rect.hpp"
+#include "copy.hpp"
+
+namespace tonemap
+{
+	namespace
+	{
+		template<input_format Format>
+		void convert(
+			const void* src, size_t src_pitch,
+			void* dest, size_t dest_pitch,
+			int width, int height, const hdr_params* hdr
+		)
+		{
+			if constexpr (Format == input_format::pq10)
+			{
+				dispatch_pq10_to_bgra8(src, src_pitch, dest, dest_pitch, width, height, hdr->white_level, hdr->op);
+			}
+			else if constexpr (Format == input_format::scrgb)
+			{
+				if (hdr->op == tone_operator::blend && hdr->cube)
+					dispatch_hdr_to_bgra8(src, src_pitch, dest, dest_pitch, width, height, *hdr->cube);
+				else if (hdr->op == tone_operator::blend)
+					dispatch_hdr_to_bgra8(src, src_pitch, dest, dest_pitch, width, height, *hdr->lut);
+				else
+					dispatch_hdr_to_bgra8(src, src_pitch, dest, dest_pitch, width, height, hdr->white_level, hdr->op);
+			}
+			else if constexpr (Format == input_format::bgra8)
+				bgra8_to_bgra8(src, src_pitch, dest, dest_pitch, width, height);
+			else
+				dispatch_sdr_to_bgra8(src, src_pitch, dest, dest_pitch, width, height);
+		}
+
+		// source rows converted and rotated at a time, 16 fill whole 64 byte lines on
+		// the rotated side for 90 and 270
+		constexpr int rotate_strip = 16;
+
+		// rows handed to the histogram at a time, small enough to still be in l2 after converting
+		constexpr int histogram_rows = 8;
+
+		// the part of src that lands on dest, in source coordinates: the canvas taken
+		// back through the rotation and clipped to the frame
+		rect visible_rect(const source_frame& src, const canvas& dest, int x, int y, int rotation)
+		{
+			const rect frame = { 0, 0, src.width, src.height };
+			const rect canvas_area = offset({ 0, 0, dest.width, dest.height }, -x, -y);
+
+			return intersect(unrotate(canvas_area, rotation, src.width, src.height), frame);
+		}
+
+		// source rows [first, last) of the frame
+		template<input_format Format, int Rotation>
+		void compose_rows(const source_frame& src, const canvas& dest, int x, int y, const hdr_params* hdr, int first, int last)
+		{
+			const rect area = intersect(visible_rect(src, dest, x, y, Rotation), { 0, first, src.width, last });
+
+			if (area.empty())
+				return;
+
+			const auto* in = static_cast<const uint8_t*>(src.data) + src.pitch * area.top + bytes_per_pixel(Format) * area.left;
+			const int width = area.width();
+
+			if constexpr (Rotation == 0)
+			{
+				// converted in place in one pass
+				auto* out = static_cast<uint8_t*>(dest.data) + dest.pitch * (y + area.top) + 4 * static_cast<size_t>(x + area.left);
+				convert<Format>(in, src.pitch, out, dest.pitch, width, area.height(), hdr);
+			}
+			else
+			{
+				// strips are converted into a scratch buffer, then rotated onto the canvas
+				// block by block instead of scattering single pixels across rows
+				std::vector<uint32_t> strip(static_cast<size_t>(width) * rotate_strip);
+				const size_t strip_pitch = static_cast<size_t>(width) * 4;
+
+				for (int row = area.top; row < area.bottom; row += rotate_strip)
+				{
+					const int end = std::min(row + rotate_strip, area.bottom);
+					convert<Format>(in + src.pitch * (row - area.top), src.pitch, strip.data(), strip_pitch, width, end - row, hdr);
+
+					const rect to = rotate(rect{ area.left, row, area.right, end }, Rotation, src.width, src.height);
+
+					auto* out = static_cast<uint8_t*>(dest.data) + dest.pitch * (y + to.top) + 4 * static_cast<size_t>(x + to.left);
+					dispatch_rotate_bgra8(strip.data(), strip_pitch, out, dest.pitch, width, end - row, Rotation);
+				}
+			}
+		}
+
+		template<input_format Format, int Rotation>
+		void compose(const source_frame& src, const canvas& dest, int x, int y, const hdr_params* hdr)
+		{
+			if constexpr (is_hdr(Format))
+			{
+				if (hdr->histogram)
+				{
+					// each band histograms the rows it just converted while they're still cached
+					for_each_band(src.height, *hdr->histogram, [&](int first, int last, luminance_histogram& bins) {
+						for (int row = first; row < last; row += histogram_rows)
+						{
+							const int end = std::min(row + histogram_rows, last);
+							compose_rows<Format, Rotation>(src, dest, x, y, hdr, row, end);
+
+							const auto* in = static_cast<const uint8_t*>(src.data) + src.pitch * row;
+							bins.add_rows(in, src.pitch, src.width, end - row, Format);
+						}
+					});
+
+					return;
+				}
+			}
+
+			compose_rows<Format, Rotation>(src, dest, x, y, hdr, 0, src.height);
+		}
+
+		using enum input_format;
+
+		constexpr compose_kernel kernels[4][4] =
+		{
+			{ compose<sdr, 0>, compose<sdr, 90>, compose<sdr, 180>, compose<sdr, 270> },
+			{ compose<scrgb, 0>, compose<scrgb, 90>, compose<scrgb, 180>, compose<scrgb, 270> },
+			{ compose<pq10, 0>, compose<pq10, 90>, compose<pq10, 180>, compose<pq10, 270> },
+			{ compose<bgra8, 0>, compose<bgra8, 90>, compose<bgra8, 180>, compose<bgra8, 270> },
+		};
+	}
+
+	compose_kernel select_compose_kernel(input_format format, int rotation)
+	{
+		return kernels[static_cast<int>(format)][(rotation / 90) & 3];
+	}
+
+	void place_bgra8(const source_frame& src, const canvas& dest, int x, int y, int rotation)
+	{
+		const rect area = visible_rect(src, dest, x, y, rotation);
+		if (area.empty())
+			return;
+
+		const rect to = rotate(area, rotation, src.width, src.height);
+
+		if (rotation == 0)
+		{
+			copy_frame(
+				static_cast<const uint8_t*>(src.data) + src.pitch * area.top + 4 * static_cast<size_t>(area.left), src.pitch,
+				static_cast<uint8_t*>(dest.data) + dest.pitch * (y + to.top) + 4 * static_cast<size_t>(x + to.left), dest.pitch,
+				4 * static_cast<size_t>(area.width()), area.height()
+			);
+
+			return;
+		}
+
+		dispatch_rotate_bgra8(
+			static_cast<const uint8_t*>(src.data) + src.pitch * area.top + 4 * static_cast<size_t>(area.left), src.pitch,
+			static_cast<uint8_t*>(dest.data) + dest.pitch * (y + to.top) + 4 * static_cast<size_t>(x + to.left), dest.pitch,
+			area.width(), area.height(), rotation
+		);
+	}
+}
@@ -0,0 +1,57 @@
+#pragma once
+#include <cstddef>
+
+#include "tonemap.hpp"
+
+namespace tonemap
+{
+	class half_lut;
+	class cube_lut;
+	class luminance_histogram;
+	enum class tone_operator;
+
+	// one monitor's duplicated frame in its unrotated orientation, in the
+	// input_format the kernel was selected for
+	struct source_frame
+	{
+		const void* data;
+		size_t pitch;
+		int width;
+		int height;
+	};
+
+	// the B8G8R8A8_UNORM virtual desktop the monitors are composed into
+	struct canvas
+	{
+		void* data;
+		size_t pitch;
+		int width;
+		int height;
+	};
+
+	// how hdr frames are tone mapped, lut is the decode table for white_level and
+	// only read by the blend operator, which goes through cube instead when it's set.
+	// A non null histogram gets the frame's luminance added, in the same pass spread
+	// over worker threads
+	struct hdr_params
+	{
+		tone_operator op;
+		float white_level;
+		const half_lut* lut;
+		luminance_histogram* histogram = nullptr;
+		const cube_lut* cube = nullptr;
+	};
+
+	// places src with its top left corner at (x, y) on dest, rotated like the shader's
+	// TONEMAP_ROTATION, pixels falling outside dest are dropped. hdr is only read
+	// for scrgb and pq10 frames
+	using compose_kernel = void (*)(const source_frame& src, const canvas& dest, int x, int y, const hdr_params* hdr);
+
+	// the permutation for one monitor, rotation in degrees (0, 90, 180 or 270).
+	// The unrotated sdr kernel is a plain swizzling copy
+	compose_kernel select_compose_kernel(input_format format, int rotation);
+
+	// src already converted to bgra8 placed like a compose_kernel would, only rotated
+	// and clipped. For frames coming out of a tile_cache
+	void place_bgra8(const source_frame& src, const canvas& dest, int x, int y, int rotation);
+}
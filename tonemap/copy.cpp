@@ -0,0 +1,68 @@
+#include <cstdint>
+#include <cstring>
+#include <algorithm>
+
+#include "copy.hpp"
+#include "dispatch.hpp"
+#include "worker_pool.hpp"
+
+namespace tonemap
+{
+	namespace
+	{
+		// fewer bytes than this per band isn't worth handing to another thread
+		constexpr size_t min_band_bytes = static_cast<size_t>(4) << 20;
+
+		// the threads share the memory bandwidth, past a handful more only contend for it
+		constexpr int max_bands = 8;
+
+		int band_count(size_t bytes, int height, int threads)
+		{
+			const int by_size = static_cast<int>(std::min(bytes / min_band_bytes, static_cast<size_t>(max_bands)));
+			return std::clamp(by_size, 1, std::min({ threads, max_bands, height }));
+		}
+	}
+
+	void copy_rows(const void* src, size_t src_pitch, void* dest, size_t dest_pitch, size_t row_bytes, int height)
+	{
+		if (height <= 0)
+			return;
+
+		if (src_pitch == row_bytes && dest_pitch == row_bytes)
+		{
+			std::memcpy(dest, src, row_bytes * height);
+			return;
+		}
+
+		for (int y = 0; y < height; y++)
+			std::memcpy(static_cast<uint8_t*>(dest) + dest_pitch * y, static_cast<const uint8_t*>(src) + src_pitch * y, row_bytes);
+	}
+
+	void copy_frame(const void* src, size_t src_pitch, void* dest, size_t dest_pitch, size_t row_bytes, int height)
+	{
+		if (height <= 0 || !row_bytes)
+			return;
+
+		const size_t bytes = row_bytes * height;
+
+		// below the llc size the copy is still cached for whoever reads it next
+		const copy_kernel copy = bytes > last_level_cache_size() ? select_copy_kernel(active_isa()) : copy_rows;
+
+		auto& pool = workers();
+		const int count = band_count(bytes, height, pool.size());
+		const int rows = (height + count - 1) / count;
+		const int bands = (height + rows - 1) / rows;
+
+		// packed rows are still packed within a band, each one is a single copy
+		pool.run(bands, [&](int i) {
+			const int first = i * rows;
+			const int last = std::min(first + rows, height);
+
+			copy(
+				static_cast<const uint8_t*>(src) + src_pitch * first, src_pitch,
+				static_cast<uint8_t*>(dest) + dest_pitch * first, dest_pitch,
+				row_bytes, last - first
+			);
+		});
+	}
+}
@@ -0,0 +1,14 @@
+#pragma once
+#include <cstddef>
+
+namespace tonemap
+{
+	// height rows of row_bytes each from src to dest, pitch apart on each side. Rows
+	// packed on both sides are copied as one block, otherwise one memcpy per row
+	void copy_rows(const void* src, size_t src_pitch, void* dest, size_t dest_pitch, size_t row_bytes, int height);
+
+	// copy_rows for frame sized copies. One that doesn't fit in the llc goes through
+	// streaming stores so it doesn't evict what's being read, and big ones are split into
+	// bands of rows copied on workers(), a single core can't saturate memory bandwidth
+	void copy_frame(const void* src, size_t src_pitch, void* dest, size_t dest_pitch, size_t row_bytes, int height);
+}
@@ -0,0 +1,245 @@
+#include <cmath>
+#include <algorithm>
+
+#include "tonemap.hpp"
+#include "cube_lut.hpp"
+
+namespace tonemap
+{
+	namespace
+	{
+		// share of the grid spent on decoded values in [0, 1]
+		constexpr float linear_share = 0.5f;
+
+		float log_range(float white_level)
+		{
+			return std::max(std::log(hdr_decode(10000.0f, white_level)), 1e-3f);
+		}
+
+		float shape(float x, float log_max)
+		{
+			if (x <= 1.0f)
+				return x * linear_share;
+
+			return std::min(linear_share + (1.0f - linear_share) * std::log(x) / log_max, 1.0f);
+		}
+
+		float unshape(float u, float log_max)
+		{
+			if (u <= linear_share)
+				return u / linear_share;
+
+			return std::exp((u - linear_share) / (1.0f - linear_share) * log_max);
+		}
+
+		// what hdr_tone scales by the linear luma on the bright side. Black has no
+		// chroma, and no pixel that bright samples a cell touching it
+		float3 neutral_chroma(float3 color)
+		{
+			const float3 result = neutral(color);
+			const float luma = rgb_to_luma(result);
+
+			if (!(luma > 0.0f))
+				return { 1.0f, 1.0f, 1.0f };
+
+			return { result.r / luma, result.g / luma, result.b / luma };
+		}
+	}
+
+	bool cube_lut::update(float white_level, int size)
+	{
+		if (valid() && white_level == white_level_ && size == size_)
+			return false;
+
+		const float log_max = log_range(white_level);
+		const float last = static_cast<float>(size - 1);
+
+		shaper_.resize(65536);
+		linear_.resize(65536);
+
+		for (size_t i = 0; i < shaper_.size(); i++)
+		{
+			const float x = hdr_decode(half_to_float(static_cast<uint16_t>(i)), white_level);
+
+			shaper_[i] = shape(x, log_max) * last;
+			linear_[i] = linear_tonemap({ x, x, x }).r;
+		}
+
+		std::vector<float> nodes(size);
+		for (int i = 0; i < size; i++)
+			nodes[i] = unshape(i / last, log_max);
+
+		table_.resize(static_cast<size_t>(size) * size * size * 4);
+		auto* entry = table_.data();
+
+		for (int b = 0; b < size; b++)
+		{
+			for (int g = 0; g < size; g++)
+			{
+				for (int r = 0; r < size; r++, entry += 4)
+				{
+					const float3 color = neutral_chroma({ nodes[r], nodes[g], nodes[b] });
+
+					entry[0] = color.r;
+					entry[1] = color.g;
+					entry[2] = color.b;
+					entry[3] = 0.0f;
+				}
+			}
+		}
+
+		white_level_ = white_level;
+		size_ = size;
+
+		return true;
+	}
+
+	bool cube_lut::valid() const
+	{
+		return size_ != 0;
+	}
+
+	float cube_lut::white_level() const
+	{
+		return white_level_;
+	}
+
+	int cube_lut::size() const
+	{
+		return size_;
+	}
+
+	const float* cube_lut::shaper() const
+	{
+		return shaper_.data();
+	}
+
+	const float* cube_lut::linear() const
+	{
+		return linear_.data();
+	}
+
+	const float* cube_lut::table() const
+	{
+		return table_.data();
+	}
+
+	float3 cube_lut::chroma(uint16_t r, uint16_t g, uint16_t b) const
+	{
+		const float cr = shaper_[r];
+		const float cg = shaper_[g];
+		const float cb = shaper_[b];
+
+		// clamp the cell so the far corner exists, the fraction reaches 1 on the last node
+		const float top = static_cast<float>(size_ - 2);
+		const float br = std::min(std::floor(cr), top);
+		const float bg = std::min(std::floor(cg), top);
+		const float bb = std::min(std::floor(cb), top);
+
+		const float fr = cr - br;
+		const float fg = cg - bg;
+		const float fb = cb - bb;
+
+		const int stride_r = 1;
+		const int stride_g = size_;
+		const int stride_b = size_ * size_;
+
+		// the tetrahedron walks from c000 along the largest fraction's axis, then the
+		// middle one, ending at c111
+		const bool r_max = fr >= fg && fr >= fb;
+		const bool g_max = !r_max && fg >= fb;
+		const bool b_min = fb <= fr && fb <= fg;
+		const bool g_min = !b_min && fg <= fr;
+
+		const int base = (static_cast<int>(bb) * size_ + static_cast<int>(bg)) * size_ + static_cast<int>(br);
+		const int first = r_max ? stride_r : (g_max ? stride_g : stride_b);
+		const int second = stride_r + stride_g + stride_b - (b_min ? stride_b : (g_min ? stride_g : stride_r));
+
+		const float s0 = std::max(fr, std::max(fg, fb));
+		const float s1 = std::max(std::min(fr, fg), std::min(std::max(fr, fg), fb));
+		const float s2 = std::min(fr, std::min(fg, fb));
+
+		const float* c0 = &table_[static_cast<size_t>(base) * 4];
+		const float* c1 = &table_[static_cast<size_t>(base + first) * 4];
+		const float* c2 = &table_[static_cast<size_t>(base + second) * 4];
+		const float* c3 = &table_[static_cast<size_t>(base + stride_r + stride_g + stride_b) * 4];
+
+		float out[3];
+		for (int i = 0; i < 3; i++)
+			out[i] = c0[i] + s0 * (c1[i] - c0[i]) + s1 * (c2[i] - c1[i]) + s2 * (c3[i] - c2[i]);
+
+		return { out[0], out[1], out[2] };
+	}
+
+	float3 cube_lut::tone(uint16_t r, uint16_t g, uint16_t b) const
+	{
+		const float3 linear_result = { linear_[r], linear_[g], linear_[b] };
+		const float linear_luma = rgb_to_luma(linear_result);
+
+		if (linear_luma < 0.8f)
+			return linear_result;
+
+		const float3 scale = chroma(r, g, b);
+
+		return { scale.r * linear_luma, scale.g * linear_luma, scale.b * linear_luma };
+	}
+
+	error_stats cube_lut::measure_error() const
+	{
+		// 64 levels per channel, 0 then quarter stops up to 10000 nits
+		const int levels = 64;
+		const int width = levels * levels;
+		const int height = levels;
+
+		std::vector<uint16_t> src(static_cast<size_t>(width) * height * 4);
+		std::vector<uint8_t> direct(static_cast<size_t>(width) * height * 4);
+		std::vector<uint8_t> baked(direct.size());
+
+		auto level = [](int i) {
+			return float_to_half(i ? 125.0f * std::exp2((i - (levels - 1)) * 0.25f) : 0.0f);
+		};
+
+		auto* px = src.data();
+		for (int b = 0; b < levels; b++)
+		{
+			for (int g = 0; g < levels; g++)
+			{
+				for (int r = 0; r < levels; r++, px += 4)
+				{
+					px[0] = level(r);
+					px[1] = level(g);
+					px[2] = level(b);
+					px[3] = float_to_half(1.0f);
+				}
+			}
+		}
+
+		hdr_to_bgra8(src.data(), width * 8, direct.data(), width * 4, width, height, white_level_);
+		hdr_to_bgra8_cube(src.data(), width * 8, baked.data(), width * 4, width, height, *this);
+
+		return compare_bgra8(direct.data(), width * 4, baked.data(), width * 4, width, height);
+	}
+
+	void hdr_to_bgra8_cube(
+		const void* src, size_t src_pitch,
+		void* dest, size_t dest_pitch,
+		int width, int height, const cube_lut& lut
+	)
+	{
+		for (int y = 0; y < height; y++)
+		{
+			const auto* in = reinterpret_cast<const uint16_t*>(static_cast<const uint8_t*>(src) + src_pitch * y);
+			auto* out = static_cast<uint8_t*>(dest) + dest_pitch * y;
+
+			for (int x = 0; x < width; x++, in += 4, out += 4)
+			{
+				const float3 color = lut.tone(in[0], in[1], in[2]);
+
+				out[0] = to_unorm8(color.b);
+				out[1] = to_unorm8(color.g);
+				out[2] = to_unorm8(color.r);
+				out[3] = 0xff;
+			}
+		}
+	}
+}
@@ -0,0 +1,68 @@
+#pragma once
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+
+#include "tonemap.hpp"
+
+namespace tonemap
+{
+	// the blend operator baked for one white level. Two tables indexed by the raw half
+	// bits give each channel's linear_tonemap result and its grid coordinate, and a
+	// size^3 grid read back with tetrahedral interpolation holds the neutral branch's
+	// chroma, neutral() divided by its own luma.
+	//
+	// The linear result and its luma are exact, so the luma 0.8 edge between the two
+	// branches of hdr_tone falls on the same pixels as in hdr_to_bgra8 and stays out
+	// of the grid, which only has to follow the smooth chroma on the bright side. The
+	// grid is linear over decoded values [0, 1] and logarithmic from 1 up to the
+	// decoded 10000 nits. Against hdr_to_bgra8 over measure_error()'s sweep at 200
+	// nits, in 8 bit steps with the mean taken over all BGRA bytes:
+	//   33^3: max 2, mean 0.045, 4.4% of bytes differ
+	//   65^3: max 1, mean 0.012, 1.2% of bytes differ
+	class cube_lut
+	{
+	public:
+		static constexpr int small = 33;
+		static constexpr int large = 65;
+
+		// rebuilds only when white_level or size differ from the current tables,
+		// returns true if it did
+		bool update(float white_level, int size = small);
+
+		bool valid() const;
+		float white_level() const;
+		int size() const;
+
+		// 65536 grid coordinates in [0, size - 1]
+		const float* shaper() const;
+
+		// 65536 linear_tonemap results
+		const float* linear() const;
+
+		// size^3 entries of r, g, b, 0, red varies fastest then green then blue
+		const float* table() const;
+
+		// hdr_tone of the decoded channels
+		float3 tone(uint16_t r, uint16_t g, uint16_t b) const;
+
+		// compares the cube path against hdr_to_bgra8 over a fixed sweep of inputs
+		error_stats measure_error() const;
+
+	private:
+		float3 chroma(uint16_t r, uint16_t g, uint16_t b) const;
+
+		std::vector<float> shaper_;
+		std::vector<float> linear_;
+		std::vector<float> table_;
+		float white_level_ = 0.0f;
+		int size_ = 0;
+	};
+
+	// hdr_to_bgra8 through cube_lut::tone
+	void hdr_to_bgra8_cube(
+		const void* src, size_t src_pitch,
+		void* dest, size_t dest_pitch,
+		int width, int height, const cube_lut& lut
+	);
+}
@@ -0,0 +1,387 @@
+#include <cstdint>
+#include <atomic>
+#include <algorithm>
+
+#include "tonemap.hpp"
+#include "kernels.hpp"
+#include "dispatch.hpp"
+#include "half_lut.hpp"
+#include "operators.hpp"
+#include "pq10.hpp"
+#include "histogram.hpp"
+#include "rotate.hpp"
+#include "tile_hash.hpp"
+#include "copy.hpp"
+#include "cube_lut.hpp"
+#include "simd.hpp"
+
+#if TONEMAP_X86
+#if defined(_MSC_VER)
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#endif
+#endif
+
+namespace tonemap
+{
+	namespace
+	{
+		std::atomic<isa> limit{ isa::avx512 };
+
+		template <tone_operator Op>
+		void hdr_to_bgra8_scalar(
+			const void* src, size_t src_pitch,
+			void* dest, size_t dest_pitch,
+			int width, int height, float white_level
+		)
+		{
+			hdr_to_bgra8(src, src_pitch, dest, dest_pitch, width, height, white_level, Op);
+		}
+
+		// avx2 and scalar kernel per operator, blend goes through select_hdr_kernel
+		const hdr_kernel operator_kernels[tone_operator_count][2] =
+		{
+			{ nullptr, nullptr },
+			{ hdr_to_bgra8_reinhard_avx2, hdr_to_bgra8_scalar<tone_operator::reinhard> },
+			{ hdr_to_bgra8_hable_avx2, hdr_to_bgra8_scalar<tone_operator::hable> },
+			{ hdr_to_bgra8_aces_avx2, hdr_to_bgra8_scalar<tone_operator::aces> },
+			{ hdr_to_bgra8_bt2390_avx2, hdr_to_bgra8_scalar<tone_operator::bt2390> },
+			{ hdr_to_bgra8_agx_avx2, hdr_to_bgra8_scalar<tone_operator::agx> },
+		};
+
+#if TONEMAP_X86
+		struct cpuid_regs
+		{
+			uint32_t eax, ebx, ecx, edx;
+		};
+
+		cpuid_regs cpuid(uint32_t leaf, uint32_t subleaf)
+		{
+			cpuid_regs regs = {};
+#if defined(_MSC_VER)
+			int out[4];
+			__cpuidex(out, static_cast<int>(leaf), static_cast<int>(subleaf));
+			regs = { static_cast<uint32_t>(out[0]), static_cast<uint32_t>(out[1]), static_cast<uint32_t>(out[2]), static_cast<uint32_t>(out[3]) };
+#else
+			__cpuid_count(leaf, subleaf, regs.eax, regs.ebx, regs.ecx, regs.edx);
+#endif
+			return regs;
+		}
+
+		uint64_t xgetbv()
+		{
+#if defined(_MSC_VER)
+			return _xgetbv(0);
+#else
+			uint32_t lo, hi;
+			__asm__ volatile("xgetbv" : "=a"(lo), "=d"(hi) : "c"(0));
+			return (static_cast<uint64_t>(hi) << 32) | lo;
+#endif
+		}
+
+		isa query_isa()
+		{
+			const uint32_t max_leaf = cpuid(0, 0).eax;
+			if (max_leaf < 1)
+				return isa::scalar;
+
+			const auto leaf1 = cpuid(1, 0);
+			const bool sse41 = leaf1.ecx & (1u << 19);
+			const bool fma = leaf1.ecx & (1u << 12);
+			const bool osxsave = leaf1.ecx & (1u << 27);
+			const bool avx = leaf1.ecx & (1u << 28);
+			const bool f16c = leaf1.ecx & (1u << 29);
+
+			if (!sse41)
+				return isa::scalar;
+
+			// the os has to save ymm (and zmm) state or the wide registers are unusable
+			if (!osxsave || !avx || max_leaf < 7)
+				return isa::sse41;
+
+			const uint64_t xcr0 = xgetbv();
+			const auto leaf7 = cpuid(7, 0);
+			const bool avx2 = leaf7.ebx & (1u << 5);
+			const bool avx512f = leaf7.ebx & (1u << 16);
+
+			if ((xcr0 & 0x6) != 0x6 || !avx2 || !fma || !f16c)
+				return isa::sse41;
+
+			if ((xcr0 & 0xe6) != 0xe6 || !avx512f)
+				return isa::avx2;
+
+			return isa::avx512;
+		}
+
+		size_t query_llc_size()
+		{
+			// deterministic cache parameters, leaf 4 on intel and 0x8000001d on amd share a layout
+			const auto vendor = cpuid(0, 0);
+			const bool amd = vendor.ebx == 0x68747541; // "Auth"enticAMD
+			const uint32_t leaf = amd ? 0x8000001d : 4;
+
+			if (amd ? cpuid(0x80000000, 0).eax < leaf : vendor.eax < leaf)
+				return 0;
+
+			size_t largest = 0;
+			for (uint32_t i = 0; i < 16; i++)
+			{
+				const auto regs = cpuid(leaf, i);
+				if ((regs.eax & 0x1f) == 0)
+					break;
+
+				const size_t ways = (regs.ebx >> 22) + 1;
+				const size_t partitions = ((regs.ebx >> 12) & 0x3ff) + 1;
+				const size_t line = (regs.ebx & 0xfff) + 1;
+				const size_t sets = static_cast<size_t>(regs.ecx) + 1;
+
+				largest = std::max(largest, ways * partitions * line * sets);
+			}
+
+			return largest;
+		}
+#else
+		isa query_isa()
+		{
+			return isa::scalar;
+		}
+
+		size_t query_llc_size()
+		{
+			return 0;
+		}
+#endif
+	}
+
+	const char* isa_name(isa value)
+	{
+		switch (value)
+		{
+		case isa::sse41:
+			return "sse4.1";
+		case isa::avx2:
+			return "avx2";
+		case isa::avx512:
+			return "avx512";
+		default:
+			return "scalar";
+		}
+	}
+
+	isa detect_isa()
+	{
+		static const isa detected = query_isa();
+		return detected;
+	}
+
+	isa active_isa()
+	{
+		return std::min(detect_isa(), limit.load(std::memory_order_relaxed));
+	}
+
+	void limit_isa(isa max)
+	{
+		limit.store(max, std::memory_order_relaxed);
+	}
+
+	size_t last_level_cache_size()
+	{
+		static const size_t size = query_llc_size();
+		return size ? size : 8 << 20;
+	}
+
+	bool should_stream(const void* dest, size_t dest_pitch, int width, int height)
+	{
+		if ((reinterpret_cast<uintptr_t>(dest) | dest_pitch) & 3)
+			return false;
+
+		return static_cast<size_t>(width) * height * 4 > last_level_cache_size();
+	}
+
+	hdr_kernel select_hdr_kernel(isa value)
+	{
+		switch (std::min(value, detect_isa()))
+		{
+		case isa::sse41:
+			return hdr_to_bgra8_sse41;
+		case isa::avx2:
+			return hdr_to_bgra8_avx2;
+		case isa::avx512:
+			return hdr_to_bgra8_avx512;
+		default:
+			return hdr_to_bgra8;
+		}
+	}
+
+	hdr_lut_kernel select_hdr_lut_kernel(isa value)
+	{
+		switch (std::min(value, detect_isa()))
+		{
+		case isa::sse41:
+			return hdr_to_bgra8_lut_sse41;
+		case isa::avx2:
+			return hdr_to_bgra8_lut_avx2;
+		case isa::avx512:
+			return hdr_to_bgra8_lut_avx512;
+		default:
+			return hdr_to_bgra8_lut;
+		}
+	}
+
+	hdr_cube_kernel select_hdr_cube_kernel(isa value)
+	{
+		if (std::min(value, detect_isa()) >= isa::avx2)
+			return hdr_to_bgra8_cube_avx2;
+
+		return hdr_to_bgra8_cube;
+	}
+
+	hdr_kernel select_operator_kernel(tone_operator op, isa value)
+	{
+		if (op == tone_operator::blend)
+			return select_hdr_kernel(value);
+
+		return operator_kernels[static_cast<int>(op)][std::min(value, detect_isa()) >= isa::avx2 ? 0 : 1];
+	}
+
+	sdr_kernel select_sdr_kernel(isa value)
+	{
+		switch (std::min(value, detect_isa()))
+		{
+		case isa::sse41:
+			return sdr_to_bgra8_sse41;
+		case isa::avx2:
+		case isa::avx512:
+			return sdr_to_bgra8_avx2;
+		default:
+			return sdr_to_bgra8;
+		}
+	}
+
+	pq10_kernel select_pq10_kernel(isa value)
+	{
+		if (std::min(value, detect_isa()) >= isa::avx2)
+			return pq10_to_bgra8_avx2;
+
+		return pq10_to_bgra8;
+	}
+
+	histogram_kernel select_histogram_kernel(isa value)
+	{
+		if (std::min(value, detect_isa()) >= isa::avx2)
+			return histogram_rows_avx2;
+
+		return histogram_rows;
+	}
+
+	rotate_kernel select_rotate_kernel(isa value)
+	{
+		switch (std::min(value, detect_isa()))
+		{
+		case isa::sse41:
+			return rotate_bgra8_sse41;
+		case isa::avx2:
+		case isa::avx512:
+			return rotate_bgra8_avx2;
+		default:
+			return rotate_bgra8;
+		}
+	}
+
+	hash_kernel select_hash_kernel(isa value)
+	{
+		switch (std::min(value, detect_isa()))
+		{
+		case isa::sse41:
+			return hash_rows_sse41;
+		case isa::avx2:
+		case isa::avx512:
+			return hash_rows_avx2;
+		default:
+			return hash_rows;
+		}
+	}
+
+	copy_kernel select_copy_kernel(isa value)
+	{
+		switch (std::min(value, detect_isa()))
+		{
+		case isa::sse41:
+			return copy_rows_sse41;
+		case isa::avx2:
+		case isa::avx512:
+			return copy_rows_avx2;
+		default:
+			return copy_rows;
+		}
+	}
+
+	void dispatch_hdr_to_bgra8(
+		const void* src, size_t src_pitch,
+		void* dest, size_t dest_pitch,
+		int width, int height, float white_level
+	)
+	{
+		select_hdr_kernel(active_isa())(src, src_pitch, dest, dest_pitch, width, height, white_level);
+	}
+
+	void dispatch_hdr_to_bgra8(
+		const void* src, size_t src_pitch,
+		void* dest, size_t dest_pitch,
+		int width, int height, float white_level, tone_operator op
+	)
+	{
+		select_operator_kernel(op, active_isa())(src, src_pitch, dest, dest_pitch, width, height, white_level);
+	}
+
+	void dispatch_hdr_to_bgra8(
+		const void* src, size_t src_pitch,
+		void* dest, size_t dest_pitch,
+		int width, int height, const half_lut& lut
+	)
+	{
+		select_hdr_lut_kernel(active_isa())(src, src_pitch, dest, dest_pitch, width, height, lut.data());
+	}
+
+	void dispatch_hdr_to_bgra8(
+		const void* src, size_t src_pitch,
+		void* dest, size_t dest_pitch,
+		int width, int height, const cube_lut& lut
+	)
+	{
+		select_hdr_cube_kernel(active_isa())(src, src_pitch, dest, dest_pitch, width, height, lut);
+	}
+
+	void dispatch_pq10_to_bgra8(
+		const void* src, size_t src_pitch,
+		void* dest, size_t dest_pitch,
+		int width, int height, float white_level, tone_operator op
+	)
+	{
+		select_pq10_kernel(active_isa())(src, src_pitch, dest, dest_pitch, width, height, white_level, op);
+	}
+
+	void dispatch_rotate_bgra8(
+		const void* src, size_t src_pitch,
+		void* dest, size_t dest_pitch,
+		int width, int height, int rotation
+	)
+	{
+		select_rotate_kernel(active_isa())(src, src_pitch, dest, dest_pitch, width, height, rotation);
+	}
+
+	uint64_t dispatch_hash_rows(const void* src, size_t pitch, size_t row_bytes, int height)
+	{
+		return select_hash_kernel(active_isa())(src, pitch, row_bytes, height);
+	}
+
+	void dispatch_sdr_to_bgra8(
+		const void* src, size_t src_pitch,
+		void* dest, size_t dest_pitch,
+		int width, int height
+	)
+	{
+		select_sdr_kernel(active_isa())(src, src_pitch, dest, dest_pitch, width, height);
+	}
+}
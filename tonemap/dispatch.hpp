@@ -0,0 +1,148 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+
+namespace tonemap
+{
+	class half_lut;
+	class cube_lut;
+	enum class tone_operator;
+	enum class input_format;
+
+	enum class isa
+	{
+		scalar,
+		sse41,
+		avx2,
+		avx512,
+	};
+
+	using hdr_kernel = void (*)(
+		const void* src, size_t src_pitch,
+		void* dest, size_t dest_pitch,
+		int width, int height, float white_level
+	);
+
+	using hdr_lut_kernel = void (*)(
+		const void* src, size_t src_pitch,
+		void* dest, size_t dest_pitch,
+		int width, int height, const float* lut
+	);
+
+	using hdr_cube_kernel = void (*)(
+		const void* src, size_t src_pitch,
+		void* dest, size_t dest_pitch,
+		int width, int height, const cube_lut& lut
+	);
+
+	using pq10_kernel = void (*)(
+		const void* src, size_t src_pitch,
+		void* dest, size_t dest_pitch,
+		int width, int height, float white_level, tone_operator op
+	);
+
+	using histogram_kernel = void (*)(
+		const void* src, size_t pitch,
+		int width, int height, input_format format, uint64_t* bins
+	);
+
+	using rotate_kernel = void (*)(
+		const void* src, size_t src_pitch,
+		void* dest, size_t dest_pitch,
+		int width, int height, int rotation
+	);
+
+	using hash_kernel = uint64_t (*)(const void* src, size_t pitch, size_t row_bytes, int height);
+
+	using copy_kernel = void (*)(const void* src, size_t src_pitch, void* dest, size_t dest_pitch, size_t row_bytes, int height);
+
+	using sdr_kernel = void (*)(
+		const void* src, size_t src_pitch,
+		void* dest, size_t dest_pitch,
+		int width, int height
+	);
+
+	const char* isa_name(isa value);
+
+	// best isa the cpu and os support, from cpuid / xgetbv, cached after the first call
+	isa detect_isa();
+
+	// isa used by the dispatched entry points, detect_isa() unless capped
+	isa active_isa();
+
+	// caps the dispatched isa, for comparing paths on one machine, clamped to detect_isa()
+	void limit_isa(isa max);
+
+	// size of the outermost cpu cache in bytes, from cpuid, 8 MiB if it can't be read
+	size_t last_level_cache_size();
+
+	// whether a kernel writing width * height pixels to dest should use streaming
+	// stores: the frame has to overflow the llc and dest needs 4 byte alignment
+	bool should_stream(const void* dest, size_t dest_pitch, int width, int height);
+
+	hdr_kernel select_hdr_kernel(isa value);
+	hdr_lut_kernel select_hdr_lut_kernel(isa value);
+	hdr_cube_kernel select_hdr_cube_kernel(isa value);
+	sdr_kernel select_sdr_kernel(isa value);
+	pq10_kernel select_pq10_kernel(isa value);
+	histogram_kernel select_histogram_kernel(isa value);
+	rotate_kernel select_rotate_kernel(isa value);
+	hash_kernel select_hash_kernel(isa value);
+	// streaming copies, copy_rows itself below sse4.1
+	copy_kernel select_copy_kernel(isa value);
+
+	// hdr_to_bgra8 through op, blend is select_hdr_kernel
+	hdr_kernel select_operator_kernel(tone_operator op, isa value);
+
+	// hdr_to_bgra8 through the fastest kernel for active_isa()
+	void dispatch_hdr_to_bgra8(
+		const void* src, size_t src_pitch,
+		void* dest, size_t dest_pitch,
+		int width, int height, float white_level
+	);
+
+	// same through op
+	void dispatch_hdr_to_bgra8(
+		const void* src, size_t src_pitch,
+		void* dest, size_t dest_pitch,
+		int width, int height, float white_level, tone_operator op
+	);
+
+	// same through hdr_to_bgra8_lut, lut has to be valid
+	void dispatch_hdr_to_bgra8(
+		const void* src, size_t src_pitch,
+		void* dest, size_t dest_pitch,
+		int width, int height, const half_lut& lut
+	);
+
+	// same through the baked cube, lut has to be valid
+	void dispatch_hdr_to_bgra8(
+		const void* src, size_t src_pitch,
+		void* dest, size_t dest_pitch,
+		int width, int height, const cube_lut& lut
+	);
+
+	// pq10_to_bgra8 through the fastest kernel for active_isa()
+	void dispatch_pq10_to_bgra8(
+		const void* src, size_t src_pitch,
+		void* dest, size_t dest_pitch,
+		int width, int height, float white_level, tone_operator op
+	);
+
+	// rotate_bgra8 through the fastest kernel for active_isa()
+	void dispatch_rotate_bgra8(
+		const void* src, size_t src_pitch,
+		void* dest, size_t dest_pitch,
+		int width, int height, int rotation
+	);
+
+	// hash_rows through the fastest kernel for active_isa()
+	uint64_t dispatch_hash_rows(const void* src, size_t pitch, size_t row_bytes, int height);
+
+	// sdr_to_bgra8 through the fastest kernel for active_isa()
+	void dispatch_sdr_to_bgra8(
+		const void* src, size_t src_pitch,
+		void* dest, size_t dest_pitch,
+		int width, int height
+	);
+}
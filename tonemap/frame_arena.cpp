@@ -0,0 +1,261 @@
+#include <new>
+#include <utility>
+#include <algorithm>
+
+#include "frame_arena.hpp"
+
+#if defined(_WIN32)
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <Windows.h>
+#else
+#include <sys/mman.h>
+#endif
+
+namespace tonemap
+{
+	namespace
+	{
+		constexpr size_t page_size = 4096;
+
+#if defined(_WIN32)
+		// large pages can only be allocated by processes holding this, which has to be
+		// granted to the user before it can be enabled here
+		bool enable_lock_memory_privilege()
+		{
+			HANDLE token;
+			if (!OpenProcessToken(GetCurrentProcess(), TOKEN_ADJUST_PRIVILEGES | TOKEN_QUERY, &token))
+				return false;
+
+			TOKEN_PRIVILEGES privileges = {};
+			privileges.PrivilegeCount = 1;
+			privileges.Privileges[0].Attributes = SE_PRIVILEGE_ENABLED;
+
+			// AdjustTokenPrivileges succeeds without the privilege, only the error tells
+			const bool enabled = LookupPrivilegeValueA(nullptr, "SeLockMemoryPrivilege", &privileges.Privileges[0].Luid)
+				&& AdjustTokenPrivileges(token, FALSE, &privileges, 0, nullptr, nullptr)
+				&& GetLastError() == ERROR_SUCCESS;
+
+			CloseHandle(token);
+			return enabled;
+		}
+
+		size_t large_page_minimum()
+		{
+			return enable_lock_memory_privilege() ? GetLargePageMinimum() : 0;
+		}
+
+		uint8_t* allocate(size_t size, bool large)
+		{
+			const DWORD type = MEM_RESERVE | MEM_COMMIT | (large ? MEM_LARGE_PAGES : 0);
+			return static_cast<uint8_t*>(VirtualAlloc(nullptr, size, type, PAGE_READWRITE));
+		}
+
+		void free_pages(uint8_t* data, size_t)
+		{
+			VirtualFree(data, 0, MEM_RELEASE);
+		}
+#else
+		size_t large_page_minimum()
+		{
+#if defined(MADV_HUGEPAGE)
+			return static_cast<size_t>(2) << 20;
+#else
+			return 0;
+#endif
+		}
+
+		uint8_t* allocate(size_t size, bool large)
+		{
+			void* data = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+			if (data == MAP_FAILED)
+				return nullptr;
+
+#if defined(MADV_HUGEPAGE)
+			if (large)
+				madvise(data, size, MADV_HUGEPAGE);
+#else
+			(void)large;
+#endif
+
+			return static_cast<uint8_t*>(data);
+		}
+
+		void free_pages(uint8_t* data, size_t size)
+		{
+			munmap(data, size);
+		}
+#endif
+	}
+
+	frame_arena::buffer::buffer(buffer&& other) noexcept
+	{
+		*this = std::move(other);
+	}
+
+	frame_arena::buffer& frame_arena::buffer::operator=(buffer&& other) noexcept
+	{
+		if (this != &other)
+		{
+			release();
+
+			arena_ = std::exchange(other.arena_, nullptr);
+			data_ = std::exchange(other.data_, nullptr);
+			size_ = std::exchange(other.size_, 0);
+			capacity_ = std::exchange(other.capacity_, 0);
+			large_ = std::exchange(other.large_, false);
+		}
+
+		return *this;
+	}
+
+	frame_arena::buffer::~buffer()
+	{
+		release();
+	}
+
+	void frame_arena::buffer::release()
+	{
+		if (arena_)
+			arena_->release({ data_, capacity_, large_ });
+
+		arena_ = nullptr;
+		data_ = nullptr;
+		size_ = 0;
+		capacity_ = 0;
+		large_ = false;
+	}
+
+	frame_arena::page_source frame_arena::system_pages()
+	{
+		return { allocate, free_pages, large_page_minimum };
+	}
+
+	frame_arena::frame_arena(size_t max_idle_bytes, page_source pages) : pages_(pages), max_idle_bytes_(max_idle_bytes)
+	{
+	}
+
+	frame_arena::~frame_arena()
+	{
+		trim();
+	}
+
+	frame_arena::buffer frame_arena::acquire(size_t size)
+	{
+		buffer result;
+		result.arena_ = this;
+		result.size_ = size;
+
+		std::unique_lock lock(mutex_);
+
+		const bool large = large_page_size_ && size >= large_page_size_;
+		const size_t capacity = round_up(size, large);
+
+		auto found = idle_.find(capacity);
+		if (found != idle_.end())
+		{
+			const block reused = found->second;
+			idle_.erase(found);
+
+			stats_.hits++;
+			stats_.bytes_idle -= reused.capacity;
+
+			result.data_ = reused.data;
+			result.capacity_ = reused.capacity;
+			result.large_ = reused.large;
+			return result;
+		}
+
+		stats_.misses++;
+		lock.unlock();
+
+		uint8_t* data = pages_.allocate(capacity, large);
+		bool on_large_pages = large;
+
+		// the system can run out of contiguous memory for large pages long after they
+		// were enabled, normal ones do then
+		if (!data && large)
+		{
+			data = pages_.allocate(capacity, false);
+			on_large_pages = false;
+		}
+
+		if (!data)
+			throw std::bad_alloc{};
+
+		lock.lock();
+		stats_.bytes_resident += capacity;
+		if (on_large_pages)
+			stats_.large_page_bytes += capacity;
+
+		result.data_ = data;
+		result.capacity_ = capacity;
+		result.large_ = on_large_pages;
+		return result;
+	}
+
+	bool frame_arena::use_large_pages(bool enable)
+	{
+		const size_t size = enable ? pages_.large_page_size() : 0;
+
+		std::lock_guard lock(mutex_);
+		large_page_size_ = size;
+
+		return !enable || size;
+	}
+
+	void frame_arena::trim()
+	{
+		std::lock_guard lock(mutex_);
+
+		for (const auto& [capacity, idle] : idle_)
+		{
+			pages_.free(idle.data, idle.capacity);
+
+			stats_.bytes_resident -= idle.capacity;
+			if (idle.large)
+				stats_.large_page_bytes -= idle.capacity;
+		}
+
+		idle_.clear();
+		stats_.bytes_idle = 0;
+	}
+
+	frame_arena::stats frame_arena::counters() const
+	{
+		std::lock_guard lock(mutex_);
+		return stats_;
+	}
+
+	void frame_arena::release(const block& released)
+	{
+		std::unique_lock lock(mutex_);
+
+		if (stats_.bytes_idle + released.capacity <= max_idle_bytes_)
+		{
+			idle_.emplace(released.capacity, released);
+			stats_.bytes_idle += released.capacity;
+			return;
+		}
+
+		stats_.bytes_resident -= released.capacity;
+		if (released.large)
+			stats_.large_page_bytes -= released.capacity;
+
+		lock.unlock();
+		pages_.free(released.data, released.capacity);
+	}
+
+	size_t frame_arena::round_up(size_t size, bool large) const
+	{
+		const size_t granularity = large ? large_page_size_ : page_size;
+		return (std::max(size, static_cast<size_t>(1)) + granularity - 1) / granularity * granularity;
+	}
+
+	frame_arena& frame_buffers()
+	{
+		// never destroyed, buffers held by other statics can be released after it would be
+		static frame_arena* arena = new frame_arena;
+		return *arena;
+	}
+}
@@ -0,0 +1,114 @@
+#pragma once
+#include <cstdint>
+#include <cstddef>
+#include <map>
+#include <mutex>
+
+namespace tonemap
+{
+	// memory for whole frames, handed out again once released instead of going back to
+	// the system: the same few desktop sized buffers are needed capture after capture.
+	// Buffers are page aligned, which covers any simd load, and not initialized, a reused
+	// one still holds what its last user left. Safe to use from several threads
+	class frame_arena
+	{
+	public:
+		struct stats
+		{
+			uint64_t hits = 0;           // served from a released buffer of the same size
+			uint64_t misses = 0;         // allocated from the system
+			size_t bytes_resident = 0;   // allocated and not freed yet, in use or idle
+			size_t bytes_idle = 0;
+			size_t large_page_bytes = 0; // the part of bytes_resident on large pages
+		};
+
+		// owns size() bytes of the arena, given back when destroyed
+		class buffer
+		{
+		public:
+			buffer() = default;
+			buffer(buffer&& other) noexcept;
+			buffer& operator=(buffer&& other) noexcept;
+			~buffer();
+
+			buffer(const buffer&) = delete;
+			buffer& operator=(const buffer&) = delete;
+
+			uint8_t* data() const
+			{
+				return data_;
+			}
+
+			size_t size() const
+			{
+				return size_;
+			}
+
+		private:
+			friend class frame_arena;
+
+			void release();
+
+			frame_arena* arena_ = nullptr;
+			uint8_t* data_ = nullptr;
+			size_t size_ = 0;
+			size_t capacity_ = 0;
+			bool large_ = false;
+		};
+
+		// where the memory comes from, the system's pages unless a test hands in its own.
+		// allocate returns null when it can't, large_page_size is 0 without large pages
+		struct page_source
+		{
+			uint8_t* (*allocate)(size_t size, bool large);
+			void (*free)(uint8_t* data, size_t size);
+			size_t (*large_page_size)();
+		};
+
+		static page_source system_pages();
+
+		// released buffers beyond max_idle_bytes go back to the system right away
+		explicit frame_arena(size_t max_idle_bytes = static_cast<size_t>(256) << 20, page_source pages = system_pages());
+
+		// every buffer has to be released before
+		~frame_arena();
+
+		frame_arena(const frame_arena&) = delete;
+		frame_arena& operator=(const frame_arena&) = delete;
+
+		// size bytes, a released buffer of the same size rounded to pages if there is one
+		buffer acquire(size_t size);
+
+		// buffers allocated from now on go on large pages where the system allows it,
+		// false if it doesn't. Windows needs SeLockMemoryPrivilege for them, elsewhere
+		// transparent huge pages are asked for and counted whether they're granted or not
+		bool use_large_pages(bool enable);
+
+		// frees every idle buffer
+		void trim();
+
+		stats counters() const;
+
+	private:
+		struct block
+		{
+			uint8_t* data;
+			size_t capacity;
+			bool large;
+		};
+
+		void release(const block& released);
+		size_t round_up(size_t size, bool large) const;
+
+		page_source pages_;
+		mutable std::mutex mutex_;
+		// idle blocks by capacity
+		std::multimap<size_t, block> idle_;
+		size_t max_idle_bytes_;
+		size_t large_page_size_ = 0; // 0 while large pages are off
+		stats stats_;
+	};
+
+	// the arena frame sized buffers of the process come from
+	frame_arena& frame_buffers();
+}
@@ -0,0 +1,34 @@
+#include "tonemap.hpp"
+#include "half_lut.hpp"
+
+namespace tonemap
+{
+	bool half_lut::update(float white_level)
+	{
+		if (valid() && white_level == white_level_)
+			return false;
+
+		table_.resize(size);
+
+		for (size_t i = 0; i < size; i++)
+			table_[i] = hdr_decode(half_to_float(static_cast<uint16_t>(i)), white_level);
+
+		white_level_ = white_level;
+		return true;
+	}
+
+	bool half_lut::valid() const
+	{
+		return table_.size() == size;
+	}
+
+	float half_lut::white_level() const
+	{
+		return white_level_;
+	}
+
+	const float* half_lut::data() const
+	{
+		return table_.data();
+	}
+}
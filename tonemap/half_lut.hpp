@@ -0,0 +1,32 @@
+#pragma once
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+
+namespace tonemap
+{
+	// hdr_decode for every R16G16B16A16_FLOAT channel value at one white level,
+	// indexed by the raw half bits. 256 KiB, fits in L2 on anything with avx2
+	class half_lut
+	{
+	public:
+		static constexpr size_t size = 65536;
+
+		// rebuilds the table only when white_level differs from the current one,
+		// returns true if it did
+		bool update(float white_level);
+
+		bool valid() const;
+		float white_level() const;
+		const float* data() const;
+
+		float operator[](uint16_t half) const
+		{
+			return table_[half];
+		}
+
+	private:
+		std::vector<float> table_;
+		float white_level_ = 0.0f;
+	};
+}
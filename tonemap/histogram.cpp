@@ -0,0 +1,155 @@
+#include <cstdint>
+#include <algorithm>
+#include <vector>
+
+#include "tonemap.hpp"
+#include "histogram.hpp"
+#include "pq10.hpp"
+#include "dispatch.hpp"
+#include "worker_pool.hpp"
+
+namespace tonemap
+{
+	namespace
+	{
+		// bit pattern of 2^min_stop shifted down to bin resolution
+		constexpr uint32_t first_bin = static_cast<uint32_t>(127 + luminance_histogram::min_stop) << 4;
+
+		// fewer rows than this per band isn't worth handing to another thread
+		constexpr int min_band_rows = 64;
+	}
+
+	int luminance_histogram::bin_of(float nits)
+	{
+		// nan and everything at or below the first edge go to bin 0
+		if (!(nits > bin_nits(0)))
+			return 0;
+
+		const uint32_t bin = (std::bit_cast<uint32_t>(nits) >> 19) - first_bin;
+		return static_cast<int>(std::min(bin, static_cast<uint32_t>(bin_count - 1)));
+	}
+
+	float luminance_histogram::bin_nits(int bin)
+	{
+		return std::bit_cast<float>((first_bin + bin) << 19);
+	}
+
+	void luminance_histogram::clear()
+	{
+		std::fill(std::begin(bins_), std::end(bins_), 0);
+	}
+
+	void luminance_histogram::merge(const luminance_histogram& other)
+	{
+		for (int i = 0; i < bin_count; i++)
+			bins_[i] += other.bins_[i];
+	}
+
+	void luminance_histogram::add_counts(const uint32_t* counts)
+	{
+		for (int i = 0; i < bin_count; i++)
+			bins_[i] += counts[i];
+	}
+
+	void luminance_histogram::add_rows(const void* src, size_t pitch, int width, int height, input_format format)
+	{
+		select_histogram_kernel(active_isa())(src, pitch, width, height, format, bins_);
+	}
+
+	uint64_t luminance_histogram::total() const
+	{
+		uint64_t sum = 0;
+		for (const auto count : bins_)
+			sum += count;
+
+		return sum;
+	}
+
+	float luminance_histogram::percentile(float p) const
+	{
+		const uint64_t count = total();
+		if (!count)
+			return 0.0f;
+
+		const double target = std::clamp(p, 0.0f, 1.0f) * static_cast<double>(count);
+		uint64_t below = 0;
+
+		for (int i = 0; i < bin_count; i++)
+		{
+			if (bins_[i] && below + bins_[i] >= target)
+			{
+				const float fraction = static_cast<float>((target - below) / bins_[i]);
+				const float low = bin_nits(i);
+				return low + (bin_nits(i + 1) - low) * fraction;
+			}
+
+			below += bins_[i];
+		}
+
+		return bin_nits(bin_count);
+	}
+
+	void histogram_rows(
+		const void* src, size_t pitch,
+		int width, int height, input_format format, uint64_t* bins
+	)
+	{
+		for (int y = 0; y < height; y++)
+		{
+			const auto* row = static_cast<const uint8_t*>(src) + pitch * y;
+
+			if (format == input_format::scrgb)
+			{
+				const auto* in = reinterpret_cast<const uint16_t*>(row);
+
+				for (int x = 0; x < width; x++, in += 4)
+				{
+					const float3 color = { half_to_float(in[0]), half_to_float(in[1]), half_to_float(in[2]) };
+					bins[luminance_histogram::bin_of(rgb_to_luma(color) * 80.0f)]++;
+				}
+			}
+			else if (format == input_format::pq10)
+			{
+				const auto* in = reinterpret_cast<const uint32_t*>(row);
+
+				for (int x = 0; x < width; x++)
+					bins[luminance_histogram::bin_of(rgb_to_luma(pq10_to_scrgb(in[x])) * 80.0f)]++;
+			}
+		}
+	}
+
+	void for_each_band(
+		int height, luminance_histogram& result,
+		const std::function<void(int first, int last, luminance_histogram& bins)>& band
+	)
+	{
+		auto& pool = workers();
+		const int bands = std::clamp(height / min_band_rows, 1, pool.size());
+		const int rows = (height + bands - 1) / bands;
+
+		std::vector<luminance_histogram> bins(bands);
+
+		pool.run(bands, [&](int i) {
+			band(std::min(i * rows, height), std::min((i + 1) * rows, height), bins[i]);
+		});
+
+		for (const auto& local : bins)
+			result.merge(local);
+	}
+
+	void histogram_frame(
+		const void* src, size_t pitch, int width, int height,
+		input_format format, luminance_histogram& result
+	)
+	{
+		for_each_band(height, result, [&](int first, int last, luminance_histogram& bins) {
+			bins.add_rows(static_cast<const uint8_t*>(src) + pitch * first, pitch, width, last - first, format);
+		});
+	}
+
+	float estimate_white_level(const luminance_histogram& histogram, float percentile)
+	{
+		const float level = histogram.percentile(percentile);
+		return level > 0.0f ? std::clamp(level, 80.0f, 480.0f) : 0.0f;
+	}
+}
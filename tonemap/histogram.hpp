@@ -0,0 +1,74 @@
+#pragma once
+#include <cstdint>
+#include <cstddef>
+#include <functional>
+
+#include "tonemap.hpp"
+
+namespace tonemap
+{
+	// luminance of hdr frames in nits, binned on a log2 scale straight from the float bits:
+	// the exponent and the top 4 mantissa bits make 16 bins per stop from 1/16 to 16384 nits.
+	// Anything darker lands in the first bin, anything brighter in the last
+	class luminance_histogram
+	{
+	public:
+		static constexpr int bins_per_stop = 16;
+		static constexpr int min_stop = -4;
+		static constexpr int stops = 18;
+		static constexpr int bin_count = bins_per_stop * stops;
+
+		static int bin_of(float nits);
+
+		// lower edge of a bin in nits
+		static float bin_nits(int bin);
+
+		void clear();
+		void merge(const luminance_histogram& other);
+
+		// bin_count counters binned elsewhere, like the histogram pass of tonemapper.hlsl
+		void add_counts(const uint32_t* counts);
+
+		// scrgb or pq10 rows, pitch in bytes, sdr frames are ignored
+		void add_rows(const void* src, size_t pitch, int width, int height, input_format format);
+
+		uint64_t total() const;
+		uint64_t operator[](int bin) const
+		{
+			return bins_[bin];
+		}
+
+		// nits below which a fraction p of the pixels lie, interpolated inside the bin.
+		// 0 for an empty histogram
+		float percentile(float p) const;
+
+	private:
+		uint64_t bins_[bin_count] = {};
+	};
+
+	// adds the luminance of scrgb or pq10 rows to bins, luminance_histogram::bin_count of them
+	void histogram_rows(
+		const void* src, size_t pitch,
+		int width, int height, input_format format, uint64_t* bins
+	);
+
+	// splits rows [0, height) into one band per thread of workers() and runs
+	// band(first, last, bins) on each, the calling thread taking some too. Every band
+	// fills its own histogram, merged into result once all have finished
+	void for_each_band(
+		int height, luminance_histogram& result,
+		const std::function<void(int first, int last, luminance_histogram& bins)>& band
+	);
+
+	// add_rows over the whole frame through for_each_band
+	void histogram_frame(
+		const void* src, size_t pitch, int width, int height,
+		input_format format, luminance_histogram& result
+	);
+
+	// sdr white level guess from a frame: the given luminance percentile, clamped to
+	// the 80 - 480 nit range windows offers for the sdr content brightness slider.
+	// Desktop content is mostly sdr white and below so a high percentile lands on it,
+	// 0 if the histogram is empty
+	float estimate_white_level(const luminance_histogram& histogram, float percentile = 0.98f);
+}
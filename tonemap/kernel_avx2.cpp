@@ -0,0 +1,1282 @@
+#include <cstdint>
+#include <cstring>
+#include <algorithm>
+
+#include "tonemap.hpp"
+#include "kernels.hpp"
+#include "operators.hpp"
+#include "simd.hpp"
+#include "dispatch.hpp"
+#include "pq10.hpp"
+#include "histogram.hpp"
+#include "rotate.hpp"
+#include "tile_hash.hpp"
+#include "copy.hpp"
+#include "cube_lut.hpp"
+
+#if TONEMAP_X86
+
+#define AVX2 TONEMAP_TARGET("avx2,fma,f16c")
+
+namespace tonemap
+{
+	namespace
+	{
+		struct rgb_x8
+		{
+			__m256 r, g, b;
+		};
+
+		AVX2 __m256 rcp(__m256 x)
+		{
+			// one newton step takes rcpps from 12 to ~23 bits
+			const __m256 r = _mm256_rcp_ps(x);
+			return _mm256_mul_ps(r, _mm256_fnmadd_ps(x, r, _mm256_set1_ps(2.0f)));
+		}
+
+		AVX2 __m256 log2(__m256 x)
+		{
+			const __m256i bits = _mm256_castps_si256(x);
+			__m256i e = _mm256_sub_epi32(_mm256_srli_epi32(bits, 23), _mm256_set1_epi32(127));
+			__m256 m = _mm256_castsi256_ps(_mm256_or_si256(
+				_mm256_and_si256(bits, _mm256_set1_epi32(0x007fffff)),
+				_mm256_set1_epi32(0x3f800000)
+			));
+
+			// fold the mantissa into [0.75, 1.5), the mask is -1 so subtracting it bumps e
+			const __m256 fold = _mm256_cmp_ps(m, _mm256_set1_ps(1.5f), _CMP_GE_OQ);
+			m = _mm256_blendv_ps(m, _mm256_mul_ps(m, _mm256_set1_ps(0.5f)), fold);
+			e = _mm256_sub_epi32(e, _mm256_castps_si256(fold));
+
+			const __m256 t = _mm256_sub_ps(m, _mm256_set1_ps(1.0f));
+
+			__m256 p = _mm256_set1_ps(poly::log2_c[5]);
+			p = _mm256_fmadd_ps(p, t, _mm256_set1_ps(poly::log2_c[4]));
+			p = _mm256_fmadd_ps(p, t, _mm256_set1_ps(poly::log2_c[3]));
+			p = _mm256_fmadd_ps(p, t, _mm256_set1_ps(poly::log2_c[2]));
+			p = _mm256_fmadd_ps(p, t, _mm256_set1_ps(poly::log2_c[1]));
+			p = _mm256_fmadd_ps(p, t, _mm256_set1_ps(poly::log2_c[0]));
+
+			return _mm256_fmadd_ps(p, t, _mm256_cvtepi32_ps(e));
+		}
+
+		AVX2 __m256 exp2(__m256 y)
+		{
+			const __m256 i = _mm256_floor_ps(y);
+			const __m256 f = _mm256_sub_ps(y, i);
+
+			__m256 p = _mm256_set1_ps(poly::exp2_c[4]);
+			p = _mm256_fmadd_ps(p, f, _mm256_set1_ps(poly::exp2_c[3]));
+			p = _mm256_fmadd_ps(p, f, _mm256_set1_ps(poly::exp2_c[2]));
+			p = _mm256_fmadd_ps(p, f, _mm256_set1_ps(poly::exp2_c[1]));
+			p = _mm256_fmadd_ps(p, f, _mm256_set1_ps(poly::exp2_c[0]));
+
+			const __m256i scale = _mm256_slli_epi32(
+				_mm256_add_epi32(_mm256_cvtps_epi32(i), _mm256_set1_epi32(127)), 23
+			);
+
+			return _mm256_mul_ps(p, _mm256_castsi256_ps(scale));
+		}
+
+		AVX2 __m256 encode(__m256 x)
+		{
+			const __m256 curve = _mm256_fmsub_ps(
+				_mm256_set1_ps(1.055f),
+				exp2(_mm256_mul_ps(log2(x), _mm256_set1_ps(1.0f / 2.4f))),
+				_mm256_set1_ps(0.055f)
+			);
+			const __m256 toe = _mm256_mul_ps(x, _mm256_set1_ps(12.92f));
+
+			return _mm256_blendv_ps(toe, curve, _mm256_cmp_ps(x, _mm256_set1_ps(0.00313066844250063f), _CMP_GT_OQ));
+		}
+
+		AVX2 __m256 linear(__m256 x)
+		{
+			// (x - 0.8) / 2.5 + 0.8
+			const __m256 knee = _mm256_fmadd_ps(x, _mm256_set1_ps(0.4f), _mm256_set1_ps(0.48f));
+			return _mm256_blendv_ps(x, knee, _mm256_cmp_ps(x, _mm256_set1_ps(0.8f), _CMP_GE_OQ));
+		}
+
+		AVX2 __m256 luma(const rgb_x8& c)
+		{
+			__m256 l = _mm256_mul_ps(c.r, _mm256_set1_ps(0.213f));
+			l = _mm256_fmadd_ps(c.g, _mm256_set1_ps(0.715f), l);
+			return _mm256_fmadd_ps(c.b, _mm256_set1_ps(0.072f), l);
+		}
+
+		AVX2 __m256 desaturate(__m256 v, __m256 scale, __m256 new_peak, __m256 g)
+		{
+			v = _mm256_mul_ps(v, scale);
+			return _mm256_fmadd_ps(g, _mm256_sub_ps(new_peak, v), v);
+		}
+
+		AVX2 rgb_x8 neutral(rgb_x8 c)
+		{
+			const __m256 start_compression = _mm256_set1_ps(0.8f - 0.04f);
+			const __m256 d = _mm256_set1_ps(1.0f - (0.8f - 0.04f));
+
+			const __m256 x = _mm256_min_ps(c.r, _mm256_min_ps(c.g, c.b));
+			const __m256 offset = _mm256_blendv_ps(
+				_mm256_set1_ps(0.04f),
+				_mm256_fnmadd_ps(_mm256_mul_ps(x, x), _mm256_set1_ps(6.25f), x),
+				_mm256_cmp_ps(x, _mm256_set1_ps(0.08f), _CMP_LT_OQ)
+			);
+
+			c.r = _mm256_sub_ps(c.r, offset);
+			c.g = _mm256_sub_ps(c.g, offset);
+			c.b = _mm256_sub_ps(c.b, offset);
+
+			const __m256 peak = _mm256_max_ps(c.r, _mm256_max_ps(c.g, c.b));
+			const __m256 compress = _mm256_cmp_ps(peak, start_compression, _CMP_GE_OQ);
+
+			if (_mm256_testz_ps(compress, compress))
+				return c;
+
+			// lanes below start_compression may produce inf / nan here, they are blended away
+			const __m256 new_peak = _mm256_fnmadd_ps(
+				_mm256_mul_ps(d, d),
+				rcp(_mm256_sub_ps(_mm256_add_ps(peak, d), start_compression)),
+				_mm256_set1_ps(1.0f)
+			);
+			const __m256 scale = _mm256_mul_ps(new_peak, rcp(peak));
+			const __m256 g = _mm256_sub_ps(
+				_mm256_set1_ps(1.0f),
+				rcp(_mm256_fmadd_ps(_mm256_set1_ps(0.15f), _mm256_sub_ps(peak, new_peak), _mm256_set1_ps(1.0f)))
+			);
+
+			return {
+				_mm256_blendv_ps(c.r, desaturate(c.r, scale, new_peak, g), compress),
+				_mm256_blendv_ps(c.g, desaturate(c.g, scale, new_peak, g), compress),
+				_mm256_blendv_ps(c.b, desaturate(c.b, scale, new_peak, g), compress),
+			};
+		}
+
+		AVX2 rgb_x8 decode(rgb_x8 c, __m256 inv_scale)
+		{
+			const __m256 zero = _mm256_setzero_ps();
+			const __m256 max_nits = _mm256_set1_ps(10000.0f);
+
+			c.r = encode(_mm256_mul_ps(_mm256_min_ps(_mm256_max_ps(c.r, zero), max_nits), inv_scale));
+			c.g = encode(_mm256_mul_ps(_mm256_min_ps(_mm256_max_ps(c.g, zero), max_nits), inv_scale));
+			c.b = encode(_mm256_mul_ps(_mm256_min_ps(_mm256_max_ps(c.b, zero), max_nits), inv_scale));
+
+			return c;
+		}
+
+		AVX2 rgb_x8 tone(const rgb_x8& c)
+		{
+			const rgb_x8 linear_result = { linear(c.r), linear(c.g), linear(c.b) };
+			const __m256 linear_luma = luma(linear_result);
+			const __m256 blend = _mm256_cmp_ps(linear_luma, _mm256_set1_ps(0.8f), _CMP_GE_OQ);
+
+			if (_mm256_testz_ps(blend, blend))
+				return linear_result;
+
+			const rgb_x8 neutral_result = neutral(c);
+			const __m256 scale = _mm256_mul_ps(linear_luma, rcp(luma(neutral_result)));
+
+			return {
+				_mm256_blendv_ps(linear_result.r, _mm256_mul_ps(neutral_result.r, scale), blend),
+				_mm256_blendv_ps(linear_result.g, _mm256_mul_ps(neutral_result.g, scale), blend),
+				_mm256_blendv_ps(linear_result.b, _mm256_mul_ps(neutral_result.b, scale), blend),
+			};
+		}
+
+		AVX2 rgb_x8 load(const uint16_t* in)
+		{
+			const __m256 p01 = _mm256_cvtph_ps(_mm_loadu_si128(reinterpret_cast<const __m128i*>(in)));
+			const __m256 p23 = _mm256_cvtph_ps(_mm_loadu_si128(reinterpret_cast<const __m128i*>(in + 8)));
+			const __m256 p45 = _mm256_cvtph_ps(_mm_loadu_si128(reinterpret_cast<const __m128i*>(in + 16)));
+			const __m256 p67 = _mm256_cvtph_ps(_mm_loadu_si128(reinterpret_cast<const __m128i*>(in + 24)));
+
+			// pixel n in the low lane, n + 4 in the high lane, then a 4x4 transpose per lane
+			const __m256 p04 = _mm256_permute2f128_ps(p01, p45, 0x20);
+			const __m256 p15 = _mm256_permute2f128_ps(p01, p45, 0x31);
+			const __m256 p26 = _mm256_permute2f128_ps(p23, p67, 0x20);
+			const __m256 p37 = _mm256_permute2f128_ps(p23, p67, 0x31);
+
+			const __m256 rg01 = _mm256_unpacklo_ps(p04, p15);
+			const __m256 rg23 = _mm256_unpacklo_ps(p26, p37);
+			const __m256 ba01 = _mm256_unpackhi_ps(p04, p15);
+			const __m256 ba23 = _mm256_unpackhi_ps(p26, p37);
+
+			return {
+				_mm256_shuffle_ps(rg01, rg23, _MM_SHUFFLE(1, 0, 1, 0)),
+				_mm256_shuffle_ps(rg01, rg23, _MM_SHUFFLE(3, 2, 3, 2)),
+				_mm256_shuffle_ps(ba01, ba23, _MM_SHUFFLE(1, 0, 1, 0)),
+			};
+		}
+
+		AVX2 rgb_x8 lookup(const uint16_t* in, const float* lut)
+		{
+			// a pixel is the dword pair rg, ba; gather the pairs, then split the halves out as indices
+			const __m256i pairs = _mm256_setr_epi32(0, 2, 4, 6, 1, 3, 5, 7);
+			const __m256i p0123 = _mm256_permutevar8x32_epi32(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(in)), pairs);
+			const __m256i p4567 = _mm256_permutevar8x32_epi32(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(in + 16)), pairs);
+
+			const __m256i rg = _mm256_permute2x128_si256(p0123, p4567, 0x20);
+			const __m256i ba = _mm256_permute2x128_si256(p0123, p4567, 0x31);
+			const __m256i low = _mm256_set1_epi32(0xffff);
+
+			return {
+				_mm256_i32gather_ps(lut, _mm256_and_si256(rg, low), 4),
+				_mm256_i32gather_ps(lut, _mm256_srli_epi32(rg, 16), 4),
+				_mm256_i32gather_ps(lut, _mm256_and_si256(ba, low), 4),
+			};
+		}
+
+		// rgb_to_luma rounded the same way, so the blend edge lands on the same pixels
+		AVX2 __m256 luma_unfused(const rgb_x8& c)
+		{
+			const __m256 rg = _mm256_add_ps(_mm256_mul_ps(c.r, _mm256_set1_ps(0.213f)), _mm256_mul_ps(c.g, _mm256_set1_ps(0.715f)));
+			return _mm256_add_ps(rg, _mm256_mul_ps(c.b, _mm256_set1_ps(0.072f)));
+		}
+
+		AVX2 __m256 corner(const float* table, __m256i index)
+		{
+			return _mm256_i32gather_ps(table, index, 4);
+		}
+
+		// cube_lut::chroma for 8 pixels, coord holds grid coordinates from the shaper
+		AVX2 rgb_x8 tetrahedral(const rgb_x8& coord, const float* table, int size)
+		{
+			const __m256 top = _mm256_set1_ps(static_cast<float>(size - 2));
+			const __m256 br = _mm256_min_ps(_mm256_floor_ps(coord.r), top);
+			const __m256 bg = _mm256_min_ps(_mm256_floor_ps(coord.g), top);
+			const __m256 bb = _mm256_min_ps(_mm256_floor_ps(coord.b), top);
+
+			const __m256 fr = _mm256_sub_ps(coord.r, br);
+			const __m256 fg = _mm256_sub_ps(coord.g, bg);
+			const __m256 fb = _mm256_sub_ps(coord.b, bb);
+
+			// grid offsets stay well inside float's exact integer range
+			const __m256 stride_r = _mm256_set1_ps(1.0f);
+			const __m256 stride_g = _mm256_set1_ps(static_cast<float>(size));
+			const __m256 stride_b = _mm256_set1_ps(static_cast<float>(size * size));
+			const __m256 stride_all = _mm256_add_ps(stride_r, _mm256_add_ps(stride_g, stride_b));
+
+			const __m256 r_max = _mm256_and_ps(_mm256_cmp_ps(fr, fg, _CMP_GE_OQ), _mm256_cmp_ps(fr, fb, _CMP_GE_OQ));
+			const __m256 g_max = _mm256_andnot_ps(r_max, _mm256_cmp_ps(fg, fb, _CMP_GE_OQ));
+			const __m256 b_min = _mm256_and_ps(_mm256_cmp_ps(fb, fr, _CMP_LE_OQ), _mm256_cmp_ps(fb, fg, _CMP_LE_OQ));
+			const __m256 g_min = _mm256_andnot_ps(b_min, _mm256_cmp_ps(fg, fr, _CMP_LE_OQ));
+
+			const __m256 first = _mm256_blendv_ps(_mm256_blendv_ps(stride_b, stride_g, g_max), stride_r, r_max);
+			const __m256 second = _mm256_sub_ps(
+				stride_all, _mm256_blendv_ps(_mm256_blendv_ps(stride_r, stride_g, g_min), stride_b, b_min)
+			);
+
+			const __m256 s0 = _mm256_max_ps(fr, _mm256_max_ps(fg, fb));
+			const __m256 s1 = _mm256_max_ps(_mm256_min_ps(fr, fg), _mm256_min_ps(_mm256_max_ps(fr, fg), fb));
+			const __m256 s2 = _mm256_min_ps(fr, _mm256_min_ps(fg, fb));
+
+			const __m256 base = _mm256_fmadd_ps(_mm256_fmadd_ps(bb, stride_g, bg), stride_g, br);
+			const __m256 four = _mm256_set1_ps(4.0f);
+			const __m256i i0 = _mm256_cvttps_epi32(_mm256_mul_ps(base, four));
+			const __m256i i1 = _mm256_cvttps_epi32(_mm256_mul_ps(_mm256_add_ps(base, first), four));
+			const __m256i i2 = _mm256_cvttps_epi32(_mm256_mul_ps(_mm256_add_ps(base, second), four));
+			const __m256i i3 = _mm256_cvttps_epi32(_mm256_mul_ps(_mm256_add_ps(base, stride_all), four));
+
+			__m256 out[3];
+			for (int ch = 0; ch < 3; ch++)
+			{
+				const __m256 c0 = corner(table + ch, i0);
+				const __m256 c1 = corner(table + ch, i1);
+				const __m256 c2 = corner(table + ch, i2);
+				const __m256 c3 = corner(table + ch, i3);
+
+				out[ch] = _mm256_fmadd_ps(s0, _mm256_sub_ps(c1, c0), c0);
+				out[ch] = _mm256_fmadd_ps(s1, _mm256_sub_ps(c2, c1), out[ch]);
+				out[ch] = _mm256_fmadd_ps(s2, _mm256_sub_ps(c3, c2), out[ch]);
+			}
+
+			return { out[0], out[1], out[2] };
+		}
+
+		AVX2 __m256i quantize(__m256 x)
+		{
+			// same saturate(x) * 255 + 0.5 truncation as to_unorm8, max first so nan becomes 0
+			x = _mm256_min_ps(_mm256_max_ps(x, _mm256_setzero_ps()), _mm256_set1_ps(1.0f));
+			return _mm256_cvttps_epi32(_mm256_add_ps(_mm256_mul_ps(x, _mm256_set1_ps(255.0f)), _mm256_set1_ps(0.5f)));
+		}
+
+		AVX2 __m256i pack(const rgb_x8& c)
+		{
+			__m256i px = _mm256_or_si256(quantize(c.b), _mm256_set1_epi32(static_cast<int>(0xff000000)));
+			px = _mm256_or_si256(px, _mm256_slli_epi32(quantize(c.g), 8));
+			return _mm256_or_si256(px, _mm256_slli_epi32(quantize(c.r), 16));
+		}
+
+		struct lut_pixels
+		{
+			using input = uint16_t;
+
+			const float* lut;
+
+			AVX2 __m256i operator()(const uint16_t* in) const
+			{
+				return pack(tone(lookup(in, lut)));
+			}
+		};
+
+		// cube_lut::tone, the grid is only read when a lane is past the blend edge
+		struct cube_pixels
+		{
+			using input = uint16_t;
+
+			const float* shaper;
+			const float* linear;
+			const float* table;
+			int size;
+
+			AVX2 __m256i operator()(const uint16_t* in) const
+			{
+				const rgb_x8 linear_result = lookup(in, linear);
+				const __m256 linear_luma = luma_unfused(linear_result);
+				const __m256 blend = _mm256_cmp_ps(linear_luma, _mm256_set1_ps(0.8f), _CMP_GE_OQ);
+
+				if (_mm256_testz_ps(blend, blend))
+					return pack(linear_result);
+
+				const rgb_x8 chroma = tetrahedral(lookup(in, shaper), table, size);
+
+				return pack({
+					_mm256_blendv_ps(linear_result.r, _mm256_mul_ps(chroma.r, linear_luma), blend),
+					_mm256_blendv_ps(linear_result.g, _mm256_mul_ps(chroma.g, linear_luma), blend),
+					_mm256_blendv_ps(linear_result.b, _mm256_mul_ps(chroma.b, linear_luma), blend),
+				});
+			}
+		};
+
+		// rgba to bgra with alpha forced to 1, the shader's sdr permutation
+		struct swizzle_pixels
+		{
+			using input = uint8_t;
+
+			AVX2 __m256i operator()(const uint8_t* in) const
+			{
+				const __m256i order = _mm256_setr_epi8(
+					2, 1, 0, 3, 6, 5, 4, 7, 10, 9, 8, 11, 14, 13, 12, 15,
+					2, 1, 0, 3, 6, 5, 4, 7, 10, 9, 8, 11, 14, 13, 12, 15
+				);
+
+				const __m256i px = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(in));
+				return _mm256_or_si256(_mm256_shuffle_epi8(px, order), _mm256_set1_epi32(static_cast<int>(0xff000000)));
+			}
+		};
+
+		// hdr_linear, the decode without the gamma
+		AVX2 rgb_x8 linearize(rgb_x8 c, __m256 inv_scale)
+		{
+			const __m256 zero = _mm256_setzero_ps();
+			const __m256 max_nits = _mm256_set1_ps(10000.0f);
+
+			c.r = _mm256_mul_ps(_mm256_min_ps(_mm256_max_ps(c.r, zero), max_nits), inv_scale);
+			c.g = _mm256_mul_ps(_mm256_min_ps(_mm256_max_ps(c.g, zero), max_nits), inv_scale);
+			c.b = _mm256_mul_ps(_mm256_min_ps(_mm256_max_ps(c.b, zero), max_nits), inv_scale);
+
+			return c;
+		}
+
+		AVX2 rgb_x8 encode(const rgb_x8& c)
+		{
+			return { encode(c.r), encode(c.g), encode(c.b) };
+		}
+
+		AVX2 rgb_x8 scale(const rgb_x8& c, __m256 s)
+		{
+			return { _mm256_mul_ps(c.r, s), _mm256_mul_ps(c.g, s), _mm256_mul_ps(c.b, s) };
+		}
+
+		AVX2 __m256 saturate(__m256 x)
+		{
+			return _mm256_min_ps(_mm256_max_ps(x, _mm256_setzero_ps()), _mm256_set1_ps(1.0f));
+		}
+
+		AVX2 __m256 row(const float (&m)[3], const rgb_x8& c)
+		{
+			__m256 v = _mm256_mul_ps(c.r, _mm256_set1_ps(m[0]));
+			v = _mm256_fmadd_ps(c.g, _mm256_set1_ps(m[1]), v);
+			return _mm256_fmadd_ps(c.b, _mm256_set1_ps(m[2]), v);
+		}
+
+		AVX2 rgb_x8 transform(const float (&m)[3][3], const rgb_x8& c)
+		{
+			return { row(m[0], c), row(m[1], c), row(m[2], c) };
+		}
+
+		// x^y for x >= 0 through log2 / exp2, exponent clamped so 0 comes out as ~0 instead of garbage
+		AVX2 __m256 pow(__m256 x, float y)
+		{
+			return exp2(_mm256_max_ps(_mm256_mul_ps(log2(x), _mm256_set1_ps(y)), _mm256_set1_ps(-126.0f)));
+		}
+
+		AVX2 __m256 pq_encode(__m256 y)
+		{
+			using namespace curves;
+
+			const __m256 p = pow(y, pq_m1);
+			const __m256 num = _mm256_fmadd_ps(p, _mm256_set1_ps(pq_c2), _mm256_set1_ps(pq_c1));
+			const __m256 den = _mm256_fmadd_ps(p, _mm256_set1_ps(pq_c3), _mm256_set1_ps(1.0f));
+
+			return pow(_mm256_mul_ps(num, rcp(den)), pq_m2);
+		}
+
+		AVX2 __m256 pq_decode(__m256 e)
+		{
+			using namespace curves;
+
+			const __m256 p = pow(e, 1.0f / pq_m2);
+			const __m256 num = _mm256_max_ps(_mm256_sub_ps(p, _mm256_set1_ps(pq_c1)), _mm256_setzero_ps());
+			const __m256 den = _mm256_fnmadd_ps(p, _mm256_set1_ps(pq_c3), _mm256_set1_ps(pq_c2));
+
+			return pow(_mm256_mul_ps(num, rcp(den)), 1.0f / pq_m1);
+		}
+
+		AVX2 __m256 hable_curve(__m256 x)
+		{
+			const auto [a, b, c, d, e, f] = curves::hable_abcdef;
+
+			const __m256 va = _mm256_set1_ps(a);
+			const __m256 num = _mm256_fmadd_ps(x, _mm256_fmadd_ps(va, x, _mm256_set1_ps(c * b)), _mm256_set1_ps(d * e));
+			const __m256 den = _mm256_fmadd_ps(x, _mm256_fmadd_ps(va, x, _mm256_set1_ps(b)), _mm256_set1_ps(d * f));
+
+			return _mm256_fmsub_ps(num, rcp(den), _mm256_set1_ps(e / f));
+		}
+
+		AVX2 __m256 rrt_odt_fit(__m256 v)
+		{
+			const __m256 a = _mm256_fmsub_ps(v, _mm256_add_ps(v, _mm256_set1_ps(0.0245786f)), _mm256_set1_ps(0.000090537f));
+			const __m256 b = _mm256_fmadd_ps(v, _mm256_fmadd_ps(_mm256_set1_ps(0.983729f), v, _mm256_set1_ps(0.4329510f)), _mm256_set1_ps(0.238081f));
+
+			return _mm256_mul_ps(a, rcp(b));
+		}
+
+		AVX2 __m256 agx_encode(__m256 v)
+		{
+			using namespace curves;
+
+			__m256 ev = log2(_mm256_max_ps(v, _mm256_set1_ps(1e-10f)));
+			ev = _mm256_min_ps(_mm256_max_ps(ev, _mm256_set1_ps(agx_min_ev)), _mm256_set1_ps(agx_max_ev));
+
+			const __m256 x = _mm256_mul_ps(_mm256_sub_ps(ev, _mm256_set1_ps(agx_min_ev)), _mm256_set1_ps(1.0f / (agx_max_ev - agx_min_ev)));
+
+			__m256 p = _mm256_set1_ps(agx_contrast[0]);
+			for (int i = 1; i < 7; i++)
+				p = _mm256_fmadd_ps(p, x, _mm256_set1_ps(agx_contrast[i]));
+
+			return p;
+		}
+
+		// where the operators below read their pixels from, 8 at a time as scRGB
+		struct half_source
+		{
+			using input = uint16_t;
+
+			AVX2 rgb_x8 operator()(const uint16_t* in) const
+			{
+				return load(in);
+			}
+		};
+
+		// R10G10B10A2 through the eotf table, then from bt.2020 to bt.709 primaries
+		struct pq10_source
+		{
+			using input = uint8_t;
+
+			const float* eotf;
+
+			AVX2 rgb_x8 operator()(const uint8_t* in) const
+			{
+				const __m256i px = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(in));
+				const __m256i mask = _mm256_set1_epi32(0x3ff);
+
+				const rgb_x8 c = {
+					_mm256_i32gather_ps(eotf, _mm256_and_si256(px, mask), 4),
+					_mm256_i32gather_ps(eotf, _mm256_and_si256(_mm256_srli_epi32(px, 10), mask), 4),
+					_mm256_i32gather_ps(eotf, _mm256_and_si256(_mm256_srli_epi32(px, 20), mask), 4),
+				};
+
+				return transform(curves::bt2020_to_bt709, c);
+			}
+		};
+
+		template <typename Source>
+		struct direct_pixels
+		{
+			using input = typename Source::input;
+
+			Source source;
+			__m256 inv_scale;
+
+			AVX2 __m256i operator()(const input* in) const
+			{
+				return pack(tone(decode(source(in), inv_scale)));
+			}
+		};
+
+		template <typename Source>
+		struct reinhard_pixels
+		{
+			using input = typename Source::input;
+
+			Source source;
+
+			__m256 inv_scale;
+			__m256 inv_white_sq;
+
+			AVX2 __m256i operator()(const input* in) const
+			{
+				const rgb_x8 x = linearize(source(in), inv_scale);
+				const __m256 l = luma(x);
+				const __m256 ratio = _mm256_mul_ps(
+					_mm256_fmadd_ps(l, inv_white_sq, _mm256_set1_ps(1.0f)),
+					rcp(_mm256_add_ps(l, _mm256_set1_ps(1.0f)))
+				);
+
+				return pack(encode(scale(x, ratio)));
+			}
+		};
+
+		template <typename Source>
+		struct hable_pixels
+		{
+			using input = typename Source::input;
+
+			Source source;
+
+			__m256 inv_scale;
+			__m256 inv_white;
+
+			AVX2 __m256i operator()(const input* in) const
+			{
+				const rgb_x8 x = scale(linearize(source(in), inv_scale), _mm256_set1_ps(curves::hable_exposure_bias));
+
+				return pack(encode({
+					_mm256_mul_ps(hable_curve(x.r), inv_white),
+					_mm256_mul_ps(hable_curve(x.g), inv_white),
+					_mm256_mul_ps(hable_curve(x.b), inv_white),
+				}));
+			}
+		};
+
+		template <typename Source>
+		struct aces_pixels
+		{
+			using input = typename Source::input;
+
+			Source source;
+
+			__m256 inv_scale;
+
+			AVX2 __m256i operator()(const input* in) const
+			{
+				rgb_x8 c = transform(curves::aces_input, linearize(source(in), inv_scale));
+				c = transform(curves::aces_output, { rrt_odt_fit(c.r), rrt_odt_fit(c.g), rrt_odt_fit(c.b) });
+
+				return pack(encode({ saturate(c.r), saturate(c.g), saturate(c.b) }));
+			}
+		};
+
+		template <typename Source>
+		struct bt2390_pixels
+		{
+			using input = typename Source::input;
+
+			Source source;
+
+			__m256 inv_scale;
+			__m256 to_signal; // white_level / 10000, relative to pq's 0 - 1
+			__m256 max_lum;
+			__m256 knee;
+
+			AVX2 __m256i operator()(const input* in) const
+			{
+				const rgb_x8 x = linearize(source(in), inv_scale);
+				const __m256 peak = _mm256_max_ps(x.r, _mm256_max_ps(x.g, x.b));
+				const __m256 e1 = pq_encode(_mm256_mul_ps(peak, to_signal));
+				const __m256 compress = _mm256_cmp_ps(e1, knee, _CMP_GT_OQ);
+
+				if (_mm256_testz_ps(compress, compress))
+					return pack(encode(x));
+
+				const __m256 one = _mm256_set1_ps(1.0f);
+				const __m256 t = _mm256_mul_ps(_mm256_sub_ps(e1, knee), rcp(_mm256_sub_ps(one, knee)));
+				const __m256 t2 = _mm256_mul_ps(t, t);
+				const __m256 t3 = _mm256_mul_ps(t2, t);
+
+				// hermite basis: 2t^3 - 3t^2 + 1, t^3 - 2t^2 + t, -2t^3 + 3t^2
+				const __m256 h01 = _mm256_fmsub_ps(_mm256_set1_ps(3.0f), t2, _mm256_add_ps(t3, t3));
+				const __m256 h00 = _mm256_sub_ps(one, h01);
+				const __m256 h10 = _mm256_add_ps(_mm256_fnmadd_ps(_mm256_set1_ps(2.0f), t2, t3), t);
+
+				__m256 e2 = _mm256_mul_ps(h00, knee);
+				e2 = _mm256_fmadd_ps(h10, _mm256_sub_ps(one, knee), e2);
+				e2 = _mm256_fmadd_ps(h01, max_lum, e2);
+
+				// lanes that aren't compressed may divide by a zero peak here, they are blended away
+				const __m256 ratio = _mm256_mul_ps(pq_decode(e2), rcp(_mm256_mul_ps(peak, to_signal)));
+
+				return pack(encode(scale(x, _mm256_blendv_ps(one, ratio, compress))));
+			}
+		};
+
+		template <typename Source>
+		struct agx_pixels
+		{
+			using input = typename Source::input;
+
+			Source source;
+
+			__m256 inv_scale;
+
+			AVX2 __m256i operator()(const input* in) const
+			{
+				const rgb_x8 c = transform(curves::agx_inset, linearize(source(in), inv_scale));
+				return pack(transform(curves::agx_outset, { agx_encode(c.r), agx_encode(c.g), agx_encode(c.b) }));
+			}
+		};
+
+		// fewer than 8 pixels through a padded copy so they get the same math as the rest of the row
+		template <typename Pixels>
+		AVX2 void convert_partial(const typename Pixels::input* in, uint8_t* out, int count, const Pixels& pixels)
+		{
+			typename Pixels::input in_part[8 * 4] = {};
+			uint8_t out_part[8 * 4];
+
+			std::memcpy(in_part, in, count * 4 * sizeof(*in));
+			_mm256_storeu_si256(reinterpret_cast<__m256i*>(out_part), pixels(in_part));
+			std::memcpy(out, out_part, count * 4);
+		}
+
+		// one pass per row: f16c decode, tonemap and pack in registers, then a single store.
+		// Pixels::input is the channel type, 4 channels per pixel
+		// Frames that don't fit in the llc are written with streaming stores so the output
+		// doesn't evict the input still being read, after peeling pixels up to 32 byte alignment
+		template <typename Pixels>
+		AVX2 void convert_rows(
+			const void* src, size_t src_pitch,
+			void* dest, size_t dest_pitch,
+			int width, int height, const Pixels& pixels
+		)
+		{
+			const bool stream = should_stream(dest, dest_pitch, width, height);
+
+			for (int y = 0; y < height; y++)
+			{
+				const auto* in = reinterpret_cast<const typename Pixels::input*>(static_cast<const uint8_t*>(src) + src_pitch * y);
+				auto* out = static_cast<uint8_t*>(dest) + dest_pitch * y;
+				int x = 0;
+
+				if (stream)
+				{
+					const auto misalign = reinterpret_cast<uintptr_t>(out) & 31;
+					x = std::min(width, static_cast<int>((32 - misalign) & 31) / 4);
+
+					if (x)
+						convert_partial(in, out, x, pixels);
+
+					for (; x + 8 <= width; x += 8)
+						_mm256_stream_si256(reinterpret_cast<__m256i*>(out + x * 4), pixels(in + x * 4));
+				}
+				else
+				{
+					for (; x + 8 <= width; x += 8)
+						_mm256_storeu_si256(reinterpret_cast<__m256i*>(out + x * 4), pixels(in + x * 4));
+				}
+
+				if (x < width)
+					convert_partial(in + x * 4, out + x * 4, width - x, pixels);
+			}
+
+			if (stream)
+				_mm_sfence();
+		}
+
+		// luminance_histogram::bin_of for 8 pixels, luma scaled to nits
+		AVX2 __m256i histogram_bins(const rgb_x8& c)
+		{
+			using histogram = luminance_histogram;
+
+			const __m256 nits = _mm256_mul_ps(luma(c), _mm256_set1_ps(80.0f));
+			const __m256i first = _mm256_set1_epi32((127 + histogram::min_stop) << 4);
+
+			__m256i bin = _mm256_sub_epi32(_mm256_srli_epi32(_mm256_castps_si256(nits), 19), first);
+			bin = _mm256_min_epu32(bin, _mm256_set1_epi32(histogram::bin_count - 1));
+
+			const __m256 lit = _mm256_cmp_ps(nits, _mm256_set1_ps(histogram::bin_nits(0)), _CMP_GT_OQ);
+			return _mm256_and_si256(bin, _mm256_castps_si256(lit));
+		}
+
+		// adds the rows to bins. Neighbouring pixels mostly share a bin, so the counts go to 4
+		// interleaved copies to keep increments of the same counter from queueing up
+		template <typename Source>
+		AVX2 void histogram_rows(
+			const void* src, size_t pitch,
+			int width, int height, uint64_t* bins, const Source& source
+		)
+		{
+			using input = typename Source::input;
+
+			uint32_t counts[4][luminance_histogram::bin_count] = {};
+
+			for (int y = 0; y < height; y++)
+			{
+				const auto* in = reinterpret_cast<const input*>(static_cast<const uint8_t*>(src) + pitch * y);
+				int x = 0;
+
+				for (; x + 8 <= width; x += 8)
+				{
+					// read back through general registers, reloading a vector store
+					// 4 bytes at a time stalls store forwarding
+					const __m256i bins8 = histogram_bins(source(in + x * 4));
+					const __m128i low = _mm256_castsi256_si128(bins8);
+					const __m128i high = _mm256_extracti128_si256(bins8, 1);
+
+					counts[0][_mm_cvtsi128_si32(low)]++;
+					counts[1][_mm_extract_epi32(low, 1)]++;
+					counts[2][_mm_extract_epi32(low, 2)]++;
+					counts[3][_mm_extract_epi32(low, 3)]++;
+					counts[0][_mm_cvtsi128_si32(high)]++;
+					counts[1][_mm_extract_epi32(high, 1)]++;
+					counts[2][_mm_extract_epi32(high, 2)]++;
+					counts[3][_mm_extract_epi32(high, 3)]++;
+				}
+
+				if (x < width)
+				{
+					input part[8 * 4] = {};
+					alignas(32) uint32_t index[8];
+					std::memcpy(part, in + x * 4, (width - x) * 4 * sizeof(input));
+					_mm256_store_si256(reinterpret_cast<__m256i*>(index), histogram_bins(source(part)));
+
+					for (int i = 0; i < width - x; i++)
+						counts[i & 3][index[i]]++;
+				}
+			}
+
+			for (int i = 0; i < luminance_histogram::bin_count; i++)
+				bins[i] += static_cast<uint64_t>(counts[0][i]) + counts[1][i] + counts[2][i] + counts[3][i];
+		}
+
+		// pixels per side of the tiles rotate_bgra8_avx2 walks, 4 KiB of source and of dest.
+		// Bigger tiles keep more rows open at once than the prefetchers follow
+		constexpr int rotate_tile = 32;
+
+		AVX2 __m256i load8(const uint8_t* row, int x)
+		{
+			return _mm256_loadu_si256(reinterpret_cast<const __m256i*>(row + 4 * static_cast<size_t>(x)));
+		}
+
+		AVX2 void store8(uint8_t* row, int x, __m256i px)
+		{
+			_mm256_storeu_si256(reinterpret_cast<__m256i*>(row + 4 * static_cast<size_t>(x)), px);
+		}
+
+		AVX2 void transpose8x8(__m256i (&r)[8])
+		{
+			const __m256i t0 = _mm256_unpacklo_epi32(r[0], r[1]);
+			const __m256i t1 = _mm256_unpackhi_epi32(r[0], r[1]);
+			const __m256i t2 = _mm256_unpacklo_epi32(r[2], r[3]);
+			const __m256i t3 = _mm256_unpackhi_epi32(r[2], r[3]);
+			const __m256i t4 = _mm256_unpacklo_epi32(r[4], r[5]);
+			const __m256i t5 = _mm256_unpackhi_epi32(r[4], r[5]);
+			const __m256i t6 = _mm256_unpacklo_epi32(r[6], r[7]);
+			const __m256i t7 = _mm256_unpackhi_epi32(r[6], r[7]);
+
+			const __m256i u0 = _mm256_unpacklo_epi64(t0, t2);
+			const __m256i u1 = _mm256_unpackhi_epi64(t0, t2);
+			const __m256i u2 = _mm256_unpacklo_epi64(t1, t3);
+			const __m256i u3 = _mm256_unpackhi_epi64(t1, t3);
+			const __m256i u4 = _mm256_unpacklo_epi64(t4, t6);
+			const __m256i u5 = _mm256_unpackhi_epi64(t4, t6);
+			const __m256i u6 = _mm256_unpacklo_epi64(t5, t7);
+			const __m256i u7 = _mm256_unpackhi_epi64(t5, t7);
+
+			r[0] = _mm256_permute2x128_si256(u0, u4, 0x20);
+			r[1] = _mm256_permute2x128_si256(u1, u5, 0x20);
+			r[2] = _mm256_permute2x128_si256(u2, u6, 0x20);
+			r[3] = _mm256_permute2x128_si256(u3, u7, 0x20);
+			r[4] = _mm256_permute2x128_si256(u0, u4, 0x31);
+			r[5] = _mm256_permute2x128_si256(u1, u5, 0x31);
+			r[6] = _mm256_permute2x128_si256(u2, u6, 0x31);
+			r[7] = _mm256_permute2x128_si256(u3, u7, 0x31);
+		}
+
+		// the 8x8 block at (x, y). For 90 the rows go in bottom up so the transposed
+		// columns come out already reversed, for 270 the columns land bottom up instead
+		template <int Rotation>
+		AVX2 void rotate_block(const uint8_t* src, size_t src_pitch, uint8_t* dest, size_t dest_pitch, int width, int height, int x, int y)
+		{
+			if constexpr (Rotation == 180)
+			{
+				const __m256i reverse = _mm256_setr_epi32(7, 6, 5, 4, 3, 2, 1, 0);
+
+				for (int i = 0; i < 8; i++)
+				{
+					const __m256i px = _mm256_permutevar8x32_epi32(load8(src + src_pitch * (y + i), x), reverse);
+					store8(dest + dest_pitch * (height - 1 - y - i), width - 8 - x, px);
+				}
+			}
+			else
+			{
+				__m256i r[8];
+				for (int i = 0; i < 8; i++)
+					r[i] = load8(src + src_pitch * (Rotation == 90 ? y + 7 - i : y + i), x);
+
+				transpose8x8(r);
+
+				for (int i = 0; i < 8; i++)
+				{
+					if constexpr (Rotation == 90)
+						store8(dest + dest_pitch * (x + i), height - 8 - y, r[i]);
+					else
+						store8(dest + dest_pitch * (width - 1 - x - i), y, r[i]);
+				}
+			}
+		}
+
+		template <int Rotation>
+		AVX2 void rotate_tiles(const uint8_t* src, size_t src_pitch, uint8_t* dest, size_t dest_pitch, int width, int height)
+		{
+			const int body_width = width & ~7;
+			const int body_height = height & ~7;
+
+			for (int ty = 0; ty < body_height; ty += rotate_tile)
+			{
+				for (int tx = 0; tx < body_width; tx += rotate_tile)
+				{
+					const int tile_right = std::min(tx + rotate_tile, body_width);
+					const int tile_bottom = std::min(ty + rotate_tile, body_height);
+
+					for (int y = ty; y < tile_bottom; y += 8)
+					{
+						for (int x = tx; x < tile_right; x += 8)
+							rotate_block<Rotation>(src, src_pitch, dest, dest_pitch, width, height, x, y);
+					}
+				}
+			}
+
+			rotate_bgra8_rect(src, src_pitch, dest, dest_pitch, width, height, Rotation, { body_width, 0, width, height });
+			rotate_bgra8_rect(src, src_pitch, dest, dest_pitch, width, height, Rotation, { 0, body_height, body_width, height });
+		}
+
+		// the rows through op with pixels read by source, the constants each operator
+		// needs are worked out once here
+		template <typename Source>
+		AVX2 void convert_tone(
+			const void* src, size_t src_pitch,
+			void* dest, size_t dest_pitch,
+			int width, int height, float white_level, tone_operator op, const Source& source
+		)
+		{
+			const __m256 inv_scale = _mm256_set1_ps(80.0f / white_level);
+
+			switch (op)
+			{
+			case tone_operator::reinhard:
+			{
+				const float white = 10000.0f / white_level;
+				const reinhard_pixels<Source> pixels = { source, inv_scale, _mm256_set1_ps(1.0f / (white * white)) };
+				convert_rows(src, src_pitch, dest, dest_pitch, width, height, pixels);
+				break;
+			}
+			case tone_operator::hable:
+			{
+				const hable_pixels<Source> pixels = {
+					source, inv_scale,
+					_mm256_div_ps(_mm256_set1_ps(1.0f), hable_curve(_mm256_set1_ps(curves::hable_white))),
+				};
+				convert_rows(src, src_pitch, dest, dest_pitch, width, height, pixels);
+				break;
+			}
+			case tone_operator::aces:
+			{
+				const aces_pixels<Source> pixels = { source, inv_scale };
+				convert_rows(src, src_pitch, dest, dest_pitch, width, height, pixels);
+				break;
+			}
+			case tone_operator::bt2390:
+			{
+				const float max_lum = tonemap::pq_encode(white_level / 10000.0f);
+				const bt2390_pixels<Source> pixels = {
+					source, inv_scale,
+					_mm256_set1_ps(white_level / 10000.0f),
+					_mm256_set1_ps(max_lum),
+					_mm256_set1_ps(1.5f * max_lum - 0.5f),
+				};
+				convert_rows(src, src_pitch, dest, dest_pitch, width, height, pixels);
+				break;
+			}
+			case tone_operator::agx:
+			{
+				const agx_pixels<Source> pixels = { source, inv_scale };
+				convert_rows(src, src_pitch, dest, dest_pitch, width, height, pixels);
+				break;
+			}
+			default:
+			{
+				const direct_pixels<Source> pixels = { source, inv_scale };
+				convert_rows(src, src_pitch, dest, dest_pitch, width, height, pixels);
+				break;
+			}
+			}
+		}
+
+		// hash_rows with the 8 lanes in two registers, see the sse4.1 version
+		AVX2 void hash_stripe(__m256i (&lanes)[2], const uint8_t* stripe)
+		{
+			for (int i = 0; i < 2; i++)
+			{
+				const __m256i data = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(stripe) + i);
+				const __m256i key = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(hashing::stripe_key) + i);
+				const __m256i keyed = _mm256_xor_si256(data, key);
+
+				const __m256i product = _mm256_mul_epu32(keyed, _mm256_srli_epi64(keyed, 32));
+				const __m256i swapped = _mm256_shuffle_epi32(data, _MM_SHUFFLE(1, 0, 3, 2));
+
+				lanes[i] = _mm256_add_epi64(lanes[i], _mm256_add_epi64(product, swapped));
+			}
+		}
+
+		AVX2 void hash_scramble(__m256i (&lanes)[2])
+		{
+			const __m256i prime = _mm256_set1_epi32(static_cast<int>(hashing::prime32_1));
+
+			for (int i = 0; i < 2; i++)
+			{
+				const __m256i key = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(hashing::scramble_key) + i);
+				const __m256i lane = _mm256_xor_si256(_mm256_xor_si256(lanes[i], _mm256_srli_epi64(lanes[i], 47)), key);
+
+				const __m256i low = _mm256_mul_epu32(lane, prime);
+				const __m256i high = _mm256_mul_epu32(_mm256_srli_epi64(lane, 32), prime);
+
+				lanes[i] = _mm256_add_epi64(low, _mm256_slli_epi64(high, 32));
+			}
+		}
+	}
+
+	AVX2 void hdr_to_bgra8_avx2(
+		const void* src, size_t src_pitch,
+		void* dest, size_t dest_pitch,
+		int width, int height, float white_level
+	)
+	{
+		convert_tone(src, src_pitch, dest, dest_pitch, width, height, white_level, tone_operator::blend, half_source{});
+	}
+
+	AVX2 void hdr_to_bgra8_lut_avx2(
+		const void* src, size_t src_pitch,
+		void* dest, size_t dest_pitch,
+		int width, int height, const float* lut
+	)
+	{
+		const lut_pixels pixels = { lut };
+		convert_rows(src, src_pitch, dest, dest_pitch, width, height, pixels);
+	}
+
+	AVX2 void hdr_to_bgra8_cube_avx2(
+		const void* src, size_t src_pitch,
+		void* dest, size_t dest_pitch,
+		int width, int height, const cube_lut& lut
+	)
+	{
+		const cube_pixels pixels = { lut.shaper(), lut.linear(), lut.table(), lut.size() };
+		convert_rows(src, src_pitch, dest, dest_pitch, width, height, pixels);
+	}
+
+	AVX2 void sdr_to_bgra8_avx2(
+		const void* src, size_t src_pitch,
+		void* dest, size_t dest_pitch,
+		int width, int height
+	)
+	{
+		convert_rows(src, src_pitch, dest, dest_pitch, width, height, swizzle_pixels{});
+	}
+
+	AVX2 void hdr_to_bgra8_reinhard_avx2(
+		const void* src, size_t src_pitch,
+		void* dest, size_t dest_pitch,
+		int width, int height, float white_level
+	)
+	{
+		convert_tone(src, src_pitch, dest, dest_pitch, width, height, white_level, tone_operator::reinhard, half_source{});
+	}
+
+	AVX2 void hdr_to_bgra8_hable_avx2(
+		const void* src, size_t src_pitch,
+		void* dest, size_t dest_pitch,
+		int width, int height, float white_level
+	)
+	{
+		convert_tone(src, src_pitch, dest, dest_pitch, width, height, white_level, tone_operator::hable, half_source{});
+	}
+
+	AVX2 void hdr_to_bgra8_aces_avx2(
+		const void* src, size_t src_pitch,
+		void* dest, size_t dest_pitch,
+		int width, int height, float white_level
+	)
+	{
+		convert_tone(src, src_pitch, dest, dest_pitch, width, height, white_level, tone_operator::aces, half_source{});
+	}
+
+	AVX2 void hdr_to_bgra8_bt2390_avx2(
+		const void* src, size_t src_pitch,
+		void* dest, size_t dest_pitch,
+		int width, int height, float white_level
+	)
+	{
+		convert_tone(src, src_pitch, dest, dest_pitch, width, height, white_level, tone_operator::bt2390, half_source{});
+	}
+
+	AVX2 void hdr_to_bgra8_agx_avx2(
+		const void* src, size_t src_pitch,
+		void* dest, size_t dest_pitch,
+		int width, int height, float white_level
+	)
+	{
+		convert_tone(src, src_pitch, dest, dest_pitch, width, height, white_level, tone_operator::agx, half_source{});
+	}
+
+	AVX2 void pq10_to_bgra8_avx2(
+		const void* src, size_t src_pitch,
+		void* dest, size_t dest_pitch,
+		int width, int height, float white_level, tone_operator op
+	)
+	{
+		convert_tone(src, src_pitch, dest, dest_pitch, width, height, white_level, op, pq10_source{ pq_eotf_table() });
+	}
+
+	AVX2 void rotate_bgra8_avx2(
+		const void* src, size_t src_pitch,
+		void* dest, size_t dest_pitch,
+		int width, int height, int rotation
+	)
+	{
+		const auto* in = static_cast<const uint8_t*>(src);
+		auto* out = static_cast<uint8_t*>(dest);
+
+		switch (rotation)
+		{
+		case 90:
+			rotate_tiles<90>(in, src_pitch, out, dest_pitch, width, height);
+			break;
+		case 180:
+			rotate_tiles<180>(in, src_pitch, out, dest_pitch, width, height);
+			break;
+		case 270:
+			rotate_tiles<270>(in, src_pitch, out, dest_pitch, width, height);
+			break;
+		default:
+			rotate_bgra8(src, src_pitch, dest, dest_pitch, width, height, rotation);
+			break;
+		}
+	}
+
+	AVX2 void histogram_rows_avx2(
+		const void* src, size_t pitch,
+		int width, int height, input_format format, uint64_t* bins
+	)
+	{
+		if (format == input_format::scrgb)
+			histogram_rows(src, pitch, width, height, bins, half_source{});
+		else if (format == input_format::pq10)
+			histogram_rows(src, pitch, width, height, bins, pq10_source{ pq_eotf_table() });
+	}
+	AVX2 uint64_t hash_rows_avx2(const void* src, size_t pitch, size_t row_bytes, int height)
+	{
+		__m256i lanes[2];
+		for (int i = 0; i < 2; i++)
+			lanes[i] = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(hashing::initial_lanes) + i);
+
+		const size_t stripes = row_bytes / hashing::stripe_bytes;
+		const size_t tail = row_bytes % hashing::stripe_bytes;
+
+		for (int y = 0; y < height; y++)
+		{
+			const auto* row = static_cast<const uint8_t*>(src) + pitch * y;
+
+			for (size_t s = 0; s < stripes; s++)
+				hash_stripe(lanes, row + s * hashing::stripe_bytes);
+
+			if (tail)
+			{
+				uint8_t last[hashing::stripe_bytes] = {};
+				std::memcpy(last, row + stripes * hashing::stripe_bytes, tail);
+				hash_stripe(lanes, last);
+			}
+
+			hash_scramble(lanes);
+		}
+
+		uint64_t result[8];
+		for (int i = 0; i < 2; i++)
+			_mm256_storeu_si256(reinterpret_cast<__m256i*>(result) + i, lanes[i]);
+
+		return hash_merge(result, static_cast<uint64_t>(row_bytes) * height);
+	}
+
+	AVX2 void copy_rows_avx2(const void* src, size_t src_pitch, void* dest, size_t dest_pitch, size_t row_bytes, int height)
+	{
+		if (height <= 0)
+			return;
+
+		// rows packed on both sides are one long row
+		if (src_pitch == row_bytes && dest_pitch == row_bytes)
+		{
+			row_bytes *= height;
+			height = 1;
+		}
+
+		for (int y = 0; y < height; y++)
+		{
+			const auto* in = static_cast<const uint8_t*>(src) + src_pitch * y;
+			auto* out = static_cast<uint8_t*>(dest) + dest_pitch * y;
+
+			// plain stores up to the alignment streaming stores need, then two cache lines at a time
+			size_t x = std::min(row_bytes, static_cast<size_t>((32 - (reinterpret_cast<uintptr_t>(out) & 31)) & 31));
+			std::memcpy(out, in, x);
+
+			for (; x + 128 <= row_bytes; x += 128)
+			{
+				const __m256i v0 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(in + x + 0));
+				const __m256i v1 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(in + x + 32));
+				const __m256i v2 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(in + x + 64));
+				const __m256i v3 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(in + x + 96));
+
+				_mm256_stream_si256(reinterpret_cast<__m256i*>(out + x + 0), v0);
+				_mm256_stream_si256(reinterpret_cast<__m256i*>(out + x + 32), v1);
+				_mm256_stream_si256(reinterpret_cast<__m256i*>(out + x + 64), v2);
+				_mm256_stream_si256(reinterpret_cast<__m256i*>(out + x + 96), v3);
+			}
+
+			std::memcpy(out + x, in + x, row_bytes - x);
+		}
+
+		_mm_sfence();
+	}
+}
+
+#else
+
+namespace tonemap
+{
+	void hdr_to_bgra8_avx2(
+		const void* src, size_t src_pitch,
+		void* dest, size_t dest_pitch,
+		int width, int height, float white_level
+	)
+	{
+		hdr_to_bgra8(src, src_pitch, dest, dest_pitch, width, height, white_level);
+	}
+
+	void hdr_to_bgra8_lut_avx2(
+		const void* src, size_t src_pitch,
+		void* dest, size_t dest_pitch,
+		int width, int height, const float* lut
+	)
+	{
+		hdr_to_bgra8_lut(src, src_pitch, dest, dest_pitch, width, height, lut);
+	}
+
+	void hdr_to_bgra8_cube_avx2(
+		const void* src, size_t src_pitch,
+		void* dest, size_t dest_pitch,
+		int width, int height, const cube_lut& lut
+	)
+	{
+		hdr_to_bgra8_cube(src, src_pitch, dest, dest_pitch, width, height, lut);
+	}
+
+	void sdr_to_bgra8_avx2(
+		const void* src, size_t src_pitch,
+		void* dest, size_t dest_pitch,
+		int width, int height
+	)
+	{
+		sdr_to_bgra8(src, src_pitch, dest, dest_pitch, width, height);
+	}
+
+	void hdr_to_bgra8_reinhard_avx2(
+		const void* src, size_t src_pitch,
+		void* dest, size_t dest_pitch,
+		int width, int height, float white_level
+	)
+	{
+		hdr_to_bgra8(src, src_pitch, dest, dest_pitch, width, height, white_level, tone_operator::reinhard);
+	}
+
+	void hdr_to_bgra8_hable_avx2(
+		const void* src, size_t src_pitch,
+		void* dest, size_t dest_pitch,
+		int width, int height, float white_level
+	)
+	{
+		hdr_to_bgra8(src, src_pitch, dest, dest_pitch, width, height, white_level, tone_operator::hable);
+	}
+
+	void hdr_to_bgra8_aces_avx2(
+		const void* src, size_t src_pitch,
+		void* dest, size_t dest_pitch,
+		int width, int height, float white_level
+	)
+	{
+		hdr_to_bgra8(src, src_pitch, dest, dest_pitch, width, height, white_level, tone_operator::aces);
+	}
+
+	void hdr_to_bgra8_bt2390_avx2(
+		const void* src, size_t src_pitch,
+		void* dest, size_t dest_pitch,
+		int width, int height, float white_level
+	)
+	{
+		hdr_to_bgra8(src, src_pitch, dest, dest_pitch, width, height, white_level, tone_operator::bt2390);
+	}
+
+	void hdr_to_bgra8_agx_avx2(
+		const void* src, size_t src_pitch,
+		void* dest, size_t dest_pitch,
+		int width, int height, float white_level
+	)
+	{
+		hdr_to_bgra8(src, src_pitch, dest, dest_pitch, width, height, white_level, tone_operator::agx);
+	}
+
+	void pq10_to_bgra8_avx2(
+		const void* src, size_t src_pitch,
+		void* dest, size_t dest_pitch,
+		int width, int height, float white_level, tone_operator op
+	)
+	{
+		pq10_to_bgra8(src, src_pitch, dest, dest_pitch, width, height, white_level, op);
+	}
+
+	void rotate_bgra8_avx2(
+		const void* src, size_t src_pitch,
+		void* dest, size_t dest_pitch,
+		int width, int height, int rotation
+	)
+	{
+		rotate_bgra8(src, src_pitch, dest, dest_pitch, width, height, rotation);
+	}
+
+	void histogram_rows_avx2(
+		const void* src, size_t pitch,
+		int width, int height, input_format format, uint64_t* bins
+	)
+	{
+		histogram_rows(src, pitch, width, height, format, bins);
+	}
+
+	uint64_t hash_rows_avx2(const void* src, size_t pitch, size_t row_bytes, int height)
+	{
+		return hash_rows(src, pitch, row_bytes, height);
+	}
+
+	void copy_rows_avx2(const void* src, size_t src_pitch, void* dest, size_t dest_pitch, size_t row_bytes, int height)
+	{
+		copy_rows(src, src_pitch, dest, dest_pitch, row_bytes, height);
+	}
+}
+
+#endif
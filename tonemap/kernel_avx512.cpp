@@ -0,0 +1,342 @@
+#include <cstdint>
+#include <algorithm>
+
+#include "tonemap.hpp"
+#include "kernels.hpp"
+#include "simd.hpp"
+#include "dispatch.hpp"
+
+#if TONEMAP_X86
+
+#define AVX512 TONEMAP_TARGET("avx512f,avx2,fma,f16c")
+
+namespace tonemap
+{
+	namespace
+	{
+		struct rgb_x16
+		{
+			__m512 r, g, b;
+		};
+
+		AVX512 __m512 rcp(__m512 x)
+		{
+			const __m512 r = _mm512_rcp14_ps(x);
+			return _mm512_mul_ps(r, _mm512_fnmadd_ps(x, r, _mm512_set1_ps(2.0f)));
+		}
+
+		AVX512 __m512 log2(__m512 x)
+		{
+			__m512 m = _mm512_getmant_ps(x, _MM_MANT_NORM_1_2, _MM_MANT_SIGN_zero);
+			__m512 e = _mm512_getexp_ps(x);
+
+			const __mmask16 fold = _mm512_cmp_ps_mask(m, _mm512_set1_ps(1.5f), _CMP_GE_OQ);
+			m = _mm512_mask_mul_ps(m, fold, m, _mm512_set1_ps(0.5f));
+			e = _mm512_mask_add_ps(e, fold, e, _mm512_set1_ps(1.0f));
+
+			const __m512 t = _mm512_sub_ps(m, _mm512_set1_ps(1.0f));
+
+			__m512 p = _mm512_set1_ps(poly::log2_c[5]);
+			p = _mm512_fmadd_ps(p, t, _mm512_set1_ps(poly::log2_c[4]));
+			p = _mm512_fmadd_ps(p, t, _mm512_set1_ps(poly::log2_c[3]));
+			p = _mm512_fmadd_ps(p, t, _mm512_set1_ps(poly::log2_c[2]));
+			p = _mm512_fmadd_ps(p, t, _mm512_set1_ps(poly::log2_c[1]));
+			p = _mm512_fmadd_ps(p, t, _mm512_set1_ps(poly::log2_c[0]));
+
+			return _mm512_fmadd_ps(p, t, e);
+		}
+
+		AVX512 __m512 exp2(__m512 y)
+		{
+			const __m512 i = _mm512_roundscale_ps(y, _MM_FROUND_TO_NEG_INF | _MM_FROUND_NO_EXC);
+			const __m512 f = _mm512_sub_ps(y, i);
+
+			__m512 p = _mm512_set1_ps(poly::exp2_c[4]);
+			p = _mm512_fmadd_ps(p, f, _mm512_set1_ps(poly::exp2_c[3]));
+			p = _mm512_fmadd_ps(p, f, _mm512_set1_ps(poly::exp2_c[2]));
+			p = _mm512_fmadd_ps(p, f, _mm512_set1_ps(poly::exp2_c[1]));
+			p = _mm512_fmadd_ps(p, f, _mm512_set1_ps(poly::exp2_c[0]));
+
+			return _mm512_scalef_ps(p, i);
+		}
+
+		AVX512 __m512 encode(__m512 x)
+		{
+			const __m512 curve = _mm512_fmsub_ps(
+				_mm512_set1_ps(1.055f),
+				exp2(_mm512_mul_ps(log2(x), _mm512_set1_ps(1.0f / 2.4f))),
+				_mm512_set1_ps(0.055f)
+			);
+			const __m512 toe = _mm512_mul_ps(x, _mm512_set1_ps(12.92f));
+
+			return _mm512_mask_blend_ps(
+				_mm512_cmp_ps_mask(x, _mm512_set1_ps(0.00313066844250063f), _CMP_GT_OQ), toe, curve
+			);
+		}
+
+		AVX512 __m512 linear(__m512 x)
+		{
+			const __m512 knee = _mm512_fmadd_ps(x, _mm512_set1_ps(0.4f), _mm512_set1_ps(0.48f));
+			return _mm512_mask_blend_ps(_mm512_cmp_ps_mask(x, _mm512_set1_ps(0.8f), _CMP_GE_OQ), x, knee);
+		}
+
+		AVX512 __m512 luma(const rgb_x16& c)
+		{
+			__m512 l = _mm512_mul_ps(c.r, _mm512_set1_ps(0.213f));
+			l = _mm512_fmadd_ps(c.g, _mm512_set1_ps(0.715f), l);
+			return _mm512_fmadd_ps(c.b, _mm512_set1_ps(0.072f), l);
+		}
+
+		AVX512 __m512 desaturate(__m512 v, __mmask16 k, __m512 scale, __m512 new_peak, __m512 g)
+		{
+			const __m512 scaled = _mm512_mul_ps(v, scale);
+			return _mm512_mask_blend_ps(k, v, _mm512_fmadd_ps(g, _mm512_sub_ps(new_peak, scaled), scaled));
+		}
+
+		AVX512 rgb_x16 neutral(rgb_x16 c)
+		{
+			const __m512 start_compression = _mm512_set1_ps(0.8f - 0.04f);
+			const __m512 d = _mm512_set1_ps(1.0f - (0.8f - 0.04f));
+			const __m512 one = _mm512_set1_ps(1.0f);
+
+			const __m512 x = _mm512_min_ps(c.r, _mm512_min_ps(c.g, c.b));
+			const __m512 offset = _mm512_mask_blend_ps(
+				_mm512_cmp_ps_mask(x, _mm512_set1_ps(0.08f), _CMP_LT_OQ),
+				_mm512_set1_ps(0.04f),
+				_mm512_fnmadd_ps(_mm512_mul_ps(x, x), _mm512_set1_ps(6.25f), x)
+			);
+
+			c.r = _mm512_sub_ps(c.r, offset);
+			c.g = _mm512_sub_ps(c.g, offset);
+			c.b = _mm512_sub_ps(c.b, offset);
+
+			const __m512 peak = _mm512_max_ps(c.r, _mm512_max_ps(c.g, c.b));
+			const __mmask16 compress = _mm512_cmp_ps_mask(peak, start_compression, _CMP_GE_OQ);
+
+			if (!compress)
+				return c;
+
+			const __m512 new_peak = _mm512_fnmadd_ps(
+				_mm512_mul_ps(d, d),
+				rcp(_mm512_sub_ps(_mm512_add_ps(peak, d), start_compression)),
+				one
+			);
+			const __m512 scale = _mm512_mul_ps(new_peak, rcp(peak));
+			const __m512 g = _mm512_sub_ps(
+				one, rcp(_mm512_fmadd_ps(_mm512_set1_ps(0.15f), _mm512_sub_ps(peak, new_peak), one))
+			);
+
+			return {
+				desaturate(c.r, compress, scale, new_peak, g),
+				desaturate(c.g, compress, scale, new_peak, g),
+				desaturate(c.b, compress, scale, new_peak, g),
+			};
+		}
+
+		AVX512 rgb_x16 decode(rgb_x16 c, __m512 inv_scale)
+		{
+			const __m512 zero = _mm512_setzero_ps();
+			const __m512 max_nits = _mm512_set1_ps(10000.0f);
+
+			c.r = encode(_mm512_mul_ps(_mm512_min_ps(_mm512_max_ps(c.r, zero), max_nits), inv_scale));
+			c.g = encode(_mm512_mul_ps(_mm512_min_ps(_mm512_max_ps(c.g, zero), max_nits), inv_scale));
+			c.b = encode(_mm512_mul_ps(_mm512_min_ps(_mm512_max_ps(c.b, zero), max_nits), inv_scale));
+
+			return c;
+		}
+
+		AVX512 rgb_x16 tone(const rgb_x16& c)
+		{
+			const rgb_x16 linear_result = { linear(c.r), linear(c.g), linear(c.b) };
+			const __m512 linear_luma = luma(linear_result);
+			const __mmask16 blend = _mm512_cmp_ps_mask(linear_luma, _mm512_set1_ps(0.8f), _CMP_GE_OQ);
+
+			if (!blend)
+				return linear_result;
+
+			const rgb_x16 neutral_result = neutral(c);
+			const __m512 scale = _mm512_mul_ps(linear_luma, rcp(luma(neutral_result)));
+
+			return {
+				_mm512_mask_mul_ps(linear_result.r, blend, neutral_result.r, scale),
+				_mm512_mask_mul_ps(linear_result.g, blend, neutral_result.g, scale),
+				_mm512_mask_mul_ps(linear_result.b, blend, neutral_result.b, scale),
+			};
+		}
+
+		// 16 pixels, lo / hi are dword masks over pixels 0-7 and 8-15, masked lanes read as 0
+		AVX512 rgb_x16 load(const uint16_t* in, __mmask16 lo, __mmask16 hi)
+		{
+			const __m512i raw_lo = _mm512_maskz_loadu_epi32(lo, in);
+			const __m512i raw_hi = _mm512_maskz_loadu_epi32(hi, in + 32);
+
+			const __m512 p0 = _mm512_cvtph_ps(_mm512_castsi512_si256(raw_lo));
+			const __m512 p1 = _mm512_cvtph_ps(_mm512_extracti64x4_epi64(raw_lo, 1));
+			const __m512 p2 = _mm512_cvtph_ps(_mm512_castsi512_si256(raw_hi));
+			const __m512 p3 = _mm512_cvtph_ps(_mm512_extracti64x4_epi64(raw_hi, 1));
+
+			const __m512i rg = _mm512_setr_epi32(0, 4, 8, 12, 16, 20, 24, 28, 1, 5, 9, 13, 17, 21, 25, 29);
+			const __m512i ba = _mm512_setr_epi32(2, 6, 10, 14, 18, 22, 26, 30, 3, 7, 11, 15, 19, 23, 27, 31);
+			const __m512i first = _mm512_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7, 16, 17, 18, 19, 20, 21, 22, 23);
+			const __m512i second = _mm512_setr_epi32(8, 9, 10, 11, 12, 13, 14, 15, 24, 25, 26, 27, 28, 29, 30, 31);
+
+			const __m512 rg01 = _mm512_permutex2var_ps(p0, rg, p1);
+			const __m512 rg23 = _mm512_permutex2var_ps(p2, rg, p3);
+			const __m512 ba01 = _mm512_permutex2var_ps(p0, ba, p1);
+			const __m512 ba23 = _mm512_permutex2var_ps(p2, ba, p3);
+
+			return {
+				_mm512_permutex2var_ps(rg01, first, rg23),
+				_mm512_permutex2var_ps(rg01, second, rg23),
+				_mm512_permutex2var_ps(ba01, first, ba23),
+			};
+		}
+
+		AVX512 rgb_x16 lookup(const uint16_t* in, __mmask16 lo, __mmask16 hi, const float* lut)
+		{
+			const __m512i p0 = _mm512_maskz_loadu_epi32(lo, in);
+			const __m512i p1 = _mm512_maskz_loadu_epi32(hi, in + 32);
+
+			const __m512i rg = _mm512_permutex2var_epi32(
+				p0, _mm512_setr_epi32(0, 2, 4, 6, 8, 10, 12, 14, 16, 18, 20, 22, 24, 26, 28, 30), p1
+			);
+			const __m512i ba = _mm512_permutex2var_epi32(
+				p0, _mm512_setr_epi32(1, 3, 5, 7, 9, 11, 13, 15, 17, 19, 21, 23, 25, 27, 29, 31), p1
+			);
+			const __m512i low = _mm512_set1_epi32(0xffff);
+
+			// masked out pixels read as 0 and gather lut[0], which is always in range
+			return {
+				_mm512_i32gather_ps(_mm512_and_si512(rg, low), lut, 4),
+				_mm512_i32gather_ps(_mm512_srli_epi32(rg, 16), lut, 4),
+				_mm512_i32gather_ps(_mm512_and_si512(ba, low), lut, 4),
+			};
+		}
+
+		AVX512 __m512i quantize(__m512 x)
+		{
+			x = _mm512_min_ps(_mm512_max_ps(x, _mm512_setzero_ps()), _mm512_set1_ps(1.0f));
+			return _mm512_cvttps_epi32(_mm512_add_ps(_mm512_mul_ps(x, _mm512_set1_ps(255.0f)), _mm512_set1_ps(0.5f)));
+		}
+
+		AVX512 __m512i pack(const rgb_x16& c)
+		{
+			__m512i px = _mm512_or_si512(quantize(c.b), _mm512_set1_epi32(static_cast<int>(0xff000000)));
+			px = _mm512_or_si512(px, _mm512_slli_epi32(quantize(c.g), 8));
+			return _mm512_or_si512(px, _mm512_slli_epi32(quantize(c.r), 16));
+		}
+
+		struct direct_pixels
+		{
+			__m512 inv_scale;
+
+			AVX512 __m512i operator()(const uint16_t* in, __mmask16 lo, __mmask16 hi) const
+			{
+				return pack(tone(decode(load(in, lo, hi), inv_scale)));
+			}
+		};
+
+		struct lut_pixels
+		{
+			const float* lut;
+
+			AVX512 __m512i operator()(const uint16_t* in, __mmask16 lo, __mmask16 hi) const
+			{
+				return pack(tone(lookup(in, lo, hi, lut)));
+			}
+		};
+
+		template <typename Pixels>
+		AVX512 void convert_masked(const uint16_t* in, uint8_t* out, int count, const Pixels& pixels)
+		{
+			// a pixel is two dwords of input and one of output
+			const uint32_t dwords = count == 16 ? 0xffffffffu : (1u << (count * 2)) - 1;
+			const auto store = static_cast<__mmask16>((1u << count) - 1);
+
+			const __m512i px = pixels(in, static_cast<__mmask16>(dwords), static_cast<__mmask16>(dwords >> 16));
+			_mm512_mask_storeu_epi32(out, store, px);
+		}
+
+		// same single pass as the avx2 version. Row heads up to 64 byte alignment and row
+		// ends just narrow the masks, so no pixel ever takes a scalar path
+		template <typename Pixels>
+		AVX512 void convert_rows(
+			const void* src, size_t src_pitch,
+			void* dest, size_t dest_pitch,
+			int width, int height, const Pixels& pixels
+		)
+		{
+			const bool stream = should_stream(dest, dest_pitch, width, height);
+
+			for (int y = 0; y < height; y++)
+			{
+				const auto* in = reinterpret_cast<const uint16_t*>(static_cast<const uint8_t*>(src) + src_pitch * y);
+				auto* out = static_cast<uint8_t*>(dest) + dest_pitch * y;
+				int x = 0;
+
+				if (stream)
+				{
+					const auto misalign = reinterpret_cast<uintptr_t>(out) & 63;
+					x = std::min(width, static_cast<int>((64 - misalign) & 63) / 4);
+
+					if (x)
+						convert_masked(in, out, x, pixels);
+
+					for (; x + 16 <= width; x += 16)
+						_mm512_stream_si512(reinterpret_cast<__m512i*>(out + x * 4), pixels(in + x * 4, 0xffff, 0xffff));
+				}
+
+				for (; x < width; x += 16)
+					convert_masked(in + x * 4, out + x * 4, std::min(width - x, 16), pixels);
+			}
+
+			if (stream)
+				_mm_sfence();
+		}
+	}
+
+	AVX512 void hdr_to_bgra8_avx512(
+		const void* src, size_t src_pitch,
+		void* dest, size_t dest_pitch,
+		int width, int height, float white_level
+	)
+	{
+		const direct_pixels pixels = { _mm512_set1_ps(80.0f / white_level) };
+		convert_rows(src, src_pitch, dest, dest_pitch, width, height, pixels);
+	}
+
+	AVX512 void hdr_to_bgra8_lut_avx512(
+		const void* src, size_t src_pitch,
+		void* dest, size_t dest_pitch,
+		int width, int height, const float* lut
+	)
+	{
+		const lut_pixels pixels = { lut };
+		convert_rows(src, src_pitch, dest, dest_pitch, width, height, pixels);
+	}
+}
+
+#else
+
+namespace tonemap
+{
+	void hdr_to_bgra8_avx512(
+		const void* src, size_t src_pitch,
+		void* dest, size_t dest_pitch,
+		int width, int height, float white_level
+	)
+	{
+		hdr_to_bgra8(src, src_pitch, dest, dest_pitch, width, height, white_level);
+	}
+
+	void hdr_to_bgra8_lut_avx512(
+		const void* src, size_t src_pitch,
+		void* dest, size_t dest_pitch,
+		int width, int height, const float* lut
+	)
+	{
+		hdr_to_bgra8_lut(src, src_pitch, dest, dest_pitch, width, height, lut);
+	}
+}
+
+#endif
@@ -0,0 +1,581 @@
+#include <cstdint>
+#include <cstring>
+#include <algorithm>
+
+#include "tonemap.hpp"
+#include "kernels.hpp"
+#include "simd.hpp"
+#include "rotate.hpp"
+#include "tile_hash.hpp"
+#include "copy.hpp"
+
+#if TONEMAP_X86
+
+#define SSE41 TONEMAP_TARGET("sse4.1")
+
+namespace tonemap
+{
+	namespace
+	{
+		struct rgb_x4
+		{
+			__m128 r, g, b;
+		};
+
+		SSE41 __m128 rcp(__m128 x)
+		{
+			const __m128 r = _mm_rcp_ps(x);
+			return _mm_mul_ps(r, _mm_sub_ps(_mm_set1_ps(2.0f), _mm_mul_ps(x, r)));
+		}
+
+		SSE41 __m128 log2(__m128 x)
+		{
+			const __m128i bits = _mm_castps_si128(x);
+			__m128i e = _mm_sub_epi32(_mm_srli_epi32(bits, 23), _mm_set1_epi32(127));
+			__m128 m = _mm_castsi128_ps(_mm_or_si128(
+				_mm_and_si128(bits, _mm_set1_epi32(0x007fffff)),
+				_mm_set1_epi32(0x3f800000)
+			));
+
+			const __m128 fold = _mm_cmpge_ps(m, _mm_set1_ps(1.5f));
+			m = _mm_blendv_ps(m, _mm_mul_ps(m, _mm_set1_ps(0.5f)), fold);
+			e = _mm_sub_epi32(e, _mm_castps_si128(fold));
+
+			const __m128 t = _mm_sub_ps(m, _mm_set1_ps(1.0f));
+
+			__m128 p = _mm_set1_ps(poly::log2_c[5]);
+			p = _mm_add_ps(_mm_mul_ps(p, t), _mm_set1_ps(poly::log2_c[4]));
+			p = _mm_add_ps(_mm_mul_ps(p, t), _mm_set1_ps(poly::log2_c[3]));
+			p = _mm_add_ps(_mm_mul_ps(p, t), _mm_set1_ps(poly::log2_c[2]));
+			p = _mm_add_ps(_mm_mul_ps(p, t), _mm_set1_ps(poly::log2_c[1]));
+			p = _mm_add_ps(_mm_mul_ps(p, t), _mm_set1_ps(poly::log2_c[0]));
+
+			return _mm_add_ps(_mm_mul_ps(p, t), _mm_cvtepi32_ps(e));
+		}
+
+		SSE41 __m128 exp2(__m128 y)
+		{
+			const __m128 i = _mm_floor_ps(y);
+			const __m128 f = _mm_sub_ps(y, i);
+
+			__m128 p = _mm_set1_ps(poly::exp2_c[4]);
+			p = _mm_add_ps(_mm_mul_ps(p, f), _mm_set1_ps(poly::exp2_c[3]));
+			p = _mm_add_ps(_mm_mul_ps(p, f), _mm_set1_ps(poly::exp2_c[2]));
+			p = _mm_add_ps(_mm_mul_ps(p, f), _mm_set1_ps(poly::exp2_c[1]));
+			p = _mm_add_ps(_mm_mul_ps(p, f), _mm_set1_ps(poly::exp2_c[0]));
+
+			const __m128i scale = _mm_slli_epi32(_mm_add_epi32(_mm_cvtps_epi32(i), _mm_set1_epi32(127)), 23);
+
+			return _mm_mul_ps(p, _mm_castsi128_ps(scale));
+		}
+
+		SSE41 __m128 encode(__m128 x)
+		{
+			const __m128 pw = exp2(_mm_mul_ps(log2(x), _mm_set1_ps(1.0f / 2.4f)));
+			const __m128 curve = _mm_sub_ps(_mm_mul_ps(pw, _mm_set1_ps(1.055f)), _mm_set1_ps(0.055f));
+			const __m128 toe = _mm_mul_ps(x, _mm_set1_ps(12.92f));
+
+			return _mm_blendv_ps(toe, curve, _mm_cmpgt_ps(x, _mm_set1_ps(0.00313066844250063f)));
+		}
+
+		SSE41 __m128 linear(__m128 x)
+		{
+			const __m128 knee = _mm_add_ps(_mm_mul_ps(x, _mm_set1_ps(0.4f)), _mm_set1_ps(0.48f));
+			return _mm_blendv_ps(x, knee, _mm_cmpge_ps(x, _mm_set1_ps(0.8f)));
+		}
+
+		SSE41 __m128 luma(const rgb_x4& c)
+		{
+			return _mm_add_ps(
+				_mm_add_ps(_mm_mul_ps(c.r, _mm_set1_ps(0.213f)), _mm_mul_ps(c.g, _mm_set1_ps(0.715f))),
+				_mm_mul_ps(c.b, _mm_set1_ps(0.072f))
+			);
+		}
+
+		SSE41 __m128 desaturate(__m128 v, __m128 scale, __m128 new_peak, __m128 g)
+		{
+			v = _mm_mul_ps(v, scale);
+			return _mm_add_ps(v, _mm_mul_ps(g, _mm_sub_ps(new_peak, v)));
+		}
+
+		SSE41 rgb_x4 neutral(rgb_x4 c)
+		{
+			const __m128 start_compression = _mm_set1_ps(0.8f - 0.04f);
+			const __m128 d = _mm_set1_ps(1.0f - (0.8f - 0.04f));
+			const __m128 one = _mm_set1_ps(1.0f);
+
+			const __m128 x = _mm_min_ps(c.r, _mm_min_ps(c.g, c.b));
+			const __m128 offset = _mm_blendv_ps(
+				_mm_set1_ps(0.04f),
+				_mm_sub_ps(x, _mm_mul_ps(_mm_mul_ps(x, x), _mm_set1_ps(6.25f))),
+				_mm_cmplt_ps(x, _mm_set1_ps(0.08f))
+			);
+
+			c.r = _mm_sub_ps(c.r, offset);
+			c.g = _mm_sub_ps(c.g, offset);
+			c.b = _mm_sub_ps(c.b, offset);
+
+			const __m128 peak = _mm_max_ps(c.r, _mm_max_ps(c.g, c.b));
+			const __m128 compress = _mm_cmpge_ps(peak, start_compression);
+
+			if (!_mm_movemask_ps(compress))
+				return c;
+
+			const __m128 new_peak = _mm_sub_ps(one, _mm_mul_ps(
+				_mm_mul_ps(d, d),
+				rcp(_mm_sub_ps(_mm_add_ps(peak, d), start_compression))
+			));
+			const __m128 scale = _mm_mul_ps(new_peak, rcp(peak));
+			const __m128 g = _mm_sub_ps(one, rcp(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(0.15f), _mm_sub_ps(peak, new_peak)), one)));
+
+			return {
+				_mm_blendv_ps(c.r, desaturate(c.r, scale, new_peak, g), compress),
+				_mm_blendv_ps(c.g, desaturate(c.g, scale, new_peak, g), compress),
+				_mm_blendv_ps(c.b, desaturate(c.b, scale, new_peak, g), compress),
+			};
+		}
+
+		SSE41 rgb_x4 decode(rgb_x4 c, __m128 inv_scale)
+		{
+			const __m128 zero = _mm_setzero_ps();
+			const __m128 max_nits = _mm_set1_ps(10000.0f);
+
+			c.r = encode(_mm_mul_ps(_mm_min_ps(_mm_max_ps(c.r, zero), max_nits), inv_scale));
+			c.g = encode(_mm_mul_ps(_mm_min_ps(_mm_max_ps(c.g, zero), max_nits), inv_scale));
+			c.b = encode(_mm_mul_ps(_mm_min_ps(_mm_max_ps(c.b, zero), max_nits), inv_scale));
+
+			return c;
+		}
+
+		SSE41 rgb_x4 tone(const rgb_x4& c)
+		{
+			const rgb_x4 linear_result = { linear(c.r), linear(c.g), linear(c.b) };
+			const __m128 linear_luma = luma(linear_result);
+			const __m128 blend = _mm_cmpge_ps(linear_luma, _mm_set1_ps(0.8f));
+
+			if (!_mm_movemask_ps(blend))
+				return linear_result;
+
+			const rgb_x4 neutral_result = neutral(c);
+			const __m128 scale = _mm_mul_ps(linear_luma, rcp(luma(neutral_result)));
+
+			return {
+				_mm_blendv_ps(linear_result.r, _mm_mul_ps(neutral_result.r, scale), blend),
+				_mm_blendv_ps(linear_result.g, _mm_mul_ps(neutral_result.g, scale), blend),
+				_mm_blendv_ps(linear_result.b, _mm_mul_ps(neutral_result.b, scale), blend),
+			};
+		}
+
+		SSE41 __m128 decode_half(__m128i h)
+		{
+			// exact half -> float without f16c, the 2^112 multiply also rebases subnormals
+			const __m128i exp_mant = _mm_and_si128(h, _mm_set1_epi32(0x7fff));
+			const __m128i sign = _mm_slli_epi32(_mm_xor_si128(h, exp_mant), 16);
+			const __m128 scaled = _mm_mul_ps(
+				_mm_castsi128_ps(_mm_slli_epi32(exp_mant, 13)),
+				_mm_castsi128_ps(_mm_set1_epi32((254 - 15) << 23))
+			);
+			const __m128i inf_nan = _mm_and_si128(
+				_mm_cmpgt_epi32(exp_mant, _mm_set1_epi32(0x7bff)),
+				_mm_set1_epi32(255 << 23)
+			);
+
+			return _mm_or_ps(scaled, _mm_castsi128_ps(_mm_or_si128(sign, inf_nan)));
+		}
+
+		SSE41 rgb_x4 load(const uint16_t* in)
+		{
+			const __m128i zero = _mm_setzero_si128();
+			const __m128i p01 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in));
+			const __m128i p23 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + 8));
+
+			__m128 p0 = decode_half(_mm_unpacklo_epi16(p01, zero));
+			__m128 p1 = decode_half(_mm_unpackhi_epi16(p01, zero));
+			__m128 p2 = decode_half(_mm_unpacklo_epi16(p23, zero));
+			__m128 p3 = decode_half(_mm_unpackhi_epi16(p23, zero));
+
+			_MM_TRANSPOSE4_PS(p0, p1, p2, p3);
+
+			return { p0, p1, p2 };
+		}
+
+		SSE41 rgb_x4 lookup(const uint16_t* in, const float* lut)
+		{
+			// no gather before avx2, the loads are still far cheaper than the pow they replace
+			return {
+				_mm_setr_ps(lut[in[0]], lut[in[4]], lut[in[8]], lut[in[12]]),
+				_mm_setr_ps(lut[in[1]], lut[in[5]], lut[in[9]], lut[in[13]]),
+				_mm_setr_ps(lut[in[2]], lut[in[6]], lut[in[10]], lut[in[14]]),
+			};
+		}
+
+		SSE41 __m128i quantize(__m128 x)
+		{
+			x = _mm_min_ps(_mm_max_ps(x, _mm_setzero_ps()), _mm_set1_ps(1.0f));
+			return _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(x, _mm_set1_ps(255.0f)), _mm_set1_ps(0.5f)));
+		}
+
+		SSE41 __m128i pack(const rgb_x4& c)
+		{
+			__m128i px = _mm_or_si128(quantize(c.b), _mm_set1_epi32(static_cast<int>(0xff000000)));
+			px = _mm_or_si128(px, _mm_slli_epi32(quantize(c.g), 8));
+			return _mm_or_si128(px, _mm_slli_epi32(quantize(c.r), 16));
+		}
+
+		// pixels per side of the tiles rotate_bgra8_sse41 walks, as for avx2
+		constexpr int rotate_tile = 32;
+
+		SSE41 __m128i load4(const uint8_t* row, int x)
+		{
+			return _mm_loadu_si128(reinterpret_cast<const __m128i*>(row + 4 * static_cast<size_t>(x)));
+		}
+
+		SSE41 void store4(uint8_t* row, int x, __m128i px)
+		{
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(row + 4 * static_cast<size_t>(x)), px);
+		}
+
+		// rotate_block in kernel_avx2.cpp with 4x4 blocks
+		template <int Rotation>
+		SSE41 void rotate_block(const uint8_t* src, size_t src_pitch, uint8_t* dest, size_t dest_pitch, int width, int height, int x, int y)
+		{
+			if constexpr (Rotation == 180)
+			{
+				for (int i = 0; i < 4; i++)
+				{
+					const __m128i px = _mm_shuffle_epi32(load4(src + src_pitch * (y + i), x), _MM_SHUFFLE(0, 1, 2, 3));
+					store4(dest + dest_pitch * (height - 1 - y - i), width - 4 - x, px);
+				}
+			}
+			else
+			{
+				__m128 r[4];
+				for (int i = 0; i < 4; i++)
+					r[i] = _mm_castsi128_ps(load4(src + src_pitch * (Rotation == 90 ? y + 3 - i : y + i), x));
+
+				_MM_TRANSPOSE4_PS(r[0], r[1], r[2], r[3]);
+
+				for (int i = 0; i < 4; i++)
+				{
+					if constexpr (Rotation == 90)
+						store4(dest + dest_pitch * (x + i), height - 4 - y, _mm_castps_si128(r[i]));
+					else
+						store4(dest + dest_pitch * (width - 1 - x - i), y, _mm_castps_si128(r[i]));
+				}
+			}
+		}
+
+		template <int Rotation>
+		SSE41 void rotate_tiles(const uint8_t* src, size_t src_pitch, uint8_t* dest, size_t dest_pitch, int width, int height)
+		{
+			const int body_width = width & ~3;
+			const int body_height = height & ~3;
+
+			for (int ty = 0; ty < body_height; ty += rotate_tile)
+			{
+				for (int tx = 0; tx < body_width; tx += rotate_tile)
+				{
+					const int tile_right = std::min(tx + rotate_tile, body_width);
+					const int tile_bottom = std::min(ty + rotate_tile, body_height);
+
+					for (int y = ty; y < tile_bottom; y += 4)
+					{
+						for (int x = tx; x < tile_right; x += 4)
+							rotate_block<Rotation>(src, src_pitch, dest, dest_pitch, width, height, x, y);
+					}
+				}
+			}
+
+			rotate_bgra8_rect(src, src_pitch, dest, dest_pitch, width, height, Rotation, { body_width, 0, width, height });
+			rotate_bgra8_rect(src, src_pitch, dest, dest_pitch, width, height, Rotation, { 0, body_height, body_width, height });
+		}
+
+		// hash_rows with the 8 lanes as 4 pairs
+		SSE41 void hash_stripe(__m128i (&lanes)[4], const uint8_t* stripe)
+		{
+			for (int i = 0; i < 4; i++)
+			{
+				const __m128i data = _mm_loadu_si128(reinterpret_cast<const __m128i*>(stripe) + i);
+				const __m128i key = _mm_loadu_si128(reinterpret_cast<const __m128i*>(hashing::stripe_key) + i);
+				const __m128i keyed = _mm_xor_si128(data, key);
+
+				// low half of every keyed lane times its high half, plus the neighbouring lane's data
+				const __m128i product = _mm_mul_epu32(keyed, _mm_srli_epi64(keyed, 32));
+				const __m128i swapped = _mm_shuffle_epi32(data, _MM_SHUFFLE(1, 0, 3, 2));
+
+				lanes[i] = _mm_add_epi64(lanes[i], _mm_add_epi64(product, swapped));
+			}
+		}
+
+		SSE41 void hash_scramble(__m128i (&lanes)[4])
+		{
+			const __m128i prime = _mm_set1_epi32(static_cast<int>(hashing::prime32_1));
+
+			for (int i = 0; i < 4; i++)
+			{
+				const __m128i key = _mm_loadu_si128(reinterpret_cast<const __m128i*>(hashing::scramble_key) + i);
+				const __m128i lane = _mm_xor_si128(_mm_xor_si128(lanes[i], _mm_srli_epi64(lanes[i], 47)), key);
+
+				// 64 x 32 bit multiply out of two 32 x 32 bit ones
+				const __m128i low = _mm_mul_epu32(lane, prime);
+				const __m128i high = _mm_mul_epu32(_mm_srli_epi64(lane, 32), prime);
+
+				lanes[i] = _mm_add_epi64(low, _mm_slli_epi64(high, 32));
+			}
+		}
+	}
+
+	SSE41 void hdr_to_bgra8_sse41(
+		const void* src, size_t src_pitch,
+		void* dest, size_t dest_pitch,
+		int width, int height, float white_level
+	)
+	{
+		const __m128 inv_scale = _mm_set1_ps(80.0f / white_level);
+		const int body = width & ~3;
+		const int tail = width - body;
+
+		for (int y = 0; y < height; y++)
+		{
+			const auto* in = reinterpret_cast<const uint16_t*>(static_cast<const uint8_t*>(src) + src_pitch * y);
+			auto* out = static_cast<uint8_t*>(dest) + dest_pitch * y;
+
+			for (int x = 0; x < body; x += 4)
+			{
+				const __m128i px = pack(tone(decode(load(in + x * 4), inv_scale)));
+				_mm_storeu_si128(reinterpret_cast<__m128i*>(out + x * 4), px);
+			}
+
+			if (tail)
+			{
+				uint16_t in_tail[4 * 4] = {};
+				uint8_t out_tail[4 * 4];
+
+				std::memcpy(in_tail, in + body * 4, tail * 8);
+				const __m128i px = pack(tone(decode(load(in_tail), inv_scale)));
+				_mm_storeu_si128(reinterpret_cast<__m128i*>(out_tail), px);
+				std::memcpy(out + body * 4, out_tail, tail * 4);
+			}
+		}
+	}
+
+	SSE41 void hdr_to_bgra8_lut_sse41(
+		const void* src, size_t src_pitch,
+		void* dest, size_t dest_pitch,
+		int width, int height, const float* lut
+	)
+	{
+		const int body = width & ~3;
+		const int tail = width - body;
+
+		for (int y = 0; y < height; y++)
+		{
+			const auto* in = reinterpret_cast<const uint16_t*>(static_cast<const uint8_t*>(src) + src_pitch * y);
+			auto* out = static_cast<uint8_t*>(dest) + dest_pitch * y;
+
+			for (int x = 0; x < body; x += 4)
+			{
+				const __m128i px = pack(tone(lookup(in + x * 4, lut)));
+				_mm_storeu_si128(reinterpret_cast<__m128i*>(out + x * 4), px);
+			}
+
+			if (tail)
+			{
+				uint16_t in_tail[4 * 4] = {};
+				uint8_t out_tail[4 * 4];
+
+				std::memcpy(in_tail, in + body * 4, tail * 8);
+				const __m128i px = pack(tone(lookup(in_tail, lut)));
+				_mm_storeu_si128(reinterpret_cast<__m128i*>(out_tail), px);
+				std::memcpy(out + body * 4, out_tail, tail * 4);
+			}
+		}
+	}
+
+	SSE41 void sdr_to_bgra8_sse41(
+		const void* src, size_t src_pitch,
+		void* dest, size_t dest_pitch,
+		int width, int height
+	)
+	{
+		const __m128i order = _mm_setr_epi8(2, 1, 0, 3, 6, 5, 4, 7, 10, 9, 8, 11, 14, 13, 12, 15);
+		const __m128i alpha = _mm_set1_epi32(static_cast<int>(0xff000000));
+		const int body = width & ~3;
+		const int tail = width - body;
+
+		for (int y = 0; y < height; y++)
+		{
+			const auto* in = static_cast<const uint8_t*>(src) + src_pitch * y;
+			auto* out = static_cast<uint8_t*>(dest) + dest_pitch * y;
+
+			for (int x = 0; x < body; x += 4)
+			{
+				const __m128i px = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + x * 4));
+				_mm_storeu_si128(reinterpret_cast<__m128i*>(out + x * 4), _mm_or_si128(_mm_shuffle_epi8(px, order), alpha));
+			}
+
+			if (tail)
+				sdr_to_bgra8(in + body * 4, src_pitch, out + body * 4, dest_pitch, tail, 1);
+		}
+	}
+
+	SSE41 void rotate_bgra8_sse41(
+		const void* src, size_t src_pitch,
+		void* dest, size_t dest_pitch,
+		int width, int height, int rotation
+	)
+	{
+		const auto* in = static_cast<const uint8_t*>(src);
+		auto* out = static_cast<uint8_t*>(dest);
+
+		switch (rotation)
+		{
+		case 90:
+			rotate_tiles<90>(in, src_pitch, out, dest_pitch, width, height);
+			break;
+		case 180:
+			rotate_tiles<180>(in, src_pitch, out, dest_pitch, width, height);
+			break;
+		case 270:
+			rotate_tiles<270>(in, src_pitch, out, dest_pitch, width, height);
+			break;
+		default:
+			rotate_bgra8(src, src_pitch, dest, dest_pitch, width, height, rotation);
+			break;
+		}
+	}
+
+	SSE41 uint64_t hash_rows_sse41(const void* src, size_t pitch, size_t row_bytes, int height)
+	{
+		__m128i lanes[4];
+		for (int i = 0; i < 4; i++)
+			lanes[i] = _mm_loadu_si128(reinterpret_cast<const __m128i*>(hashing::initial_lanes) + i);
+
+		const size_t stripes = row_bytes / hashing::stripe_bytes;
+		const size_t tail = row_bytes % hashing::stripe_bytes;
+
+		for (int y = 0; y < height; y++)
+		{
+			const auto* row = static_cast<const uint8_t*>(src) + pitch * y;
+
+			for (size_t s = 0; s < stripes; s++)
+				hash_stripe(lanes, row + s * hashing::stripe_bytes);
+
+			if (tail)
+			{
+				uint8_t last[hashing::stripe_bytes] = {};
+				std::memcpy(last, row + stripes * hashing::stripe_bytes, tail);
+				hash_stripe(lanes, last);
+			}
+
+			hash_scramble(lanes);
+		}
+
+		uint64_t result[8];
+		for (int i = 0; i < 4; i++)
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(result) + i, lanes[i]);
+
+		return hash_merge(result, static_cast<uint64_t>(row_bytes) * height);
+	}
+
+	SSE41 void copy_rows_sse41(const void* src, size_t src_pitch, void* dest, size_t dest_pitch, size_t row_bytes, int height)
+	{
+		if (height <= 0)
+			return;
+
+		// rows packed on both sides are one long row
+		if (src_pitch == row_bytes && dest_pitch == row_bytes)
+		{
+			row_bytes *= height;
+			height = 1;
+		}
+
+		for (int y = 0; y < height; y++)
+		{
+			const auto* in = static_cast<const uint8_t*>(src) + src_pitch * y;
+			auto* out = static_cast<uint8_t*>(dest) + dest_pitch * y;
+
+			// plain stores up to the alignment streaming stores need, then two cache lines at a time
+			size_t x = std::min(row_bytes, static_cast<size_t>((16 - (reinterpret_cast<uintptr_t>(out) & 15)) & 15));
+			std::memcpy(out, in, x);
+
+			for (; x + 128 <= row_bytes; x += 128)
+			{
+				const __m128i v0 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + x + 0));
+				const __m128i v1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + x + 16));
+				const __m128i v2 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + x + 32));
+				const __m128i v3 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + x + 48));
+				const __m128i v4 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + x + 64));
+				const __m128i v5 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + x + 80));
+				const __m128i v6 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + x + 96));
+				const __m128i v7 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + x + 112));
+
+				_mm_stream_si128(reinterpret_cast<__m128i*>(out + x + 0), v0);
+				_mm_stream_si128(reinterpret_cast<__m128i*>(out + x + 16), v1);
+				_mm_stream_si128(reinterpret_cast<__m128i*>(out + x + 32), v2);
+				_mm_stream_si128(reinterpret_cast<__m128i*>(out + x + 48), v3);
+				_mm_stream_si128(reinterpret_cast<__m128i*>(out + x + 64), v4);
+				_mm_stream_si128(reinterpret_cast<__m128i*>(out + x + 80), v5);
+				_mm_stream_si128(reinterpret_cast<__m128i*>(out + x + 96), v6);
+				_mm_stream_si128(reinterpret_cast<__m128i*>(out + x + 112), v7);
+			}
+
+			std::memcpy(out + x, in + x, row_bytes - x);
+		}
+
+		_mm_sfence();
+	}
+}
+
+#else
+
+namespace tonemap
+{
+	void hdr_to_bgra8_sse41(
+		const void* src, size_t src_pitch,
+		void* dest, size_t dest_pitch,
+		int width, int height, float white_level
+	)
+	{
+		hdr_to_bgra8(src, src_pitch, dest, dest_pitch, width, height, white_level);
+	}
+
+	void hdr_to_bgra8_lut_sse41(
+		const void* src, size_t src_pitch,
+		void* dest, size_t dest_pitch,
+		int width, int height, const float* lut
+	)
+	{
+		hdr_to_bgra8_lut(src, src_pitch, dest, dest_pitch, width, height, lut);
+	}
+
+	void sdr_to_bgra8_sse41(
+		const void* src, size_t src_pitch,
+		void* dest, size_t dest_pitch,
+		int width, int height
+	)
+	{
+		sdr_to_bgra8(src, src_pitch, dest, dest_pitch, width, height);
+	}
+
+	void rotate_bgra8_sse41(
+		const void* src, size_t src_pitch,
+		void* dest, size_t dest_pitch,
+		int width, int height, int rotation
+	)
+	{
+		rotate_bgra8(src, src_pitch, dest, dest_pitch, width, height, rotation);
+	}
+
+	uint64_t hash_rows_sse41(const void* src, size_t pitch, size_t row_bytes, int height)
+	{
+		return hash_rows(src, pitch, row_bytes, height);
+	}
+
+	void copy_rows_sse41(const void* src, size_t src_pitch, void* dest, size_t dest_pitch, size_t row_bytes, int height)
+	{
+		copy_rows(src, src_pitch, dest, dest_pitch, row_bytes, height);
+	}
+}
+
+#endif
@@ -0,0 +1,158 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+
+#include "tonemap.hpp"
+
+// ISA specific versions of the frame functions in tonemap.hpp, same arguments.
+// The caller is responsible for checking the cpu supports them.
+namespace tonemap
+{
+	enum class tone_operator;
+	class cube_lut;
+
+	// 4 pixels per iteration, needs sse4.1 only so halves are decoded in integer math
+	void hdr_to_bgra8_sse41(
+		const void* src, size_t src_pitch,
+		void* dest, size_t dest_pitch,
+		int width, int height, float white_level
+	);
+
+	// 8 pixels per iteration, needs avx2, fma and f16c.
+	// pow and the divisions in neutral() are polynomial / rcp approximations,
+	// measured against hdr_to_bgra8 at max 1 step per 8 bit channel with
+	// under 0.01% of channels off by one (white levels 80 to 480 nits).
+	// The exception is luma landing within rounding of the 0.8 blend edge,
+	// where the discontinuous blend in main() can go either way; seen at
+	// about 1 in 1.5M random pixels, up to 16 steps. Any kernel that isn't bit
+	// exact with the reference, the gpu included, has the same edge.
+	//
+	// The avx2 and avx512 kernels decode, tonemap and pack each pixel in one
+	// pass and switch to streaming stores when should_stream() says so
+	void hdr_to_bgra8_avx2(
+		const void* src, size_t src_pitch,
+		void* dest, size_t dest_pitch,
+		int width, int height, float white_level
+	);
+
+	// 16 pixels per iteration, needs avx512f on top of the avx2 set.
+	// Row ends are handled with masked loads and stores, no cleanup loop
+	void hdr_to_bgra8_avx512(
+		const void* src, size_t src_pitch,
+		void* dest, size_t dest_pitch,
+		int width, int height, float white_level
+	);
+
+	// hdr_to_bgra8_lut per isa, the table replaces all of the pow work so these
+	// match the scalar reference up to the rcp approximations in the tone stage
+	void hdr_to_bgra8_lut_sse41(
+		const void* src, size_t src_pitch,
+		void* dest, size_t dest_pitch,
+		int width, int height, const float* lut
+	);
+
+	void hdr_to_bgra8_lut_avx2(
+		const void* src, size_t src_pitch,
+		void* dest, size_t dest_pitch,
+		int width, int height, const float* lut
+	);
+
+	void hdr_to_bgra8_lut_avx512(
+		const void* src, size_t src_pitch,
+		void* dest, size_t dest_pitch,
+		int width, int height, const float* lut
+	);
+
+	// hdr_to_bgra8_cube, six gathers from the half tables per 8 pixels and twelve more
+	// from the grid when any of them is past the blend edge. avx512 machines use it too
+	void hdr_to_bgra8_cube_avx2(
+		const void* src, size_t src_pitch,
+		void* dest, size_t dest_pitch,
+		int width, int height, const cube_lut& lut
+	);
+
+	// sdr_to_bgra8 as one byte shuffle and an or per 4 / 8 pixels, memory bound
+	// from avx2 on so avx512 machines use the avx2 one
+	void sdr_to_bgra8_sse41(
+		const void* src, size_t src_pitch,
+		void* dest, size_t dest_pitch,
+		int width, int height
+	);
+
+	void sdr_to_bgra8_avx2(
+		const void* src, size_t src_pitch,
+		void* dest, size_t dest_pitch,
+		int width, int height
+	);
+
+	// the other operators in operators.hpp, 8 pixels per iteration with the same
+	// polynomial pow as hdr_to_bgra8_avx2, avx512 machines use these too
+	void hdr_to_bgra8_reinhard_avx2(
+		const void* src, size_t src_pitch,
+		void* dest, size_t dest_pitch,
+		int width, int height, float white_level
+	);
+
+	void hdr_to_bgra8_hable_avx2(
+		const void* src, size_t src_pitch,
+		void* dest, size_t dest_pitch,
+		int width, int height, float white_level
+	);
+
+	void hdr_to_bgra8_aces_avx2(
+		const void* src, size_t src_pitch,
+		void* dest, size_t dest_pitch,
+		int width, int height, float white_level
+	);
+
+	void hdr_to_bgra8_bt2390_avx2(
+		const void* src, size_t src_pitch,
+		void* dest, size_t dest_pitch,
+		int width, int height, float white_level
+	);
+
+	void hdr_to_bgra8_agx_avx2(
+		const void* src, size_t src_pitch,
+		void* dest, size_t dest_pitch,
+		int width, int height, float white_level
+	);
+
+	// pq10_to_bgra8 in pq10.hpp, three gathers from the eotf table per 8 pixels and
+	// then the same operator math as the fp16 kernels
+	void pq10_to_bgra8_avx2(
+		const void* src, size_t src_pitch,
+		void* dest, size_t dest_pitch,
+		int width, int height, float white_level, tone_operator op
+	);
+
+	// rotate_bgra8 in rotate.hpp through 4x4 / 8x8 register transposes, block by block
+	// inside 32x32 pixel tiles so both sides stay in l1. avx512 machines use the avx2 one
+	void rotate_bgra8_sse41(
+		const void* src, size_t src_pitch,
+		void* dest, size_t dest_pitch,
+		int width, int height, int rotation
+	);
+
+	void rotate_bgra8_avx2(
+		const void* src, size_t src_pitch,
+		void* dest, size_t dest_pitch,
+		int width, int height, int rotation
+	);
+
+	// histogram_rows in histogram.hpp, bins for 8 pixels from the float bits in
+	// registers, counted into 4 interleaved copies
+	void histogram_rows_avx2(
+		const void* src, size_t pitch,
+		int width, int height, input_format format, uint64_t* bins
+	);
+
+	// hash_rows in tile_hash.hpp with the 8 lanes in 4 / 2 registers, same results.
+	// avx512 machines use the avx2 one
+	uint64_t hash_rows_sse41(const void* src, size_t pitch, size_t row_bytes, int height);
+	uint64_t hash_rows_avx2(const void* src, size_t pitch, size_t row_bytes, int height);
+
+	// copy_rows in copy.hpp through streaming stores, the destination aligned with plain
+	// ones first. avx512 machines use the avx2 one
+	void copy_rows_sse41(const void* src, size_t src_pitch, void* dest, size_t dest_pitch, size_t row_bytes, int height);
+	void copy_rows_avx2(const void* src, size_t src_pitch, void* dest, size_t dest_pitch, size_t row_bytes, int height);
+}
@@ -0,0 +1,214 @@
+#include <cmath>
+#include <cstring>
+#include <algorithm>
+
+#include "tonemap.hpp"
+#include "operators.hpp"
+
+namespace tonemap
+{
+	namespace
+	{
+		const char* const names[tone_operator_count] =
+		{
+			"blend",
+			"reinhard",
+			"hable",
+			"aces",
+			"bt2390",
+			"agx",
+		};
+
+		float3 scale(float3 c, float s)
+		{
+			return { c.r * s, c.g * s, c.b * s };
+		}
+
+		float3 transform(const float m[3][3], float3 c)
+		{
+			return {
+				m[0][0] * c.r + m[0][1] * c.g + m[0][2] * c.b,
+				m[1][0] * c.r + m[1][1] * c.g + m[1][2] * c.b,
+				m[2][0] * c.r + m[2][1] * c.g + m[2][2] * c.b,
+			};
+		}
+
+		float hable_curve(float x)
+		{
+			const auto [a, b, c, d, e, f] = curves::hable_abcdef;
+			return (x * (a * x + c * b) + d * e) / (x * (a * x + b) + d * f) - e / f;
+		}
+
+		float rrt_odt_fit(float v)
+		{
+			const float a = v * (v + 0.0245786f) - 0.000090537f;
+			const float b = v * (0.983729f * v + 0.4329510f) + 0.238081f;
+			return a / b;
+		}
+
+		float agx_sigmoid(float x)
+		{
+			float p = curves::agx_contrast[0];
+			for (int i = 1; i < 7; i++)
+				p = p * x + curves::agx_contrast[i];
+
+			return p;
+		}
+	}
+
+	const char* operator_name(tone_operator op)
+	{
+		const auto index = static_cast<int>(op);
+		return index >= 0 && index < tone_operator_count ? names[index] : "unknown";
+	}
+
+	bool find_operator(const char* name, tone_operator& op)
+	{
+		if (!name)
+			return false;
+
+		for (int i = 0; i < tone_operator_count; i++)
+		{
+			if (std::strcmp(name, names[i]) == 0)
+			{
+				op = static_cast<tone_operator>(i);
+				return true;
+			}
+		}
+
+		return false;
+	}
+
+	float pq_encode(float y)
+	{
+		using namespace curves;
+
+		const float p = std::pow(std::max(y, 0.0f), pq_m1);
+		return std::pow((pq_c1 + pq_c2 * p) / (1.0f + pq_c3 * p), pq_m2);
+	}
+
+	float pq_decode(float e)
+	{
+		using namespace curves;
+
+		const float p = std::pow(std::max(e, 0.0f), 1.0f / pq_m2);
+		return std::pow(std::max(p - pq_c1, 0.0f) / (pq_c2 - pq_c3 * p), 1.0f / pq_m1);
+	}
+
+	float3 reinhard(float3 x, float white_level)
+	{
+		// L * (1 + L / Lw^2) / (1 + L) applied as a ratio so black needs no special case
+		const float white = 10000.0f / white_level;
+		const float l = rgb_to_luma(x);
+
+		return bt2020_inv_gamma(scale(x, (1.0f + l / (white * white)) / (1.0f + l)));
+	}
+
+	float3 hable(float3 x)
+	{
+		const float bias = curves::hable_exposure_bias;
+		const float inv_white = 1.0f / hable_curve(curves::hable_white);
+
+		return bt2020_inv_gamma({
+			hable_curve(x.r * bias) * inv_white,
+			hable_curve(x.g * bias) * inv_white,
+			hable_curve(x.b * bias) * inv_white,
+		});
+	}
+
+	float3 aces_fitted(float3 x)
+	{
+		float3 c = transform(curves::aces_input, x);
+		c = { rrt_odt_fit(c.r), rrt_odt_fit(c.g), rrt_odt_fit(c.b) };
+		c = transform(curves::aces_output, c);
+
+		return bt2020_inv_gamma({ saturate(c.r), saturate(c.g), saturate(c.b) });
+	}
+
+	float3 bt2390(float3 x, float white_level)
+	{
+		const float peak = std::max(x.r, std::max(x.g, x.b));
+		const float max_lum = pq_encode(white_level / 10000.0f);
+		const float knee = 1.5f * max_lum - 0.5f;
+
+		const float e1 = pq_encode(peak * white_level / 10000.0f);
+		float ratio = 1.0f;
+
+		if (e1 > knee)
+		{
+			const float t = (e1 - knee) / (1.0f - knee);
+			const float t2 = t * t;
+			const float t3 = t2 * t;
+
+			const float e2 = (2.0f * t3 - 3.0f * t2 + 1.0f) * knee
+				+ (t3 - 2.0f * t2 + t) * (1.0f - knee)
+				+ (-2.0f * t3 + 3.0f * t2) * max_lum;
+
+			ratio = pq_decode(e2) * 10000.0f / white_level / peak;
+		}
+
+		return bt2020_inv_gamma(scale(x, ratio));
+	}
+
+	float3 agx(float3 x)
+	{
+		using namespace curves;
+
+		auto encode = [](float v) {
+			const float ev = std::clamp(std::log2(std::max(v, 1e-10f)), agx_min_ev, agx_max_ev);
+			return agx_sigmoid((ev - agx_min_ev) / (agx_max_ev - agx_min_ev));
+		};
+
+		const float3 c = transform(agx_inset, x);
+		return transform(agx_outset, { encode(c.r), encode(c.g), encode(c.b) });
+	}
+
+	float3 tone_pixel(tone_operator op, float3 src, float white_level)
+	{
+		if (op == tone_operator::blend)
+			return hdr_pixel(src, white_level);
+
+		const float3 x = {
+			hdr_linear(src.r, white_level),
+			hdr_linear(src.g, white_level),
+			hdr_linear(src.b, white_level),
+		};
+
+		switch (op)
+		{
+		case tone_operator::reinhard:
+			return reinhard(x, white_level);
+		case tone_operator::hable:
+			return hable(x);
+		case tone_operator::aces:
+			return aces_fitted(x);
+		case tone_operator::bt2390:
+			return bt2390(x, white_level);
+		default:
+			return agx(x);
+		}
+	}
+
+	void hdr_to_bgra8(
+		const void* src, size_t src_pitch,
+		void* dest, size_t dest_pitch,
+		int width, int height, float white_level, tone_operator op
+	)
+	{
+		for (int y = 0; y < height; y++)
+		{
+			const auto* in = reinterpret_cast<const uint16_t*>(static_cast<const uint8_t*>(src) + src_pitch * y);
+			auto* out = static_cast<uint8_t*>(dest) + dest_pitch * y;
+
+			for (int x = 0; x < width; x++, in += 4, out += 4)
+			{
+				const float3 color = tone_pixel(op, { half_to_float(in[0]), half_to_float(in[1]), half_to_float(in[2]) }, white_level);
+
+				out[0] = to_unorm8(color.b);
+				out[1] = to_unorm8(color.g);
+				out[2] = to_unorm8(color.r);
+				out[3] = 0xff;
+			}
+		}
+	}
+}
@@ -0,0 +1,111 @@
+#pragma once
+#include <cstddef>
+
+#include "tonemap.hpp"
+
+namespace tonemap
+{
+	// hdr tone mapping operators, blend is the linear / neutral mix main() in
+	// tonemapper.hlsl was written with. Values match TONEMAP_OPERATOR in the shader
+	enum class tone_operator
+	{
+		blend,
+		reinhard,
+		hable,
+		aces,
+		bt2390,
+		agx,
+	};
+
+	inline constexpr int tone_operator_count = 6;
+
+	const char* operator_name(tone_operator op);
+
+	// case sensitive match against operator_name, false if nothing matches
+	bool find_operator(const char* name, tone_operator& op);
+
+	// the operators take linear scRGB scaled so 1 is the sdr white level, see
+	// hdr_linear, and return display referred values ready for to_unorm8.
+	// Except for blend they work on linear light and encode at the end
+
+	// extended reinhard on luminance, the 10000 nit input peak maps to white
+	float3 reinhard(float3 x, float white_level);
+
+	// hable's uncharted 2 curve per channel, exposure bias 2, white point 11.2
+	float3 hable(float3 x);
+
+	// hill's fit of the aces rrt + srgb odt with its input and output matrices
+	float3 aces_fitted(float3 x);
+
+	// bt.2390 eetf on max(r, g, b) in pq space, mapping the 10000 nit range onto
+	// the sdr white level with a hermite knee, hue kept by scaling all channels
+	float3 bt2390(float3 x, float white_level);
+
+	// agx base look: inset matrix, log2 encoding over [-12.47, 4.03] ev, the
+	// sigmoid polynomial approximation, outset matrix
+	float3 agx(float3 x);
+
+	// scRGB in, display referred out through op
+	float3 tone_pixel(tone_operator op, float3 src, float white_level);
+
+	// hdr_to_bgra8 through op, blend gives the same result as hdr_to_bgra8
+	void hdr_to_bgra8(
+		const void* src, size_t src_pitch,
+		void* dest, size_t dest_pitch,
+		int width, int height, float white_level, tone_operator op
+	);
+
+	// st 2084, nits / 10000 to signal and back
+	float pq_encode(float y);
+	float pq_decode(float e);
+}
+
+// constants shared by the scalar and simd versions of the operators
+namespace tonemap::curves
+{
+	// st 2084
+	inline constexpr float pq_m1 = 0.1593017578125f;
+	inline constexpr float pq_m2 = 78.84375f;
+	inline constexpr float pq_c1 = 0.8359375f;
+	inline constexpr float pq_c2 = 18.8515625f;
+	inline constexpr float pq_c3 = 18.6875f;
+
+	// a to f of (x * (a * x + c * b) + d * e) / (x * (a * x + b) + d * f) - e / f
+	inline constexpr float hable_abcdef[6] = { 0.15f, 0.50f, 0.10f, 0.20f, 0.02f, 0.30f };
+	inline constexpr float hable_exposure_bias = 2.0f;
+	inline constexpr float hable_white = 11.2f;
+
+	inline constexpr float aces_input[3][3] =
+	{
+		{ 0.59719f, 0.35458f, 0.04823f },
+		{ 0.07600f, 0.90834f, 0.01566f },
+		{ 0.02840f, 0.13383f, 0.83777f },
+	};
+
+	inline constexpr float aces_output[3][3] =
+	{
+		{ 1.60475f, -0.53108f, -0.07367f },
+		{ -0.10208f, 1.10813f, -0.00605f },
+		{ -0.00327f, -0.07276f, 1.07602f },
+	};
+
+	inline constexpr float agx_inset[3][3] =
+	{
+		{ 0.842479062253094f, 0.0784335999999992f, 0.0792237451477643f },
+		{ 0.0423282422610123f, 0.878468636469772f, 0.0791661274605434f },
+		{ 0.0423756549057051f, 0.0784336f, 0.879142973793104f },
+	};
+
+	inline constexpr float agx_outset[3][3] =
+	{
+		{ 1.19687900512017f, -0.0980208811401368f, -0.0990297440797205f },
+		{ -0.0528968517574562f, 1.15190312990417f, -0.0989611768448433f },
+		{ -0.0529716355144438f, -0.0980434501171241f, 1.15107367264116f },
+	};
+
+	inline constexpr float agx_min_ev = -12.47393f;
+	inline constexpr float agx_max_ev = 4.026069f;
+
+	// sigmoid approximation, highest power first
+	inline constexpr float agx_contrast[7] = { 15.5f, -40.14f, 31.96f, -6.868f, 0.4298f, 0.1191f, -0.00232f };
+}
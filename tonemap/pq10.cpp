@@ -0,0 +1,65 @@
+#include <array>
+
+#include "tonemap.hpp"
+#include "operators.hpp"
+#include "pq10.hpp"
+
+namespace tonemap
+{
+	namespace
+	{
+		std::array<float, pq_eotf_size> build_eotf()
+		{
+			std::array<float, pq_eotf_size> table;
+
+			for (int i = 0; i < pq_eotf_size; i++)
+				table[i] = pq_decode(static_cast<float>(i) / (pq_eotf_size - 1)) * (10000.0f / 80.0f);
+
+			return table;
+		}
+	}
+
+	const float* pq_eotf_table()
+	{
+		static const auto table = build_eotf();
+		return table.data();
+	}
+
+	float3 pq10_to_scrgb(uint32_t pixel)
+	{
+		const float* eotf = pq_eotf_table();
+		const float r = eotf[pixel & 0x3ff];
+		const float g = eotf[(pixel >> 10) & 0x3ff];
+		const float b = eotf[(pixel >> 20) & 0x3ff];
+
+		const auto& m = curves::bt2020_to_bt709;
+		return {
+			m[0][0] * r + m[0][1] * g + m[0][2] * b,
+			m[1][0] * r + m[1][1] * g + m[1][2] * b,
+			m[2][0] * r + m[2][1] * g + m[2][2] * b,
+		};
+	}
+
+	void pq10_to_bgra8(
+		const void* src, size_t src_pitch,
+		void* dest, size_t dest_pitch,
+		int width, int height, float white_level, tone_operator op
+	)
+	{
+		for (int y = 0; y < height; y++)
+		{
+			const auto* in = reinterpret_cast<const uint32_t*>(static_cast<const uint8_t*>(src) + src_pitch * y);
+			auto* out = static_cast<uint8_t*>(dest) + dest_pitch * y;
+
+			for (int x = 0; x < width; x++, out += 4)
+			{
+				const float3 color = tone_pixel(op, pq10_to_scrgb(in[x]), white_level);
+
+				out[0] = to_unorm8(color.b);
+				out[1] = to_unorm8(color.g);
+				out[2] = to_unorm8(color.r);
+				out[3] = 0xff;
+			}
+		}
+	}
+}
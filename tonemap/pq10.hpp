@@ -0,0 +1,38 @@
+#pragma once
+#include <cstdint>
+#include <cstddef>
+
+#include "tonemap.hpp"
+
+namespace tonemap
+{
+	enum class tone_operator;
+
+	// 10 bit pq input, decoded to the same scRGB the fp16 path gets and tone mapped from there
+
+	inline constexpr int pq_eotf_size = 1024;
+
+	// st 2084 eotf per 10 bit code in scRGB units (nits / 80), built on first use
+	const float* pq_eotf_table();
+
+	// one R10G10B10A2_UNORM pixel to scRGB: eotf table per channel, then bt.2020 to
+	// bt.709 primaries. Colors outside bt.709 come out negative like in fp16 frames
+	float3 pq10_to_scrgb(uint32_t pixel);
+
+	// hdr_to_bgra8 with R10G10B10A2_UNORM rows in
+	void pq10_to_bgra8(
+		const void* src, size_t src_pitch,
+		void* dest, size_t dest_pitch,
+		int width, int height, float white_level, tone_operator op
+	);
+}
+
+namespace tonemap::curves
+{
+	inline constexpr float bt2020_to_bt709[3][3] =
+	{
+		{ 1.660491f, -0.587641f, -0.072850f },
+		{ -0.124550f, 1.132900f, -0.008349f },
+		{ -0.018151f, -0.100579f, 1.118730f },
+	};
+}
@@ -0,0 +1,53 @@
+#include <algorithm>
+
+#include "rect.hpp"
+
+namespace tonemap
+{
+	rect intersect(const rect& a, const rect& b)
+	{
+		const rect r = {
+			std::max(a.left, b.left),
+			std::max(a.top, b.top),
+			std::min(a.right, b.right),
+			std::min(a.bottom, b.bottom),
+		};
+
+		return r.empty() ? rect{} : r;
+	}
+
+	rect offset(const rect& r, int x, int y)
+	{
+		return { r.left + x, r.top + y, r.right + x, r.bottom + y };
+	}
+
+	rect rotate(const rect& r, int rotation, int width, int height)
+	{
+		switch (rotation)
+		{
+		case 90:
+			return { height - r.bottom, r.left, height - r.top, r.right };
+		case 180:
+			return { width - r.right, height - r.bottom, width - r.left, height - r.top };
+		case 270:
+			return { r.top, width - r.right, r.bottom, width - r.left };
+		default:
+			return r;
+		}
+	}
+
+	rect unrotate(const rect& r, int rotation, int width, int height)
+	{
+		switch (rotation)
+		{
+		case 90:
+			return { r.top, height - r.right, r.bottom, height - r.left };
+		case 180:
+			return { width - r.right, height - r.bottom, width - r.left, height - r.top };
+		case 270:
+			return { width - r.bottom, r.left, width - r.top, r.right };
+		default:
+			return r;
+		}
+	}
+}
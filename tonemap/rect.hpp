@@ -0,0 +1,45 @@
+#pragma once
+
+namespace tonemap
+{
+	// [left, right) x [top, bottom) in pixels, empty when either side has no pixels
+	struct rect
+	{
+		int left;
+		int top;
+		int right;
+		int bottom;
+
+		int width() const
+		{
+			return right - left;
+		}
+
+		int height() const
+		{
+			return bottom - top;
+		}
+
+		bool empty() const
+		{
+			return left >= right || top >= bottom;
+		}
+
+		bool operator==(const rect&) const = default;
+	};
+
+	// the overlap of a and b, empty when they don't overlap
+	rect intersect(const rect& a, const rect& b);
+
+	// r moved by (x, y)
+	rect offset(const rect& r, int x, int y);
+
+	// where r of a width x height frame ends up once the frame is rotated by rotation
+	// degrees like calc_dest_pos in the shader, relative to the rotated frame
+	rect rotate(const rect& r, int rotation, int width, int height);
+
+	// rotate backwards: r given relative to the rotated frame, returned in the
+	// coordinates of the width x height frame before rotating. r doesn't have to lie
+	// inside the frame, intersect the result with it to clip
+	rect unrotate(const rect& r, int rotation, int width, int height);
+}
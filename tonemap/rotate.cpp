@@ -0,0 +1,49 @@
+#include <cstdint>
+#include <cstring>
+
+#include "rotate.hpp"
+
+namespace tonemap
+{
+	void rotate_bgra8(
+		const void* src, size_t src_pitch,
+		void* dest, size_t dest_pitch,
+		int width, int height, int rotation
+	)
+	{
+		for (int y = 0; y < height; y++)
+		{
+			const auto* in = static_cast<const uint8_t*>(src) + src_pitch * y;
+
+			if (rotation == 0)
+			{
+				std::memcpy(static_cast<uint8_t*>(dest) + dest_pitch * y, in, static_cast<size_t>(width) * 4);
+				continue;
+			}
+
+			for (int x = 0; x < width; x++)
+			{
+				const rect to = rotate({ x, y, x + 1, y + 1 }, rotation, width, height);
+				std::memcpy(static_cast<uint8_t*>(dest) + dest_pitch * to.top + 4 * static_cast<size_t>(to.left), in + 4 * static_cast<size_t>(x), 4);
+			}
+		}
+	}
+
+	void rotate_bgra8_rect(
+		const void* src, size_t src_pitch,
+		void* dest, size_t dest_pitch,
+		int width, int height, int rotation, const rect& area
+	)
+	{
+		if (area.empty())
+			return;
+
+		const rect to = rotate(area, rotation, width, height);
+
+		rotate_bgra8(
+			static_cast<const uint8_t*>(src) + src_pitch * area.top + 4 * static_cast<size_t>(area.left), src_pitch,
+			static_cast<uint8_t*>(dest) + dest_pitch * to.top + 4 * static_cast<size_t>(to.left), dest_pitch,
+			area.width(), area.height(), rotation
+		);
+	}
+}
@@ -0,0 +1,24 @@
+#pragma once
+#include <cstddef>
+
+#include "rect.hpp"
+
+namespace tonemap
+{
+	// width x height 32 bit pixels rotated by rotation degrees (0, 90, 180 or 270) into
+	// dest, which is height x width for 90 and 270. One pixel at a time
+	void rotate_bgra8(
+		const void* src, size_t src_pitch,
+		void* dest, size_t dest_pitch,
+		int width, int height, int rotation
+	);
+
+	// rotate_bgra8 for just the area of the image, written where it goes in the full
+	// rotated image, see rotate in rect.hpp. For the edges the simd kernels
+	// don't cover with whole blocks
+	void rotate_bgra8_rect(
+		const void* src, size_t src_pitch,
+		void* dest, size_t dest_pitch,
+		int width, int height, int rotation, const rect& area
+	);
+}
@@ -0,0 +1,28 @@
+#pragma once
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define TONEMAP_X86 1
+#include <immintrin.h>
+#else
+#define TONEMAP_X86 0
+#endif
+
+// msvc lets any function use any intrinsic, gcc and clang need it spelled out
+#if defined(_MSC_VER) && !defined(__clang__)
+#define TONEMAP_TARGET(isa)
+#else
+#define TONEMAP_TARGET(isa) __attribute__((target(isa)))
+#endif
+
+namespace tonemap::poly
+{
+	// log2(1 + t) / t for t in [-0.25, 0.5), abs error of t * P(t) < 5.4e-6
+	inline constexpr float log2_c[] = {
+		1.44269322f, -0.721167408f, 0.481062157f, -0.369448203f, 0.297643543f, -0.156237314f
+	};
+
+	// 2^f for f in [0, 1), rel error < 2.6e-6
+	inline constexpr float exp2_c[] = {
+		1.00000259f, 0.693003834f, 0.241442757f, 0.0520114603f, 0.0135341681f
+	};
+}
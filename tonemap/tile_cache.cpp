@@ -0,0 +1,178 @@
+#include <cstring>
+#include <algorithm>
+
+#include "tile_cache.hpp"
+
+namespace tonemap
+{
+	bool tile_cache::reset(int width, int height, const tile_cache_key& key)
+	{
+		if (width == width_ && height == height_ && key == key_)
+			return false;
+
+		// all of it is invalid, the old pixels don't have to survive
+		if (width != width_ || height != height_)
+		{
+			pixels_ = {};
+			pixels_ = frame_buffers().acquire(static_cast<size_t>(width) * height * 4);
+		}
+
+		width_ = width;
+		height_ = height;
+		columns_ = (width + tile_size - 1) / tile_size;
+		rows_ = (height + tile_size - 1) / tile_size;
+		key_ = key;
+
+		valid_.assign(static_cast<size_t>(columns_) * rows_, 0);
+		hashes_.assign(valid_.size(), 0);
+
+		return true;
+	}
+
+	void tile_cache::invalidate_all()
+	{
+		std::fill(valid_.begin(), valid_.end(), 0);
+	}
+
+	void tile_cache::invalidate(const rect& area)
+	{
+		const rect tiles = tiles_of(area);
+
+		for (int ty = tiles.top; ty < tiles.bottom; ty++)
+		{
+			for (int tx = tiles.left; tx < tiles.right; tx++)
+				valid_[static_cast<size_t>(ty) * columns_ + tx] = 0;
+		}
+	}
+
+	void tile_cache::move(int from_x, int from_y, const rect& to)
+	{
+		const rect frame = { 0, 0, width_, height_ };
+
+		// both sides clipped to the frame by the same amount
+		const rect dest = intersect(intersect(to, frame), offset(frame, to.left - from_x, to.top - from_y));
+		if (dest.empty())
+			return;
+
+		const int dx = from_x - to.left;
+		const int dy = from_y - to.top;
+
+		// validity worked out on the tiles as they were before any pixel moved
+		const rect tiles = tiles_of(dest);
+		std::vector<uint8_t> moved;
+		moved.reserve(static_cast<size_t>(tiles.width()) * tiles.height());
+
+		for (int ty = tiles.top; ty < tiles.bottom; ty++)
+		{
+			for (int tx = tiles.left; tx < tiles.right; tx++)
+			{
+				const rect tile = intersect({ tx * tile_size, ty * tile_size, (tx + 1) * tile_size, (ty + 1) * tile_size }, frame);
+				const rect got = intersect(tile, dest);
+
+				const bool was_valid = valid_[static_cast<size_t>(ty) * columns_ + tx] != 0;
+				const bool covered = got.left == tile.left && got.top == tile.top && got.right == tile.right && got.bottom == tile.bottom;
+
+				moved.push_back(all_valid(tiles_of(offset(got, dx, dy))) && (was_valid || covered));
+			}
+		}
+
+		// rows in the order that doesn't overwrite source rows still to be read
+		const size_t row_bytes = static_cast<size_t>(dest.width()) * 4;
+		const bool upwards = dy >= 0;
+
+		for (int i = 0; i < dest.height(); i++)
+		{
+			const int y = upwards ? dest.top + i : dest.bottom - 1 - i;
+			uint8_t* row = pixels_.data() + pitch() * y + 4 * static_cast<size_t>(dest.left);
+
+			std::memmove(row, row + static_cast<ptrdiff_t>(pitch()) * dy + 4 * static_cast<ptrdiff_t>(dx), row_bytes);
+		}
+
+		auto flag = moved.begin();
+		for (int ty = tiles.top; ty < tiles.bottom; ty++)
+		{
+			for (int tx = tiles.left; tx < tiles.right; tx++)
+			{
+				valid_[static_cast<size_t>(ty) * columns_ + tx] = *flag++;
+				hashes_[static_cast<size_t>(ty) * columns_ + tx] = 0;
+			}
+		}
+	}
+
+	std::vector<rect> tile_cache::invalid_runs(const rect& area) const
+	{
+		const rect tiles = tiles_of(area);
+		std::vector<rect> runs;
+
+		for (int ty = tiles.top; ty < tiles.bottom; ty++)
+		{
+			for (int tx = tiles.left; tx < tiles.right; tx++)
+			{
+				if (valid_[static_cast<size_t>(ty) * columns_ + tx])
+					continue;
+
+				const int first = tx;
+				while (tx + 1 < tiles.right && !valid_[static_cast<size_t>(ty) * columns_ + tx + 1])
+					tx++;
+
+				runs.push_back(intersect(
+					{ first * tile_size, ty * tile_size, (tx + 1) * tile_size, (ty + 1) * tile_size },
+					{ 0, 0, width_, height_ }
+				));
+			}
+		}
+
+		return runs;
+	}
+
+	uint64_t tile_cache::hash(const rect& tile) const
+	{
+		return hashes_[index_of(tile)];
+	}
+
+	void tile_cache::validate(const rect& tile, uint64_t hash)
+	{
+		const size_t index = index_of(tile);
+
+		valid_[index] = 1;
+		hashes_[index] = hash;
+	}
+
+	size_t tile_cache::invalid_count() const
+	{
+		return static_cast<size_t>(std::count(valid_.begin(), valid_.end(), 0));
+	}
+
+	rect tile_cache::tiles_of(const rect& area) const
+	{
+		const rect clipped = intersect(area, { 0, 0, width_, height_ });
+		if (clipped.empty())
+			return {};
+
+		return {
+			clipped.left / tile_size,
+			clipped.top / tile_size,
+			(clipped.right + tile_size - 1) / tile_size,
+			(clipped.bottom + tile_size - 1) / tile_size,
+		};
+	}
+
+	size_t tile_cache::index_of(const rect& tile) const
+	{
+		return static_cast<size_t>(tile.top / tile_size) * columns_ + tile.left / tile_size;
+	}
+
+	bool tile_cache::all_valid(const rect& tiles) const
+	{
+		for (int ty = tiles.top; ty < tiles.bottom; ty++)
+		{
+			for (int tx = tiles.left; tx < tiles.right; tx++)
+			{
+				if (!valid_[static_cast<size_t>(ty) * columns_ + tx])
+					return false;
+			}
+		}
+
+		return true;
+	}
+}
@@ -0,0 +1,99 @@
+#pragma once
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+
+#include "tonemap.hpp"
+#include "operators.hpp"
+#include "rect.hpp"
+#include "frame_arena.hpp"
+
+namespace tonemap
+{
+	// what the cached pixels were tone mapped with, any change invalidates all of them
+	struct tile_cache_key
+	{
+		input_format format;
+		tone_operator op;
+		float white_level;
+
+		bool operator==(const tile_cache_key&) const = default;
+	};
+
+	// one monitor's frame already converted to bgra8, in its unrotated orientation, kept
+	// across captures in tile_size square tiles. Desktop duplication's move rects are
+	// replayed on the cached pixels and its dirty rects invalidate the tiles they touch,
+	// so only those have to be read back. Every tile also remembers the hash_rows of the
+	// source pixels it was converted from: an invalid tile whose source hashes the same
+	// again needs no tone mapping, which covers dirty rects that are missing or too coarse
+	class tile_cache
+	{
+	public:
+		static constexpr int tile_size = 64;
+
+		// sizes the cache for a width x height frame tone mapped with key, everything
+		// is invalid afterwards if either differs from before. Returns true if it did
+		bool reset(int width, int height, const tile_cache_key& key);
+
+		void invalidate_all();
+
+		// tiles touching area become invalid
+		void invalidate(const rect& area);
+
+		// copies the cached pixels of (from_x, from_y) with the size of to onto to, the two
+		// may overlap. A tile of to stays or becomes valid only if all pixels it got were
+		// valid, and the rest of it too unless to covered all of it. Its hash is dropped
+		void move(int from_x, int from_y, const rect& to);
+
+		// invalid tiles touching area as runs of whole tiles along each row of tiles,
+		// clipped to the frame. Every tile of them gets validated once it's up to date
+		std::vector<rect> invalid_runs(const rect& area) const;
+
+		// hash of the source pixels the tile at (tile.left, tile.top) was last converted
+		// from, 0 when there is none: never converted, or pixels moved in since
+		uint64_t hash(const rect& tile) const;
+
+		// the tile at (tile.left, tile.top) becomes valid, converted from source pixels
+		// hashing to hash
+		void validate(const rect& tile, uint64_t hash);
+
+		size_t invalid_count() const;
+
+		uint8_t* data()
+		{
+			return pixels_.data();
+		}
+
+		size_t pitch() const
+		{
+			return static_cast<size_t>(width_) * 4;
+		}
+
+		int width() const
+		{
+			return width_;
+		}
+
+		int height() const
+		{
+			return height_;
+		}
+
+	private:
+		// the tiles touching area, in tile units
+		rect tiles_of(const rect& area) const;
+
+		size_t index_of(const rect& tile) const;
+
+		bool all_valid(const rect& tiles) const;
+
+		frame_arena::buffer pixels_;
+		std::vector<uint8_t> valid_;
+		std::vector<uint64_t> hashes_;
+		int width_ = 0;
+		int height_ = 0;
+		int columns_ = 0;
+		int rows_ = 0;
+		tile_cache_key key_ = {};
+	};
+}
@@ -0,0 +1,94 @@
+#include <cstring>
+
+#include "tile_hash.hpp"
+
+namespace tonemap
+{
+	namespace
+	{
+		using namespace hashing;
+
+		uint64_t read64(const uint8_t* p)
+		{
+			uint64_t v;
+			std::memcpy(&v, p, sizeof(v));
+			return v;
+		}
+
+		void accumulate(uint64_t (&lanes)[8], const uint8_t* stripe)
+		{
+			for (int i = 0; i < 8; i++)
+			{
+				const uint64_t data = read64(stripe + 8 * i);
+				const uint64_t keyed = data ^ stripe_key[i];
+
+				lanes[i ^ 1] += data;
+				lanes[i] += (keyed & 0xffffffffu) * (keyed >> 32);
+			}
+		}
+
+		void scramble(uint64_t (&lanes)[8])
+		{
+			for (int i = 0; i < 8; i++)
+			{
+				uint64_t lane = lanes[i];
+				lane ^= lane >> 47;
+				lane ^= scramble_key[i];
+				lanes[i] = lane * prime32_1;
+			}
+		}
+
+		uint64_t avalanche(uint64_t h)
+		{
+			h ^= h >> 37;
+			h *= 0x165667919E3779F9u;
+			return h ^ (h >> 32);
+		}
+
+		uint64_t rotl64(uint64_t v, int n)
+		{
+			return (v << n) | (v >> (64 - n));
+		}
+	}
+
+	uint64_t hash_rows(const void* src, size_t pitch, size_t row_bytes, int height)
+	{
+		uint64_t lanes[8];
+		std::memcpy(lanes, initial_lanes, sizeof(lanes));
+
+		const size_t stripes = row_bytes / stripe_bytes;
+		const size_t tail = row_bytes % stripe_bytes;
+
+		for (int y = 0; y < height; y++)
+		{
+			const auto* row = static_cast<const uint8_t*>(src) + pitch * y;
+
+			for (size_t s = 0; s < stripes; s++)
+				accumulate(lanes, row + s * stripe_bytes);
+
+			if (tail)
+			{
+				uint8_t last[stripe_bytes] = {};
+				std::memcpy(last, row + stripes * stripe_bytes, tail);
+				accumulate(lanes, last);
+			}
+
+			scramble(lanes);
+		}
+
+		return hash_merge(lanes, static_cast<uint64_t>(row_bytes) * height);
+	}
+
+	uint64_t hash_merge(const uint64_t (&lanes)[8], uint64_t length)
+	{
+		uint64_t h = length * prime64_1;
+
+		for (int i = 0; i < 8; i++)
+		{
+			const uint64_t lane = (lanes[i] ^ (lanes[i] >> 33)) * prime64_2;
+			h = rotl64(h ^ lane, 27) * prime64_1 + prime64_4;
+		}
+
+		return avalanche(h);
+	}
+}
@@ -0,0 +1,61 @@
+#pragma once
+#include <cstdint>
+#include <cstddef>
+
+namespace tonemap
+{
+	// xxh3 style 64 bit hash of height rows of row_bytes each, pitch apart. Every row is
+	// cut into 64 byte stripes, the last one zero padded, each mixed into 8 64 bit lanes
+	// with a 32 x 32 bit multiply and added to the neighbouring lane as is. The lanes are
+	// scrambled after each row so the same bytes in another shape hash differently.
+	// Not for anything adversarial, only to tell whether a tile changed
+	uint64_t hash_rows(const void* src, size_t pitch, size_t row_bytes, int height);
+
+	// folds the 8 lanes left after the last row and the byte count into the hash,
+	// shared by the simd versions of hash_rows
+	uint64_t hash_merge(const uint64_t (&lanes)[8], uint64_t length);
+}
+
+// constants shared by the scalar and simd versions of hash_rows
+namespace tonemap::hashing
+{
+	inline constexpr uint64_t prime32_1 = 0x9E3779B1u;
+	inline constexpr uint64_t prime32_2 = 0x85EBCA77u;
+	inline constexpr uint64_t prime32_3 = 0xC2B2AE3Du;
+	inline constexpr uint64_t prime64_1 = 0x9E3779B185EBCA87u;
+	inline constexpr uint64_t prime64_2 = 0xC2B2AE3D27D4EB4Fu;
+	inline constexpr uint64_t prime64_3 = 0x165667B19E3779F9u;
+	inline constexpr uint64_t prime64_4 = 0x85EBCA77C2B2AE63u;
+	inline constexpr uint64_t prime64_5 = 0x27D4EB2F165667C5u;
+
+	// the lanes before the first stripe, as in xxh3
+	inline constexpr uint64_t initial_lanes[8] =
+	{
+		prime32_3, prime64_1, prime64_2, prime64_3,
+		prime64_4, prime32_2, prime64_5, prime32_1,
+	};
+
+	constexpr uint64_t splitmix64(uint64_t i)
+	{
+		uint64_t z = (i + 1) * 0x9E3779B97F4A7C15u;
+		z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9u;
+		z = (z ^ (z >> 27)) * 0x94D049BB133111EBu;
+		return z ^ (z >> 31);
+	}
+
+	// xored into each stripe's lanes before the multiply
+	inline constexpr uint64_t stripe_key[8] =
+	{
+		splitmix64(0), splitmix64(1), splitmix64(2), splitmix64(3),
+		splitmix64(4), splitmix64(5), splitmix64(6), splitmix64(7),
+	};
+
+	// xored into the lanes when they're scrambled at the end of a row
+	inline constexpr uint64_t scramble_key[8] =
+	{
+		splitmix64(8), splitmix64(9), splitmix64(10), splitmix64(11),
+		splitmix64(12), splitmix64(13), splitmix64(14), splitmix64(15),
+	};
+
+	inline constexpr size_t stripe_bytes = 64;
+}
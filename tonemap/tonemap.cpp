@@ -0,0 +1,239 @@
+#include <cmath>
+#include <cstdlib>
+#include <algorithm>
+
+#include "tonemap.hpp"
+
+namespace tonemap
+{
+	namespace
+	{
+		float lerp(float x, float y, float s)
+		{
+			return x + s * (y - x);
+		}
+
+		float step(float edge, float x)
+		{
+			return x >= edge ? 1.0f : 0.0f;
+		}
+
+		float encode(float x)
+		{
+			return x > 0.00313066844250063f
+				? 1.055f * std::pow(std::clamp(x, 0.0f, 10000.0f), 1.0f / 2.4f) - 0.055f
+				: 12.92f * x;
+		}
+
+		float clamp_nits(float x)
+		{
+			// min / max on the gpu return the non nan operand, so nan inputs decode as 0
+			return x > 0.0f ? (x < 10000.0f ? x : 10000.0f) : 0.0f;
+		}
+
+		float linear(float x)
+		{
+			const float z = 0.8f;
+			const float d = 2.5f;
+
+			return lerp(x, (x - z) / d + z, step(z, x));
+		}
+	}
+
+	float3 bt2020_inv_gamma(float3 x)
+	{
+		return { encode(x.r), encode(x.g), encode(x.b) };
+	}
+
+	float3 linear_tonemap(float3 x)
+	{
+		return { linear(x.r), linear(x.g), linear(x.b) };
+	}
+
+	float rgb_to_luma(float3 x)
+	{
+		return 0.213f * x.r + 0.715f * x.g + 0.072f * x.b;
+	}
+
+	float3 neutral(float3 color)
+	{
+		const float start_compression = 0.8f - 0.04f;
+		const float desaturation = 0.15f;
+
+		const float x = std::min(color.r, std::min(color.g, color.b));
+		const float offset = x < 0.08f ? x - 6.25f * x * x : 0.04f;
+		color.r -= offset;
+		color.g -= offset;
+		color.b -= offset;
+
+		const float peak = std::max(color.r, std::max(color.g, color.b));
+
+		if (peak < start_compression)
+			return color;
+
+		const float d = 1.0f - start_compression;
+		const float new_peak = 1.0f - d * d / (peak + d - start_compression);
+		const float scale = new_peak / peak;
+		color.r *= scale;
+		color.g *= scale;
+		color.b *= scale;
+
+		const float g = 1.0f - 1.0f / (desaturation * (peak - new_peak) + 1.0f);
+
+		return { lerp(color.r, new_peak, g), lerp(color.g, new_peak, g), lerp(color.b, new_peak, g) };
+	}
+
+	float3 hdr_tone(float3 linear_color)
+	{
+		const float3 linear_result = linear_tonemap(linear_color);
+		const float3 neutral_result = neutral(linear_color);
+
+		const float linear_luma = rgb_to_luma(linear_result);
+
+		if (linear_luma < 0.8f)
+			return linear_result;
+
+		const float neutral_luma = rgb_to_luma(neutral_result);
+
+		return {
+			neutral_result.r / neutral_luma * linear_luma,
+			neutral_result.g / neutral_luma * linear_luma,
+			neutral_result.b / neutral_luma * linear_luma,
+		};
+	}
+
+	float hdr_linear(float src, float white_level)
+	{
+		return clamp_nits(src) / (white_level / 80.0f);
+	}
+
+	float hdr_decode(float src, float white_level)
+	{
+		return encode(hdr_linear(src, white_level));
+	}
+
+	float3 hdr_pixel(float3 src, float white_level)
+	{
+		return hdr_tone({
+			hdr_decode(src.r, white_level),
+			hdr_decode(src.g, white_level),
+			hdr_decode(src.b, white_level),
+		});
+	}
+
+	void hdr_to_bgra8(
+		const void* src, size_t src_pitch,
+		void* dest, size_t dest_pitch,
+		int width, int height, float white_level
+	)
+	{
+		for (int y = 0; y < height; y++)
+		{
+			const auto* in = reinterpret_cast<const uint16_t*>(static_cast<const uint8_t*>(src) + src_pitch * y);
+			auto* out = static_cast<uint8_t*>(dest) + dest_pitch * y;
+
+			for (int x = 0; x < width; x++, in += 4, out += 4)
+			{
+				const float3 color = hdr_pixel({ half_to_float(in[0]), half_to_float(in[1]), half_to_float(in[2]) }, white_level);
+
+				out[0] = to_unorm8(color.b);
+				out[1] = to_unorm8(color.g);
+				out[2] = to_unorm8(color.r);
+				out[3] = 0xff;
+			}
+		}
+	}
+
+	void hdr_to_bgra8_lut(
+		const void* src, size_t src_pitch,
+		void* dest, size_t dest_pitch,
+		int width, int height, const float* lut
+	)
+	{
+		for (int y = 0; y < height; y++)
+		{
+			const auto* in = reinterpret_cast<const uint16_t*>(static_cast<const uint8_t*>(src) + src_pitch * y);
+			auto* out = static_cast<uint8_t*>(dest) + dest_pitch * y;
+
+			for (int x = 0; x < width; x++, in += 4, out += 4)
+			{
+				const float3 color = hdr_tone({ lut[in[0]], lut[in[1]], lut[in[2]] });
+
+				out[0] = to_unorm8(color.b);
+				out[1] = to_unorm8(color.g);
+				out[2] = to_unorm8(color.r);
+				out[3] = 0xff;
+			}
+		}
+	}
+
+	void sdr_to_bgra8(
+		const void* src, size_t src_pitch,
+		void* dest, size_t dest_pitch,
+		int width, int height
+	)
+	{
+		for (int y = 0; y < height; y++)
+		{
+			const auto* in = static_cast<const uint8_t*>(src) + src_pitch * y;
+			auto* out = static_cast<uint8_t*>(dest) + dest_pitch * y;
+
+			for (int x = 0; x < width; x++, in += 4, out += 4)
+			{
+				out[0] = in[2];
+				out[1] = in[1];
+				out[2] = in[0];
+				out[3] = 0xff;
+			}
+		}
+	}
+
+	void bgra8_to_bgra8(
+		const void* src, size_t src_pitch,
+		void* dest, size_t dest_pitch,
+		int width, int height
+	)
+	{
+		for (int y = 0; y < height; y++)
+		{
+			const auto* in = reinterpret_cast<const uint32_t*>(static_cast<const uint8_t*>(src) + src_pitch * y);
+			auto* out = reinterpret_cast<uint32_t*>(static_cast<uint8_t*>(dest) + dest_pitch * y);
+
+			for (int x = 0; x < width; x++)
+				out[x] = in[x] | 0xff000000;
+		}
+	}
+
+	error_stats compare_bgra8(
+		const void* a, size_t a_pitch,
+		const void* b, size_t b_pitch,
+		int width, int height
+	)
+	{
+		error_stats stats;
+		uint64_t total = 0;
+
+		for (int y = 0; y < height; y++)
+		{
+			const auto* row_a = static_cast<const uint8_t*>(a) + a_pitch * y;
+			const auto* row_b = static_cast<const uint8_t*>(b) + b_pitch * y;
+
+			for (int i = 0; i < width * 4; i++)
+			{
+				const int diff = std::abs(static_cast<int>(row_a[i]) - static_cast<int>(row_b[i]));
+
+				if (diff)
+				{
+					stats.max_error = std::max(stats.max_error, diff);
+					stats.mismatched++;
+					total += diff;
+				}
+			}
+		}
+
+		const auto count = static_cast<uint64_t>(width) * height * 4;
+		stats.mean_error = count ? static_cast<double>(total) / count : 0.0;
+
+		return stats;
+	}
+}
@@ -0,0 +1,148 @@
+#pragma once
+#include <cstdint>
+#include <cstddef>
+#include <bit>
+
+// CPU port of tonemapper.hlsl, kept free of any platform headers so it can be
+// built and verified anywhere. Every function here mirrors its HLSL namesake.
+namespace tonemap
+{
+	struct float3
+	{
+		float r, g, b;
+	};
+
+	// duplication frame formats, values match INPUT_* in tonemapper.hlsl
+	enum class input_format
+	{
+		sdr,   // R8G8B8A8_UNORM
+		scrgb, // R16G16B16A16_FLOAT, linear bt.709, 1 = 80 nits
+		pq10,  // R10G10B10A2_UNORM, st 2084 encoded bt.2020
+		bgra8, // B8G8R8A8_UNORM, the canvas' own layout, copied with alpha forced to 1
+	};
+
+	constexpr size_t bytes_per_pixel(input_format format)
+	{
+		return format == input_format::scrgb ? 8 : 4;
+	}
+
+	constexpr bool is_hdr(input_format format)
+	{
+		return format == input_format::scrgb || format == input_format::pq10;
+	}
+
+	inline float half_to_float(uint16_t h)
+	{
+		const uint32_t sign = static_cast<uint32_t>(h & 0x8000) << 16;
+		const uint32_t exp = (h >> 10) & 0x1f;
+		const uint32_t mant = h & 0x3ff;
+
+		if (exp == 0x1f)
+			return std::bit_cast<float>(sign | 0x7f800000u | (mant << 13));
+
+		if (exp == 0)
+		{
+			// subnormal, mant * 2^-24
+			const float value = static_cast<float>(mant) * 5.9604644775390625e-8f;
+			return sign ? -value : value;
+		}
+
+		return std::bit_cast<float>(sign | ((exp + 112) << 23) | (mant << 13));
+	}
+
+	// round to nearest even, NaN stays NaN
+	inline uint16_t float_to_half(float f)
+	{
+		uint32_t u = std::bit_cast<uint32_t>(f);
+		const uint32_t sign = u & 0x80000000u;
+		u ^= sign;
+
+		uint32_t result;
+		if (u >= (143u << 23))
+		{
+			result = u > 0x7f800000u ? 0x7e00 : 0x7c00;
+		}
+		else if (u < (113u << 23))
+		{
+			const float aligned = std::bit_cast<float>(u) + 0.5f;
+			result = std::bit_cast<uint32_t>(aligned) - 0x3f000000u;
+		}
+		else
+		{
+			const uint32_t mant_odd = (u >> 13) & 1;
+			u += 0xc8000fffu + mant_odd;
+			result = u >> 13;
+		}
+
+		return static_cast<uint16_t>(result | (sign >> 16));
+	}
+
+	inline float saturate(float x)
+	{
+		// NaN goes to 0 like a UNORM store on the GPU
+		return x > 0.0f ? (x < 1.0f ? x : 1.0f) : 0.0f;
+	}
+
+	inline uint8_t to_unorm8(float x)
+	{
+		return static_cast<uint8_t>(saturate(x) * 255.0f + 0.5f);
+	}
+
+	float3 bt2020_inv_gamma(float3 x);
+	float3 linear_tonemap(float3 x);
+	float3 neutral(float3 color);
+	float rgb_to_luma(float3 x);
+
+	// the TONEMAP_HDR permutation of main() in two stages: hdr_decode is the per channel
+	// clamp, white level scale and bt2020_inv_gamma, hdr_tone the rest.
+	// hdr_linear stops before the gamma, 1 is the sdr white level
+	float hdr_linear(float src, float white_level);
+	float hdr_decode(float src, float white_level);
+	float3 hdr_tone(float3 linear_color);
+
+	// scRGB in, display referred out
+	float3 hdr_pixel(float3 src, float white_level);
+
+	// R16G16B16A16_FLOAT rows in, B8G8R8A8_UNORM rows out, pitches in bytes
+	void hdr_to_bgra8(
+		const void* src, size_t src_pitch,
+		void* dest, size_t dest_pitch,
+		int width, int height, float white_level
+	);
+
+	// hdr_to_bgra8 with hdr_decode replaced by a 65536 entry table indexed by
+	// the raw half bits, see half_lut.hpp
+	void hdr_to_bgra8_lut(
+		const void* src, size_t src_pitch,
+		void* dest, size_t dest_pitch,
+		int width, int height, const float* lut
+	);
+
+	// the sdr permutation, R8G8B8A8_UNORM in with alpha forced to 1
+	void sdr_to_bgra8(
+		const void* src, size_t src_pitch,
+		void* dest, size_t dest_pitch,
+		int width, int height
+	);
+
+	// the sdr permutation for B8G8R8A8_UNORM frames, copied with alpha forced to 1
+	void bgra8_to_bgra8(
+		const void* src, size_t src_pitch,
+		void* dest, size_t dest_pitch,
+		int width, int height
+	);
+
+	struct error_stats
+	{
+		int max_error = 0;
+		double mean_error = 0.0;
+		size_t mismatched = 0;
+	};
+
+	// per channel difference of two BGRA8 images, in 8 bit steps
+	error_stats compare_bgra8(
+		const void* a, size_t a_pitch,
+		const void* b, size_t b_pitch,
+		int width, int height
+	);
+}
@@ -0,0 +1,104 @@
+#include <algorithm>
+
+#include "worker_pool.hpp"
+
+namespace tonemap
+{
+	worker_pool::worker_pool(int threads) : thread_count_(std::max(threads, 0))
+	{
+	}
+
+	worker_pool::~worker_pool()
+	{
+		{
+			std::lock_guard lock(lock_);
+			stop_ = true;
+		}
+
+		wake_.notify_all();
+
+		for (auto& thread : threads_)
+			thread.join();
+	}
+
+	void worker_pool::run(int count, const std::function<void(int index)>& task)
+	{
+		std::unique_lock running(running_, std::try_to_lock);
+
+		if (!running || thread_count_ == 0 || count < 2)
+		{
+			for (int i = 0; i < count; i++)
+				task(i);
+
+			return;
+		}
+
+		std::unique_lock lock(lock_);
+
+		if (threads_.empty())
+		{
+			for (int i = 0; i < thread_count_; i++)
+				threads_.emplace_back(&worker_pool::work, this);
+		}
+
+		task_ = &task;
+		count_ = count;
+		next_ = 0;
+		active_ = 1;
+		generation_++;
+
+		wake_.notify_all();
+
+		drain(lock);
+
+		// every task is taken once the caller runs out, each by a thread still active
+		// until it's done with it
+		done_.wait(lock, [&] { return active_ == 0; });
+		task_ = nullptr;
+	}
+
+	void worker_pool::work()
+	{
+		std::unique_lock lock(lock_);
+		uint64_t seen = 0;
+
+		while (true)
+		{
+			wake_.wait(lock, [&] { return stop_ || generation_ != seen; });
+
+			if (stop_)
+				return;
+
+			// a thread waking after the run is over finds nothing left to take
+			seen = generation_;
+			active_++;
+			drain(lock);
+		}
+	}
+
+	void worker_pool::drain(std::unique_lock<std::mutex>& lock)
+	{
+		while (next_ < count_)
+		{
+			const auto* task = task_;
+			const int index = next_++;
+
+			lock.unlock();
+			(*task)(index);
+			lock.lock();
+		}
+
+		if (--active_ == 0)
+			done_.notify_all();
+	}
+
+	worker_pool& workers()
+	{
+		// never destroyed, like frame_buffers, the threads live as long as the process
+		static worker_pool* pool = new worker_pool(
+			static_cast<int>(std::clamp(std::thread::hardware_concurrency(), 1u, 16u)) - 1
+		);
+
+		return *pool;
+	}
+}
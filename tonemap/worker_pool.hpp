@@ -0,0 +1,66 @@
+#pragma once
+#include <cstdint>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace tonemap
+{
+	// threads kept waiting between captures for work split into bands, so a capture
+	// doesn't pay for starting and joining threads of its own. Started on the first run
+	class worker_pool
+	{
+	public:
+		// threads besides the calling one, 0 runs everything on the caller
+		explicit worker_pool(int threads);
+
+		// waits for the threads to finish what they're running
+		~worker_pool();
+
+		worker_pool(const worker_pool&) = delete;
+		worker_pool& operator=(const worker_pool&) = delete;
+
+		// how many tasks can run at once, the calling thread included
+		int size() const
+		{
+			return thread_count_ + 1;
+		}
+
+		// runs task(0) to task(count - 1), the calling thread taking tasks too, and
+		// returns once all of them have finished. task must not throw. While another
+		// run is going on, from another thread or from inside a task, the caller runs
+		// all of its tasks on its own instead of waiting for the threads
+		void run(int count, const std::function<void(int index)>& task);
+
+	private:
+		void work();
+
+		// takes tasks of the current run until none are left, called with lock_ held
+		void drain(std::unique_lock<std::mutex>& lock);
+
+		const int thread_count_;
+		std::vector<std::thread> threads_;
+
+		// held for a whole run
+		std::mutex running_;
+
+		std::mutex lock_;
+		std::condition_variable wake_;
+		std::condition_variable done_;
+
+		// the current run, guarded by lock_
+		const std::function<void(int)>* task_ = nullptr;
+		int count_ = 0;
+		int next_ = 0;
+		// threads taking tasks of the run, the caller included
+		int active_ = 0;
+		uint64_t generation_ = 0;
+		bool stop_ = false;
+	};
+
+	// the pool the tonemap functions split frames on, one thread less than the
+	// hardware has and at most 15
+	worker_pool& workers();
+}
@@ -1,16 +1,47 @@
 Texture2D<float4> src : register(t0);
 RWTexture2D<float4> dest : register(u0);
 
+// st 2084 eotf per 10 bit code in scRGB units, tonemap::pq_eotf_table
+Buffer<float> pq_eotf : register(t1);
+
+// compiled once per permutation, see shaders/: TONEMAP_HDR selects the tonemap or the
+// plain copy, TONEMAP_ROTATION the monitor's rotation in degrees and TONEMAP_OPERATOR
+// the hdr operator, numbered like tonemap::tone_operator. TONEMAP_HISTOGRAM makes it
+// the luminance histogram pass instead, which writes no pixels
+#if !defined(TONEMAP_HDR) || !defined(TONEMAP_ROTATION)
+#error TONEMAP_HDR and TONEMAP_ROTATION have to be defined
+#endif
+
+#ifndef TONEMAP_OPERATOR
+#define TONEMAP_OPERATOR 0
+#endif
+
+#ifndef TONEMAP_HISTOGRAM
+#define TONEMAP_HISTOGRAM 0
+#endif
+
+#define OPERATOR_BLEND 0
+#define OPERATOR_REINHARD 1
+#define OPERATOR_HABLE 2
+#define OPERATOR_ACES 3
+#define OPERATOR_BT2390 4
+#define OPERATOR_AGX 5
+
+// input_format values, numbered like tonemap::input_format
+#define INPUT_SDR 0
+#define INPUT_SCRGB 1
+#define INPUT_PQ10 2
+#define INPUT_BGRA8 3
+
 cbuffer data : register(b0)
 {
 	float white_level;
-	uint is_hdr;
-	float3x3 transform;
-}
-
-float3 soft_clip(float3 x)
-{
-	return saturate((1.0 + x - sqrt(1.0 - 1.99 * x + x * x)) / (1.995));
+	int2 offset;
+	int input_format;
+	// the part of the frame that lands in the captured region, in the frame's
+	// own coordinates. Only that is dispatched
+	int2 src_origin;
+	int2 src_size;
 }
 
 float3 linear_tonemap(float3 x)
@@ -61,60 +92,266 @@ float3 neutral(float3 color)
 	return result;
 }
 
-uint2 calc_dest_pos(float2 src, uint width, uint height)
+float3 blend(float3 input_color)
+{
+	float3 linear_color = bt2020_inv_gamma(input_color);
+
+	float3 linear_result = linear_tonemap(linear_color);
+	float3 neutral_result = neutral(linear_color);
+
+	float linear_luma = rgb_to_luma(linear_result);
+	float neutral_luma = rgb_to_luma(neutral_result);
+	float3 neutral_color = neutral_result / neutral_luma;
+
+	return lerp(linear_result, neutral_color * linear_luma, step(0.8, linear_luma));
+}
+
+// the operators below take linear light with 1 at the sdr white level and
+// return display referred values, see tonemap/operators.hpp
+
+// extended reinhard on luminance, the 10000 nit input peak maps to white
+float3 reinhard(float3 x)
+{
+	float white = 10000.0 / white_level;
+	float l = rgb_to_luma(x);
+
+	return bt2020_inv_gamma(x * ((1.0 + l / (white * white)) / (1.0 + l)));
+}
+
+float3 hable_curve(float3 x)
+{
+	const float a = 0.15, b = 0.50, c = 0.10, d = 0.20, e = 0.02, f = 0.30;
+	return (x * (a * x + c * b) + d * e) / (x * (a * x + b) + d * f) - e / f;
+}
+
+float3 hable(float3 x)
+{
+	return bt2020_inv_gamma(hable_curve(x * 2.0) / hable_curve(11.2).x);
+}
+
+float3 aces_fitted(float3 x)
 {
-    float2x2 rotation =
-    {
-        transform._11, transform._12,
-        transform._21, transform._22,
-    };
+	static const float3x3 input_mat =
+	{
+		0.59719, 0.35458, 0.04823,
+		0.07600, 0.90834, 0.01566,
+		0.02840, 0.13383, 0.83777,
+	};
+
+	static const float3x3 output_mat =
+	{
+		1.60475, -0.53108, -0.07367,
+		-0.10208, 1.10813, -0.00605,
+		-0.00327, -0.07276, 1.07602,
+	};
+
+	float3 v = mul(input_mat, x);
+	v = (v * (v + 0.0245786) - 0.000090537) / (v * (0.983729 * v + 0.4329510) + 0.238081);
+
+	return bt2020_inv_gamma(saturate(mul(output_mat, v)));
+}
+
+float pq_encode(float y)
+{
+	const float m1 = 0.1593017578125, m2 = 78.84375;
+	const float c1 = 0.8359375, c2 = 18.8515625, c3 = 18.6875;
+
+	float p = pow(max(y, 0), m1);
+	return pow((c1 + c2 * p) / (1.0 + c3 * p), m2);
+}
+
+float pq_decode(float e)
+{
+	const float m1 = 0.1593017578125, m2 = 78.84375;
+	const float c1 = 0.8359375, c2 = 18.8515625, c3 = 18.6875;
+
+	float p = pow(max(e, 0), 1.0 / m2);
+	return pow(max(p - c1, 0) / (c2 - c3 * p), 1.0 / m1);
+}
 
-    float2 center = float2(width, height) / 2.0;
-    float2 src_center = src + float2(0.5, 0.5);
+// bt.2390 eetf on max(r, g, b) from the 10000 nit range onto the sdr white level
+float3 bt2390(float3 x)
+{
+	float peak = max(x.r, max(x.g, x.b));
+	float max_lum = pq_encode(white_level / 10000.0);
+	float knee = 1.5 * max_lum - 0.5;
 
-    float2 transformed = mul(float3(src_center - center, 1), transform).xy;
-    float2 rotated_zero = mul(-center, rotation);
+	float e1 = pq_encode(peak * white_level / 10000.0);
 
-    transformed += abs(rotated_zero);
-    transformed -= float2(0.5, 0.5);
+	if (e1 <= knee)
+	{
+		return bt2020_inv_gamma(x);
+	}
 
-    return uint2(round(transformed));
+	float t = (e1 - knee) / (1.0 - knee);
+	float t2 = t * t;
+	float t3 = t2 * t;
+
+	float e2 = (2.0 * t3 - 3.0 * t2 + 1.0) * knee
+		+ (t3 - 2.0 * t2 + t) * (1.0 - knee)
+		+ (-2.0 * t3 + 3.0 * t2) * max_lum;
+
+	return bt2020_inv_gamma(x * (pq_decode(e2) * 10000.0 / white_level / peak));
 }
 
+float3 agx(float3 x)
+{
+	static const float3x3 inset =
+	{
+		0.842479062253094, 0.0784335999999992, 0.0792237451477643,
+		0.0423282422610123, 0.878468636469772, 0.0791661274605434,
+		0.0423756549057051, 0.0784336, 0.879142973793104,
+	};
+
+	static const float3x3 outset =
+	{
+		1.19687900512017, -0.0980208811401368, -0.0990297440797205,
+		-0.0528968517574562, 1.15190312990417, -0.0989611768448433,
+		-0.0529716355144438, -0.0980434501171241, 1.15107367264116,
+	};
+
+	const float min_ev = -12.47393;
+	const float max_ev = 4.026069;
+
+	float3 v = mul(inset, x);
+	v = clamp(log2(max(v, 1e-10)), min_ev, max_ev);
+	v = (v - min_ev) / (max_ev - min_ev);
+	v = ((((((15.5 * v - 40.14) * v + 31.96) * v - 6.868) * v + 0.4298) * v + 0.1191) * v - 0.00232);
+
+	return mul(outset, v);
+}
+
+float3 tone(float3 src_color)
+{
+	float3 input_color = clamp(src_color, 0, 10000) / (white_level / 80);
+
+#if TONEMAP_OPERATOR == OPERATOR_REINHARD
+	return reinhard(input_color);
+#elif TONEMAP_OPERATOR == OPERATOR_HABLE
+	return hable(input_color);
+#elif TONEMAP_OPERATOR == OPERATOR_ACES
+	return aces_fitted(input_color);
+#elif TONEMAP_OPERATOR == OPERATOR_BT2390
+	return bt2390(input_color);
+#elif TONEMAP_OPERATOR == OPERATOR_AGX
+	return agx(input_color);
+#else
+	return blend(input_color);
+#endif
+}
+
+// where the source pixel lands on the virtual desktop, the monitor's frame is in
+// its unrotated orientation
+int2 calc_dest_pos(int2 pos, int width, int height)
+{
+#if TONEMAP_ROTATION == 90
+	return offset + int2(height - 1 - pos.y, pos.x);
+#elif TONEMAP_ROTATION == 180
+	return offset + int2(width - 1 - pos.x, height - 1 - pos.y);
+#elif TONEMAP_ROTATION == 270
+	return offset + int2(pos.y, width - 1 - pos.x);
+#else
+	return offset + pos;
+#endif
+}
+
+// hdr frames to scRGB, pq10 ones through the eotf table and into bt.709 primaries
+float3 decode_input(float3 color)
+{
+	if (input_format != INPUT_PQ10)
+	{
+		return color;
+	}
+
+	static const float3x3 bt2020_to_bt709 =
+	{
+		1.660491, -0.587641, -0.072850,
+		-0.124550, 1.132900, -0.008349,
+		-0.018151, -0.100579, 1.118730,
+	};
+
+	const uint3 code = uint3(saturate(color) * 1023.0 + 0.5);
+	return mul(bt2020_to_bt709, float3(pq_eotf[code.r], pq_eotf[code.g], pq_eotf[code.b]));
+}
+
+#if TONEMAP_HISTOGRAM
+
+// bins like tonemap::luminance_histogram: 16 per stop of luminance in nits from 1/16
+// to 16384, straight from the exponent and the top 4 mantissa bits
+#define HISTOGRAM_BINS 288
+#define HISTOGRAM_FIRST_BIN ((127 - 4) << 4)
+
+// HISTOGRAM_BINS counters, cleared before the dispatch
+RWByteAddressBuffer histogram : register(u1);
+
+groupshared uint group_bins[HISTOGRAM_BINS];
+
+uint histogram_bin(float nits)
+{
+	// nan and everything at or below the first edge go to bin 0
+	if (!(nits > asfloat(HISTOGRAM_FIRST_BIN << 19)))
+	{
+		return 0;
+	}
+
+	return min((asuint(nits) >> 19) - HISTOGRAM_FIRST_BIN, HISTOGRAM_BINS - 1);
+}
+
+// the whole frame, each group counts into its own bins first and only adds the ones
+// it hit to the buffer
 [numthreads(16, 16, 1)]
-void main(uint3 tid : SV_DispatchThreadID)
+void main(uint3 tid : SV_DispatchThreadID, uint group_index : SV_GroupIndex)
 {
+	for (uint i = group_index; i < HISTOGRAM_BINS; i += 256)
+	{
+		group_bins[i] = 0;
+	}
+
+	GroupMemoryBarrierWithGroupSync();
+
 	uint width, height;
 	src.GetDimensions(width, height);
 
-	if (tid.x > width || tid.y > height)
+	if (tid.x < width && tid.y < height)
 	{
-		return;
+		const float nits = rgb_to_luma(decode_input(src[tid.xy].rgb)) * 80.0;
+		InterlockedAdd(group_bins[histogram_bin(nits)], 1);
 	}
 
-	uint2 src_pos = tid.xy;
-	uint2 dest_pos = calc_dest_pos(src_pos, width, height);
-    
-	float3 src_color = src[src_pos].rgb;
-	
-	if (is_hdr == 1)
-	{
-		float3 input_color = clamp(src_color, 0, 10000) / (white_level / 80);
-		float3 linear_color = bt2020_inv_gamma(input_color);
+	GroupMemoryBarrierWithGroupSync();
 
-		float3 linear_result = linear_tonemap(linear_color);
-		float3 neutral_result = neutral(linear_color);
+	for (uint j = group_index; j < HISTOGRAM_BINS; j += 256)
+	{
+		if (group_bins[j])
+		{
+			histogram.InterlockedAdd(j * 4, group_bins[j]);
+		}
+	}
+}
 
-		float linear_luma = rgb_to_luma(linear_result);
-		float neutral_luma = rgb_to_luma(neutral_result);
-		float3 neutral_color = neutral_result / neutral_luma;
+#else
 
-		linear_color = lerp(linear_result, neutral_color * linear_luma, step(0.8, linear_luma));
+[numthreads(16, 16, 1)]
+void main(uint3 tid : SV_DispatchThreadID)
+{
+	uint width, height;
+	src.GetDimensions(width, height);
 
-		dest[dest_pos] = float4(linear_color, 1.0);
-	}
-	else
+	if (tid.x >= uint(src_size.x) || tid.y >= uint(src_size.y))
 	{
-		dest[dest_pos] = float4(src_color, 1.0);
+		return;
 	}
+
+	uint2 src_pos = tid.xy + uint2(src_origin);
+	uint2 dest_pos = uint2(calc_dest_pos(int2(src_pos), width, height));
+
+	float3 src_color = src[src_pos].rgb;
+
+#if TONEMAP_HDR
+	dest[dest_pos] = float4(tone(decode_input(src_color)), 1.0);
+#else
+	dest[dest_pos] = float4(src_color, 1.0);
+#endif
 }
+
+#endif
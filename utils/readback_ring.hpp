@@ -0,0 +1,125 @@
+#pragma once
+#include <vector>
+#include <cstdint>
+#include <utility>
+#include <algorithm>
+
+// reads frames back from the gpu through a few staging surfaces of band_rows rows each,
+// so the gpu copies the next bands of a frame while the cpu takes out the ones already
+// there instead of the cpu waiting for the whole frame and the gpu for the cpu. Surfaces
+// are created once per frame width and reused for every frame after. Backend does the
+// device work, the ring only decides what happens when:
+//   surface_type create(int width, int rows)     a surface that holds rows rows of a frame
+//   void copy(surface_type&, int top, int rows)  queue copying those rows of the frame in
+//   bool done(const surface_type&)               the last copy into it finished, never blocks
+//   void wait(const surface_type&)               block until done
+//   void read(surface_type&, int top, int rows)  take the rows out, only called once done
+template <typename Backend>
+class readback_ring
+{
+public:
+	explicit readback_ring(Backend backend, int surfaces = 3, int band_rows = 256)
+		: backend_(std::move(backend)), count_(std::max(surfaces, 1)), band_rows_(std::max(band_rows, 1))
+	{
+	}
+
+	Backend& backend()
+	{
+		return backend_;
+	}
+
+	// every row of a width x height frame through backend().read, top to bottom
+	void read_frame(int width, int height)
+	{
+		if (width != width_)
+		{
+			slots_.clear();
+			width_ = width;
+		}
+
+		int next_copy = 0;
+		int next_read = 0;
+		int head = 0;
+		int in_flight = 0;
+
+		while (next_read < height)
+		{
+			// every free surface gets the next band before waiting on the oldest one
+			while (in_flight < count_ && next_copy < height)
+			{
+				auto& band = slot((head + in_flight) % count_);
+				band.top = next_copy;
+				band.rows = std::min(band_rows_, height - next_copy);
+
+				backend_.copy(band.surface, band.top, band.rows);
+
+				next_copy += band.rows;
+				in_flight++;
+			}
+
+			auto& oldest = slots_[head];
+			if (!backend_.done(oldest.surface))
+			{
+				backend_.wait(oldest.surface);
+				stalls_++;
+			}
+
+			backend_.read(oldest.surface, oldest.top, oldest.rows);
+			reads_++;
+
+			next_read += oldest.rows;
+			head = (head + 1) % count_;
+			in_flight--;
+		}
+	}
+
+	// drops every surface, the next read_frame creates them again
+	void clear()
+	{
+		slots_.clear();
+		width_ = 0;
+	}
+
+	// bands read so far and how many of those the gpu wasn't done with yet when their
+	// turn came, a high share means the bands are too small to hide the copy behind
+	uint64_t reads() const
+	{
+		return reads_;
+	}
+
+	uint64_t stalls() const
+	{
+		return stalls_;
+	}
+
+	int surfaces_created() const
+	{
+		return static_cast<int>(slots_.size());
+	}
+
+private:
+	struct band
+	{
+		typename Backend::surface_type surface;
+		int top = 0;
+		int rows = 0;
+	};
+
+	// surfaces are used in order from 0 the first time round, so they're created
+	// as they're reached and frames shorter than the ring never create all of them
+	band& slot(int index)
+	{
+		if (index == static_cast<int>(slots_.size()))
+			slots_.push_back({ backend_.create(width_, band_rows_) });
+
+		return slots_[index];
+	}
+
+	Backend backend_;
+	int count_;
+	int band_rows_;
+	int width_ = 0;
+	std::vector<band> slots_;
+	uint64_t reads_ = 0;
+	uint64_t stalls_ = 0;
+};
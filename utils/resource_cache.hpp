@@ -0,0 +1,122 @@
+#pragma once
+#include <list>
+#include <utility>
+#include <cstdint>
+#include <cstddef>
+#include <unordered_map>
+
+// values that are expensive to create and asked for again and again with the same key,
+// kept until they haven't been used for a while or don't fit. Every value is charged the
+// bytes given when it's created, the least recently used ones are dropped while the total
+// is over capacity. The one just asked for always stays, however big it is
+template <typename Key, typename Value, typename Hash = std::hash<Key>>
+class resource_cache
+{
+public:
+	struct stats
+	{
+		uint64_t hits = 0;
+		uint64_t creations = 0;
+		uint64_t destroys = 0;
+		size_t bytes = 0;
+	};
+
+	explicit resource_cache(size_t capacity) : capacity_(capacity)
+	{
+	}
+
+	// value cached for key, or what create(Value&) makes when there's none. False if
+	// create returned false, nothing is cached for key then
+	template <typename Create>
+	bool get(const Key& key, size_t bytes, Value& value, Create&& create)
+	{
+		auto found = index_.find(key);
+		if (found != index_.end())
+		{
+			entries_.splice(entries_.begin(), entries_, found->second);
+			found->second->last_used = frame_;
+			stats_.hits++;
+
+			value = found->second->value;
+			return true;
+		}
+
+		Value created{};
+		if (!create(created))
+			return false;
+
+		entries_.push_front({ key, created, bytes, frame_ });
+		index_.emplace(key, entries_.begin());
+
+		stats_.creations++;
+		stats_.bytes += bytes;
+
+		while (stats_.bytes > capacity_ && entries_.size() > 1)
+			evict();
+
+		value = std::move(created);
+		return true;
+	}
+
+	// starts the next frame. Values not asked for in the last max_age frames are
+	// dropped: once what they were created for is gone nobody asks for them again
+	void next_frame(uint64_t max_age)
+	{
+		frame_++;
+
+		while (!entries_.empty() && frame_ - entries_.back().last_used > max_age)
+			evict();
+	}
+
+	void set_capacity(size_t capacity)
+	{
+		capacity_ = capacity;
+
+		while (stats_.bytes > capacity_ && !entries_.empty())
+			evict();
+	}
+
+	void clear()
+	{
+		while (!entries_.empty())
+			evict();
+	}
+
+	const stats& counters() const
+	{
+		return stats_;
+	}
+
+	size_t size() const
+	{
+		return entries_.size();
+	}
+
+private:
+	struct entry
+	{
+		Key key;
+		Value value;
+		size_t bytes;
+		uint64_t last_used;
+	};
+
+	// drops the least recently used value
+	void evict()
+	{
+		auto& oldest = entries_.back();
+		stats_.bytes -= oldest.bytes;
+		stats_.destroys++;
+
+		index_.erase(oldest.key);
+		entries_.pop_back();
+	}
+
+	size_t capacity_;
+	uint64_t frame_ = 0;
+	stats stats_;
+
+	// most recently used first
+	std::list<entry> entries_;
+	std::unordered_map<Key, typename std::list<entry>::iterator, Hash> index_;
+};
@@ -0,0 +1,80 @@
+#pragma once
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+#include <exception>
+
+// runs work for one key at a time. Callers asking for the key that is being worked on
+// wait for it and share its result instead of starting their own, callers asking for a
+// different key wait until it's done and then take their turn. Nothing is kept once a
+// call is done, the next caller starts fresh
+template <typename Key, typename Result>
+class single_flight
+{
+public:
+	// work(Result&) fills a default constructed Result. What it throws is thrown to
+	// every caller that waited for it
+	template <typename Work>
+	std::shared_ptr<const Result> run(const Key& key, Work&& work)
+	{
+		std::unique_lock lock(mutex_);
+
+		while (current_)
+		{
+			if (current_->key == key)
+			{
+				auto flight = current_;
+				done_.wait(lock, [&] { return flight->done; });
+
+				if (flight->error)
+					std::rethrow_exception(flight->error);
+
+				return flight->result;
+			}
+
+			done_.wait(lock);
+		}
+
+		auto flight = std::make_shared<flight_t>(key);
+		current_ = flight;
+		lock.unlock();
+
+		try
+		{
+			auto result = std::make_shared<Result>();
+			work(*result);
+			flight->result = std::move(result);
+		}
+		catch (...)
+		{
+			flight->error = std::current_exception();
+		}
+
+		lock.lock();
+		flight->done = true;
+		current_ = nullptr;
+		lock.unlock();
+		done_.notify_all();
+
+		if (flight->error)
+			std::rethrow_exception(flight->error);
+
+		return flight->result;
+	}
+
+private:
+	struct flight_t
+	{
+		explicit flight_t(const Key& key) : key(key) {}
+
+		Key key;
+		std::shared_ptr<const Result> result;
+		std::exception_ptr error;
+		bool done = false;
+	};
+
+	std::mutex mutex_;
+	std::condition_variable done_;
+	// the call being worked on, null when there's none
+	std::shared_ptr<flight_t> current_;
+};
@@ -0,0 +1,92 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <unordered_map>
+
+// what Provider::query finds out about a key, kept until invalidate() is called or it's
+// older than max_age. Meant for state the system announces changes of, max_age covers
+// the changes it doesn't announce. get() and forget() come from one thread at a time,
+// invalidate() from any. Provider:
+//   bool query(const Key&, Value&)               false if it can't be read, asked again next time
+//   std::chrono::steady_clock::time_point now()
+template <typename Key, typename Value, typename Provider>
+class topology_cache
+{
+public:
+	using clock = std::chrono::steady_clock;
+
+	topology_cache(Provider provider, clock::duration max_age) : provider_(std::move(provider)), max_age_(max_age)
+	{
+	}
+
+	// the value of key, queried if there is none or it went stale
+	bool get(const Key& key, Value& value)
+	{
+		const uint64_t generation = generation_.load(std::memory_order_acquire);
+		const auto now = provider_.now();
+
+		auto found = entries_.find(key);
+		if (found != entries_.end() && found->second.generation == generation && now - found->second.queried < max_age_)
+		{
+			hits_++;
+			value = found->second.value;
+			return true;
+		}
+
+		queries_++;
+
+		Value queried;
+		if (!provider_.query(key, queried))
+		{
+			entries_.erase(key);
+			return false;
+		}
+
+		entries_.insert_or_assign(key, entry{ queried, generation, now });
+		value = queried;
+		return true;
+	}
+
+	// everything is queried again on its next get()
+	void invalidate()
+	{
+		generation_.fetch_add(1, std::memory_order_release);
+	}
+
+	// drops key, for when what it identifies goes away and something else may get its key
+	void forget(const Key& key)
+	{
+		entries_.erase(key);
+	}
+
+	Provider& provider()
+	{
+		return provider_;
+	}
+
+	uint64_t hits() const
+	{
+		return hits_;
+	}
+
+	uint64_t queries() const
+	{
+		return queries_;
+	}
+
+private:
+	struct entry
+	{
+		Value value;
+		uint64_t generation;
+		clock::time_point queried;
+	};
+
+	Provider provider_;
+	clock::duration max_age_;
+	std::atomic<uint64_t> generation_ = 0;
+	std::unordered_map<Key, entry> entries_;
+	uint64_t hits_ = 0;
+	uint64_t queries_ = 0;
+};
@@ -0,0 +1,151 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <thread>
+#include <utility>
+
+// hands the newest value from one producer thread to any number of consumer threads
+// without locks. The producer fills back() and publish() makes it the newest value.
+// A consumer's read() pins the newest slot until the reader is gone, and the producer
+// never refills a pinned slot: it moves on to one nobody holds, and only yields when
+// readers hold every other slot. Values in between are dropped, consumers only ever
+// see complete ones and the slots are reused, never reallocated
+template <typename T>
+class triple_buffer
+{
+	static constexpr size_t slot_count = 3;
+	static constexpr size_t none = slot_count;
+
+public:
+	// a published value, kept from being refilled while the reader exists
+	class reader
+	{
+	public:
+		reader() = default;
+
+		reader(reader&& other) noexcept :
+			owner_(std::exchange(other.owner_, nullptr)), index_(other.index_)
+		{
+		}
+
+		reader& operator=(reader&& other) noexcept
+		{
+			if (this != &other)
+			{
+				release();
+				owner_ = std::exchange(other.owner_, nullptr);
+				index_ = other.index_;
+			}
+
+			return *this;
+		}
+
+		~reader()
+		{
+			release();
+		}
+
+		reader(const reader&) = delete;
+		reader& operator=(const reader&) = delete;
+
+		// false before the first publish()
+		explicit operator bool() const
+		{
+			return owner_ != nullptr;
+		}
+
+		const T& operator*() const
+		{
+			return owner_->slots_[index_].value;
+		}
+
+		const T* operator->() const
+		{
+			return &owner_->slots_[index_].value;
+		}
+
+	private:
+		friend class triple_buffer;
+
+		reader(triple_buffer* owner, size_t index) : owner_(owner), index_(index)
+		{
+		}
+
+		void release()
+		{
+			if (owner_)
+				owner_->slots_[index_].readers.fetch_sub(1, std::memory_order_release);
+
+			owner_ = nullptr;
+		}
+
+		triple_buffer* owner_ = nullptr;
+		size_t index_ = 0;
+	};
+
+	// producer side, the slot to fill next. Nobody reads it until it's published
+	T& back()
+	{
+		return slots_[back_].value;
+	}
+
+	void publish()
+	{
+		newest_.store(back_, std::memory_order_seq_cst);
+		back_ = next_back();
+	}
+
+	// consumer side, the newest published value, an empty reader before the first one
+	reader read()
+	{
+		while (true)
+		{
+			const size_t index = newest_.load(std::memory_order_seq_cst);
+			if (index == none)
+				return {};
+
+			// pinned first, then checked to still be the newest: once the producer moved
+			// on from it, it could already be filling it again
+			slots_[index].readers.fetch_add(1, std::memory_order_seq_cst);
+
+			if (newest_.load(std::memory_order_seq_cst) == index)
+				return { this, index };
+
+			slots_[index].readers.fetch_sub(1, std::memory_order_release);
+		}
+	}
+
+private:
+	struct slot
+	{
+		T value = {};
+		alignas(64) std::atomic<uint32_t> readers{ 0 };
+	};
+
+	// a slot that's neither the newest nor pinned, the producer is the only writer of
+	// newest_ so it can't change meanwhile
+	size_t next_back()
+	{
+		const size_t newest = newest_.load(std::memory_order_relaxed);
+
+		while (true)
+		{
+			for (size_t i = 1; i <= slot_count; i++)
+			{
+				const size_t index = (back_ + i) % slot_count;
+
+				if (index != newest && slots_[index].readers.load(std::memory_order_seq_cst) == 0)
+					return index;
+			}
+
+			std::this_thread::yield();
+		}
+	}
+
+	slot slots_[slot_count];
+
+	alignas(64) std::atomic<size_t> newest_{ none };
+	// producer only
+	alignas(64) size_t back_ = 0;
+};